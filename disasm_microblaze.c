@@ -1,9 +1,99 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdarg.h>
 #include <string.h>
 #include "elfi32.h"
+#include "elfi32_dwline.h"
 #include "disasm_microblaze.h"
 
+#define MB_ARENA_DEFAULT_BLK_SIZE (256 * 1024)
+#define MB_ARENA_ALIGN 16
+
+typedef struct _MBArenaBlk {
+	struct _MBArenaBlk* pNext;
+	size_t size;
+	size_t used;
+} MBArenaBlk;
+
+static size_t arena_blk_hdr_size() {
+	return (sizeof(MBArenaBlk) + (MB_ARENA_ALIGN - 1)) & ~(size_t)(MB_ARENA_ALIGN - 1);
+}
+
+void dismb_arena_init(MBArena* pArena, size_t blkSize) {
+	if (pArena) {
+		pArena->pTop = NULL;
+		pArena->pCur = NULL;
+		pArena->blkSize = blkSize > 0 ? blkSize : MB_ARENA_DEFAULT_BLK_SIZE;
+	}
+}
+
+void* dismb_arena_alloc(MBArena* pArena, size_t size) {
+	void* pMem = NULL;
+	if (pArena) {
+		MBArenaBlk* pBlk;
+		size = (size + (MB_ARENA_ALIGN - 1)) & ~(size_t)(MB_ARENA_ALIGN - 1);
+		if (pArena->blkSize == 0) {
+			pArena->blkSize = MB_ARENA_DEFAULT_BLK_SIZE;
+		}
+		/* blocks before pCur are full, blocks after it were released by reset */
+		pBlk = pArena->pCur ? pArena->pCur : pArena->pTop;
+		while (pBlk && pBlk->size - pBlk->used < size) {
+			pBlk = pBlk->pNext;
+			if (pBlk) {
+				pArena->pCur = pBlk;
+			}
+		}
+		if (!pBlk) {
+			size_t blkSize = size > pArena->blkSize ? size : pArena->blkSize;
+			pBlk = (MBArenaBlk*)malloc(arena_blk_hdr_size() + blkSize);
+			if (pBlk) {
+				pBlk->pNext = NULL;
+				pBlk->size = blkSize;
+				pBlk->used = 0;
+				if (pArena->pCur) {
+					MBArenaBlk* pLast = pArena->pCur;
+					while (pLast->pNext) {
+						pLast = pLast->pNext;
+					}
+					pLast->pNext = pBlk;
+				} else {
+					pArena->pTop = pBlk;
+				}
+				pArena->pCur = pBlk;
+			}
+		}
+		if (pBlk) {
+			pMem = (uint8_t*)pBlk + arena_blk_hdr_size() + pBlk->used;
+			pBlk->used += size;
+		}
+	}
+	return pMem;
+}
+
+void dismb_arena_reset(MBArena* pArena) {
+	if (pArena) {
+		MBArenaBlk* pBlk = pArena->pTop;
+		while (pBlk) {
+			pBlk->used = 0;
+			pBlk = pBlk->pNext;
+		}
+		pArena->pCur = pArena->pTop;
+	}
+}
+
+void dismb_arena_free(MBArena* pArena) {
+	if (pArena) {
+		MBArenaBlk* pBlk = pArena->pTop;
+		while (pBlk) {
+			MBArenaBlk* pNext = pBlk->pNext;
+			free(pBlk);
+			pBlk = pNext;
+		}
+		pArena->pTop = NULL;
+		pArena->pCur = NULL;
+	}
+}
+
 typedef struct _SymFnCtx {
 	MBDisasm* pDis;
 	int idx;
@@ -21,33 +111,348 @@ static int funcs_symfn(int isym, const char* pName, uint32_t addr, uint32_t size
 			++pCtx->idx;
 		}
 	}
+	return 1;
+}
+
+static void* img_alloc(size_t size, void* pCtxMem) {
+	MBDisasm* pDis = (MBDisasm*)pCtxMem;
+	if (size > pDis->imgBufSize) {
+		free(pDis->pImgBuf);
+		pDis->pImgBuf = malloc(size);
+		pDis->imgBufSize = pDis->pImgBuf ? size : 0;
+	}
+	return pDis->pImgBuf;
 }
 
 int dismb_init(MBDisasm* pDis, const char* pElfPath) {
 	int res = 0;
 	if (pDis && pElfPath) {
 		memset(pDis, 0, sizeof(MBDisasm));
-		pDis->pELF = elfi32_load(pElfPath, &pDis->elfSize);
-		if (pDis->pELF) {
-			void* pELF = pDis->pELF;
-			pDis->itext = elfi32_find_section(pELF, ".text");
-			elfi32_section_addrinfo(pELF, pDis->itext, &pDis->textAddr, &pDis->textOffs, &pDis->textSize);
-			pDis->numFuncs = elfi32_num_global_funcs(pELF);
-			printf("Loaded ELF \"%s\": %d global funcs.\n", pElfPath, pDis->numFuncs);
+		dismb_arena_init(&pDis->arena, 0);
+		res = dismb_load(pDis, pElfPath);
+	}
+	return res;
+}
+
+int dismb_load(MBDisasm* pDis, const char* pElfPath) {
+	return dismb_load_ex(pDis, pElfPath, 1);
+}
+
+static int setup_image(MBDisasm* pDis, const char* pName, int verbose) {
+	int res = 0;
+	if (pDis->pELF) {
+		void* pELF = pDis->pELF;
+		pDis->itext = elfi32_find_section(pELF, ".text");
+		elfi32_section_addrinfo(pELF, pDis->itext, &pDis->textAddr, &pDis->textOffs, &pDis->textSize);
+		pDis->numFuncs = elfi32_num_global_funcs(pELF);
+		if (verbose) {
+			printf("Loaded ELF \"%s\": %d global funcs.\n", pName, pDis->numFuncs);
 			printf(".text: addr = 0x%X, offs = 0x%X, size = 0x%X\n", pDis->textAddr, pDis->textOffs, pDis->textSize);
-			pDis->pFuncs = (MBFunc*)malloc(sizeof(MBFunc) * pDis->numFuncs);
-			if (pDis->pFuncs) {
-				SymFnCtx ctx;
-				ctx.pDis = pDis;
-				ctx.idx = 0;
-				elfi32_foreach_global_func(pDis->pELF, funcs_symfn, &ctx);
-				res = 1;
+		}
+		pDis->pFuncs = (MBFunc*)dismb_arena_alloc(&pDis->arena, sizeof(MBFunc) * pDis->numFuncs);
+		if (pDis->pFuncs) {
+			SymFnCtx ctx;
+			ctx.pDis = pDis;
+			ctx.idx = 0;
+			elfi32_foreach_global_func(pDis->pELF, funcs_symfn, &ctx);
+			res = 1;
+		}
+	}
+	return res;
+}
+
+int dismb_load_ex(MBDisasm* pDis, const char* pElfPath, int verbose) {
+	int res = 0;
+	if (pDis && pElfPath) {
+		dismb_reset(pDis);
+		pDis->pELF = elfi32_load_alloc(pElfPath, &pDis->elfSize, img_alloc, pDis);
+		res = setup_image(pDis, pElfPath, verbose);
+	}
+	return res;
+}
+
+/* takes ownership of a malloc'ed image, e.g. one from elfi32_prefetch() */
+int dismb_load_image(MBDisasm* pDis, void* pELF, size_t size, int verbose) {
+	int res = 0;
+	if (pDis) {
+		dismb_reset(pDis);
+		if (pELF && size > 0x10 && elfi32_valid(pELF)) {
+			if (pDis->pImgBuf != pELF) {
+				free(pDis->pImgBuf);
+			}
+			pDis->pImgBuf = pELF;
+			pDis->imgBufSize = size;
+			pDis->pELF = pELF;
+			pDis->elfSize = size;
+			res = setup_image(pDis, "<image>", verbose);
+		} else {
+			free(pELF);
+		}
+	}
+	return res;
+}
+
+void dismb_reset(MBDisasm* pDis) {
+	if (pDis) {
+		MBArena arena = pDis->arena;
+		void* pImgBuf = pDis->pImgBuf;
+		size_t imgBufSize = pDis->imgBufSize;
+		free(pDis->pSectHashes);
+		dismb_arena_reset(&arena);
+		memset(pDis, 0, sizeof(MBDisasm));
+		pDis->arena = arena;
+		pDis->pImgBuf = pImgBuf;
+		pDis->imgBufSize = imgBufSize;
+	}
+}
+
+void dismb_free(MBDisasm* pDis) {
+	if (pDis) {
+		dismb_arena_free(&pDis->arena);
+		free(pDis->pImgBuf);
+		free(pDis->pSectHashes);
+		memset(pDis, 0, sizeof(MBDisasm));
+	}
+}
+
+static char* pool_strcpy(char** ppPool, const char* pStr) {
+	char* pDst = *ppPool;
+	size_t len = strlen(pStr) + 1;
+	memcpy(pDst, pStr, len);
+	*ppPool += len;
+	return pDst;
+}
+
+int dismb_compact(MBDisasm* pDis) {
+	int res = 0;
+	if (pDis && pDis->pELF) {
+		void* pELF = pDis->pELF;
+		int i;
+		int nsects = (int)elfi32_num_sect_header_entries(pELF);
+		size_t poolSize = 0;
+		char* pPool;
+		for (i = 0; i < pDis->numFuncs; ++i) {
+			poolSize += strlen(pDis->pFuncs[i].pName) + 1;
+		}
+		for (i = 0; i < nsects; ++i) {
+			const char* pName = elfi32_section_name(pELF, i);
+			poolSize += (pName ? strlen(pName) : 0) + 1;
+		}
+		pPool = (char*)dismb_arena_alloc(&pDis->arena, poolSize);
+		pDis->pSects = (MBSection*)dismb_arena_alloc(&pDis->arena, sizeof(MBSection) * nsects);
+		pDis->pText = (uint32_t*)dismb_arena_alloc(&pDis->arena, pDis->textSize & ~3);
+		if (pPool && pDis->pSects && pDis->pText) {
+			uint32_t nwords = pDis->textSize / 4;
+			uint32_t iw;
+			for (i = 0; i < pDis->numFuncs; ++i) {
+				pDis->pFuncs[i].pName = pool_strcpy(&pPool, pDis->pFuncs[i].pName);
+			}
+			for (i = 0; i < nsects; ++i) {
+				MBSection* pSect = &pDis->pSects[i];
+				const char* pName = elfi32_section_name(pELF, i);
+				pSect->pName = pool_strcpy(&pPool, pName ? pName : "");
+				pSect->type = elfi32_section_type(pELF, i);
+				pSect->flags = elfi32_section_flags(pELF, i);
+				elfi32_section_addrinfo(pELF, i, &pSect->addr, &pSect->offs, &pSect->size);
+			}
+			pDis->numSects = nsects;
+			for (iw = 0; iw < nwords; ++iw) {
+				pDis->pText[iw] = elfi32_read_u32(pELF, pDis->textOffs + iw*4);
+			}
+			/* detach: from here on only the compacted tables are used */
+			free(pDis->pImgBuf);
+			pDis->pImgBuf = NULL;
+			pDis->imgBufSize = 0;
+			pDis->pELF = NULL;
+			pDis->elfSize = 0;
+			res = 1;
+		} else {
+			pDis->pText = NULL;
+			pDis->pSects = NULL;
+		}
+	}
+	return res;
+}
+
+static uint32_t text_word(MBDisasm* pDis, uint32_t addr) {
+	uint32_t code = 0;
+	uint32_t rel = addr - pDis->textAddr;
+	if (rel < (pDis->textSize & ~3u)) {
+		if (pDis->pText) {
+			code = pDis->pText[rel >> 2];
+		} else if (pDis->pELF) {
+			code = elfi32_read_u32(pDis->pELF, pDis->textOffs + rel);
+		}
+	}
+	return code;
+}
+
+/*
+ * Copies n host-order words starting at addr, returns the number of words
+ * that lie inside .text.
+ */
+uint32_t dismb_read_words(MBDisasm* pDis, uint32_t addr, uint32_t* pDst, uint32_t n) {
+	uint32_t nwords = 0;
+	if (pDis && pDst) {
+		uint32_t rel = addr - pDis->textAddr;
+		uint32_t textSize = pDis->textSize & ~3u;
+		if (rel < textSize && (rel & 3) == 0) {
+			nwords = (textSize - rel) / 4;
+			if (nwords > n) {
+				nwords = n;
+			}
+			if (pDis->pText) {
+				memcpy(pDst, &pDis->pText[rel >> 2], nwords * 4);
+			} else if (pDis->pELF) {
+				uint8_t* pSrc = (uint8_t*)pDis->pELF + pDis->textOffs + rel;
+				uint32_t i;
+				memcpy(pDst, pSrc, nwords * 4);
+				if (((uint8_t*)pDis->pELF)[5] & 0x80) {
+					for (i = 0; i < nwords; ++i) {
+						uint32_t w = pDst[i];
+						pDst[i] = (w >> 24) | ((w >> 8) & 0xFF00) | ((w << 8) & 0xFF0000) | (w << 24);
+					}
+				}
+			} else {
+				nwords = 0;
+			}
+		}
+	}
+	return nwords;
+}
+
+#define WALK_CHUNK_WORDS 256
+
+/* decodes a function in order, passing each instruction with its predecessor */
+void dismb_walk_func(MBDisasm* pDis, int ifunc, MBWalkFn fn, void* pCtx) {
+	uint32_t words[WALK_CHUNK_WORDS];
+	uint32_t addr;
+	uint32_t nleft;
+	MBInstr prev;
+	if (!pDis || !fn || (uint32_t)ifunc >= (uint32_t)pDis->numFuncs) {
+		return;
+	}
+	addr = pDis->pFuncs[ifunc].addr;
+	nleft = pDis->pFuncs[ifunc].size / 4;
+	memset(&prev, 0, sizeof(prev));
+	while (nleft > 0) {
+		uint32_t n = dismb_read_words(pDis, addr, words, nleft < WALK_CHUNK_WORDS ? nleft : WALK_CHUNK_WORDS);
+		uint32_t i;
+		if (n == 0) {
+			break;
+		}
+		for (i = 0; i < n; ++i) {
+			MBInstr ins;
+			dismb_decode(addr + i*4, words[i], &ins);
+			fn(&prev, &ins, pCtx);
+			prev = ins;
+		}
+		addr += n * 4;
+		nleft -= n;
+	}
+}
+
+static int cmp_addr_idx(const void* pA, const void* pB) {
+	const MBAddrIdx* pIdxA = (const MBAddrIdx*)pA;
+	const MBAddrIdx* pIdxB = (const MBAddrIdx*)pB;
+	if (pIdxA->addr != pIdxB->addr) {
+		return pIdxA->addr < pIdxB->addr ? -1 : 1;
+	}
+	return pIdxA->ifunc - pIdxB->ifunc;
+}
+
+/* must be rebuilt whenever pFuncs changes */
+int dismb_build_addr_index(MBDisasm* pDis) {
+	int res = 0;
+	if (pDis && pDis->pFuncs) {
+		MBAddrIdx* pIdx = (MBAddrIdx*)dismb_arena_alloc(&pDis->arena, sizeof(MBAddrIdx) * pDis->numFuncs);
+		if (pIdx) {
+			int i;
+			for (i = 0; i < pDis->numFuncs; ++i) {
+				pIdx[i].addr = pDis->pFuncs[i].addr;
+				pIdx[i].size = pDis->pFuncs[i].size;
+				pIdx[i].ifunc = i;
 			}
+			qsort(pIdx, pDis->numFuncs, sizeof(MBAddrIdx), cmp_addr_idx);
+			pDis->pAddrIdx = pIdx;
+			res = 1;
 		}
 	}
 	return res;
 }
 
+/* index of the function containing addr, -1 if none */
+int dismb_func_at(MBDisasm* pDis, uint32_t addr) {
+	int ifunc = -1;
+	if (pDis && pDis->pAddrIdx) {
+		const MBAddrIdx* pIdx = pDis->pAddrIdx;
+		int lo = 0;
+		int hi = pDis->numFuncs;
+		/* first entry above addr */
+		while (lo < hi) {
+			int mid = (lo + hi) / 2;
+			if (pIdx[mid].addr <= addr) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
+		}
+		/* walk back over aliases and zero-sized labels */
+		while (--lo >= 0) {
+			if (addr - pIdx[lo].addr < pIdx[lo].size || addr == pIdx[lo].addr) {
+				ifunc = pIdx[lo].ifunc;
+				break;
+			}
+			if (lo > 0 && pIdx[lo - 1].addr != pIdx[lo].addr && pIdx[lo].size > 0) {
+				break;
+			}
+		}
+	} else if (pDis && pDis->pFuncs) {
+		int i;
+		for (i = 0; i < pDis->numFuncs; ++i) {
+			if (addr - pDis->pFuncs[i].addr < pDis->pFuncs[i].size) {
+				ifunc = i;
+				break;
+			}
+		}
+	}
+	return ifunc;
+}
+
+/*
+ * Source lines for dismb_func_out() and dismb_resolve_pc(), owned by the
+ * caller and queried through lineFn (normally elfi32_lines_lookup).
+ */
+void dismb_set_lines(MBDisasm* pDis, const elfi32_lines* pLines, MBLineFn lineFn) {
+	if (pDis) {
+		pDis->pLines = pLines;
+		pDis->lineFn = pLines ? lineFn : NULL;
+	}
+}
+
+/* "func+0xN (file:line)", returns the length written */
+int dismb_resolve_pc(MBDisasm* pDis, uint32_t addr, char* pBuf, size_t bufSize) {
+	int len = 0;
+	if (pDis && pBuf && bufSize > 0) {
+		elfi32_lineinfo info;
+		int ifunc = dismb_func_at(pDis, addr);
+		if (ifunc >= 0) {
+			len = snprintf(pBuf, bufSize, "%s+0x%X", pDis->pFuncs[ifunc].pName, addr - pDis->pFuncs[ifunc].addr);
+		} else {
+			len = snprintf(pBuf, bufSize, "0x%08X", addr);
+		}
+		if (len >= 0 && (size_t)len < bufSize && pDis->lineFn && pDis->lineFn(pDis->pLines, addr, &info)) {
+			len += snprintf(pBuf + len, bufSize - len, " (%s:%u)", info.pFile, info.line);
+		}
+		if (len < 0) {
+			len = 0;
+		} else if ((size_t)len >= bufSize) {
+			len = (int)bufSize - 1;
+		}
+	}
+	return len;
+}
+
 int dismb_find_func(MBDisasm* pDis, const char* pName) {
 	int idx = -1;
 	if (pName && pDis && pDis->pFuncs) {
@@ -62,8 +467,191 @@ int dismb_find_func(MBDisasm* pDis, const char* pName) {
 	return idx;
 }
 
-static void instr(uint32_t addr, uint32_t code, MBInstrCB cb, void* pWkMem) {
-	const char* pOpName = "";
+/* report output for every module: fn, or stdout when fn is NULL; nothing for len <= 0 */
+void dismb_text_out(MBTextFn fn, void* pCtx, const char* pText, int len) {
+	if (len > 0) {
+		if (fn) {
+			fn(pCtx, pText, (size_t)len);
+		} else {
+			fwrite(pText, 1, (size_t)len, stdout);
+		}
+	}
+}
+
+/*
+ * Formatted output through dismb_text_out(). Short text is formatted on
+ * the stack, anything longer than the line buffer gets a heap copy so
+ * nothing is cut off.
+ */
+void dismb_text_printf(MBTextFn fn, void* pCtx, const char* pFmt, ...) {
+	char line[256];
+	int len;
+	va_list args;
+	va_list args2;
+	va_start(args, pFmt);
+	va_copy(args2, args);
+	len = vsnprintf(line, sizeof(line), pFmt, args);
+	va_end(args);
+	if (len < (int)sizeof(line)) {
+		dismb_text_out(fn, pCtx, line, len);
+	} else {
+		char* pLong = (char*)malloc((size_t)len + 1);
+		if (pLong) {
+			vsnprintf(pLong, (size_t)len + 1, pFmt, args2);
+			dismb_text_out(fn, pCtx, pLong, len);
+			free(pLong);
+		} else {
+			dismb_text_out(fn, pCtx, line, (int)sizeof(line) - 1);
+		}
+	}
+	va_end(args2);
+}
+
+static const char* s_opNames[MBOP_NUM] = {
+	"",
+	"addkc",
+	"addc",
+	"addk",
+	"add",
+	"addikc",
+	"addic",
+	"addik",
+	"addi",
+	"rsubkc",
+	"rsubc",
+	"rsubk",
+	"rsub",
+	"rsubikc",
+	"rsubic",
+	"rsubik",
+	"rsubi",
+	"and",
+	"andi",
+	"pcmpne",
+	"andn",
+	"andni",
+	"beq",
+	"beqd",
+	"bge",
+	"bged",
+	"bgt",
+	"bgtd",
+	"ble",
+	"bled",
+	"blt",
+	"bltd",
+	"bne",
+	"bned",
+	"beqi",
+	"beqid",
+	"bgei",
+	"bgedi",
+	"bgti",
+	"bgtid",
+	"blei",
+	"bleid",
+	"blti",
+	"bltid",
+	"bnei",
+	"bneid",
+	"brk",
+	"brd",
+	"brld",
+	"brad",
+	"brald",
+	"bra",
+	"br",
+	"brki",
+	"mbar",
+	"brid",
+	"brlid",
+	"braid",
+	"bralid",
+	"brai",
+	"bri",
+	"bsrl",
+	"bsra",
+	"bsll",
+	"bsrli",
+	"bsrai",
+	"bslli",
+	"clz",
+	"sext16",
+	"sext8",
+	"sra",
+	"src",
+	"srl",
+	"swapb",
+	"swaph",
+	"-- wdc/wic --",
+	"cmp",
+	"cmpu",
+	"fadd",
+	"frsub",
+	"fmul",
+	"fdiv",
+	"fcmp.un",
+	"fcmp.lt",
+	"fcmp.eq",
+	"fcmp.le",
+	"fcmp.gt",
+	"fcmp.ne",
+	"fcmp.ge",
+	"flt",
+	"fint",
+	"fsqrt",
+	"-- put --",
+	"-- get --",
+	"-- putd --",
+	"-- getd --",
+	"idiv",
+	"imm",
+	"lbuea",
+	"lbur",
+	"lbu",
+	"lbui",
+	"lhuea",
+	"lhur",
+	"lhu",
+	"lhui",
+	"lwx",
+	"lwea",
+	"lwr",
+	"lw",
+	"lwi",
+	"-- mfs/msrclr/msrset/mts -- ",
+	"mul",
+	"mulh",
+	"mulhsu",
+	"mulhu",
+	"muli",
+	"pcmpbf",
+	"or",
+	"ori",
+	"pcmpeq",
+	"xor",
+	"rtbd",
+	"rtid",
+	"rted",
+	"rtsd",
+	"sbea",
+	"sbr",
+	"sb",
+	"sbi",
+	"shea",
+	"shr",
+	"sh",
+	"shi",
+	"swea",
+	"swx",
+	"swr",
+	"sw",
+	"swi",
+	"xori",
+};
+
+void dismb_decode(uint32_t addr, uint32_t code, MBInstr* pInstr) {
+	MBOp opId = MBOP_NONE;
 	int opr3 = 1;
 	uint32_t op = (code >> 26) & 0x3F;
 	int32_t rD = (code >> 21) & 0x1F;
@@ -74,135 +662,135 @@ static void instr(uint32_t addr, uint32_t code, MBInstrCB cb, void* pWkMem) {
 	imm >>= 16;
 	if ((op & ~6) == 0) {
 		if ((op & 6) == 6) {
-			pOpName = "addkc";
+			opId = MBOP_ADDKC;
 		} else if ((op & 6) == 2) {
-			pOpName = "addc";
+			opId = MBOP_ADDC;
 		} else if ((op & 6) == 4) {
-			pOpName = "addk";
+			opId = MBOP_ADDK;
 		} else {
-			pOpName = "add";
+			opId = MBOP_ADD;
 		}
 	} else if ((op & ~6) == 8) {
 		if ((op & 6) == 6) {
-			pOpName = "addikc";
+			opId = MBOP_ADDIKC;
 		} else if ((op & 6) == 2) {
-			pOpName = "addic";
+			opId = MBOP_ADDIC;
 		} else if ((op & 6) == 4) {
-			pOpName = "addik";
+			opId = MBOP_ADDIK;
 		} else {
-			pOpName = "addi";
+			opId = MBOP_ADDI;
 		}
 		rB = -1;
 	} else if ((op & ~6) == 1) {
 		if ((op & 6) == 6) {
-			pOpName = "rsubkc";
+			opId = MBOP_RSUBKC;
 		} else if ((op & 6) == 2) {
-			pOpName = "rsubc";
+			opId = MBOP_RSUBC;
 		} else if ((op & 6) == 4) {
-			pOpName = "rsubk";
+			opId = MBOP_RSUBK;
 		} else {
-			pOpName = "rsub";
+			opId = MBOP_RSUB;
 		}
 	} else if ((op & ~6) == 9) {
 		if ((op & 6) == 6) {
-			pOpName = "rsubikc";
+			opId = MBOP_RSUBIKC;
 		} else if ((op & 6) == 2) {
-			pOpName = "rsubic";
+			opId = MBOP_RSUBIC;
 		} else if ((op & 6) == 4) {
-			pOpName = "rsubik";
+			opId = MBOP_RSUBIK;
 		} else {
-			pOpName = "rsubi";
+			opId = MBOP_RSUBI;
 		}
 		rB = -1;
 	} else if (op == 0x21) {
-		pOpName = "and";
+		opId = MBOP_AND;
 	} else if (op == 0x29) {
-		pOpName = "andi";
+		opId = MBOP_ANDI;
 		rB = -1;
 	} else if (op == 0x23) {
 		if ((imm >> 10) & 1) {
-			pOpName = "pcmpne";
+			opId = MBOP_PCMPNE;
 		} else {
-			pOpName = "andn";
+			opId = MBOP_ANDN;
 		}
 	} else if (op == 0x2B) {
-		pOpName = "andni";
+		opId = MBOP_ANDNI;
 		rB = -1;
 	} else if (op == 0x27) {
 		if (rD == 0) {
-			pOpName = "beq";
+			opId = MBOP_BEQ;
 		} else if (rD == 0x10) {
-			pOpName = "beqd";
+			opId = MBOP_BEQD;
 		} else if (rD == 5) {
-			pOpName = "bge";
+			opId = MBOP_BGE;
 		} else if (rD == 0x15) {
-			pOpName = "bged";
+			opId = MBOP_BGED;
 		} else if (rD == 4) {
-			pOpName = "bgt";
+			opId = MBOP_BGT;
 		} else if (rD == 0x14) {
-			pOpName = "bgtd";
+			opId = MBOP_BGTD;
 		} else if (rD == 3) {
-			pOpName = "ble";
+			opId = MBOP_BLE;
 		} else if (rD == 0x13) {
-			pOpName = "bled";
+			opId = MBOP_BLED;
 		} else if (rD == 2) {
-			pOpName = "blt";
+			opId = MBOP_BLT;
 		} else if (rD == 0x12) {
-			pOpName = "bltd";
+			opId = MBOP_BLTD;
 		} else if (rD == 1) {
-			pOpName = "bne";
+			opId = MBOP_BNE;
 		} else if (rD == 0x11) {
-			pOpName = "bned";
+			opId = MBOP_BNED;
 		}
 		rD = -1;
 	} else if (op == 0x2F) {
 		if (rD == 0) {
-			pOpName = "beqi";
+			opId = MBOP_BEQI;
 		} else if (rD == 0x10) {
-			pOpName = "beqid";
+			opId = MBOP_BEQID;
 		} else if (rD == 5) {
-			pOpName = "bgei";
+			opId = MBOP_BGEI;
 		} else if (rD == 0x15) {
-			pOpName = "bgedi";
+			opId = MBOP_BGEDI;
 		} else if (rD == 4) {
-			pOpName = "bgti";
+			opId = MBOP_BGTI;
 		} else if (rD == 0x14) {
-			pOpName = "bgtid";
+			opId = MBOP_BGTID;
 		} else if (rD == 3) {
-			pOpName = "blei";
+			opId = MBOP_BLEI;
 		} else if (rD == 0x13) {
-			pOpName = "bleid";
+			opId = MBOP_BLEID;
 		} else if (rD == 2) {
-			pOpName = "blti";
+			opId = MBOP_BLTI;
 		} else if (rD == 0x12) {
-			pOpName = "bltid";
+			opId = MBOP_BLTID;
 		} else if (rD == 1) {
-			pOpName = "bnei";
+			opId = MBOP_BNEI;
 		} else if (rD == 0x11) {
-			pOpName = "bneid";
+			opId = MBOP_BNEID;
 		}
 		rB = -1;
 		rD = -1;
 	} else if (op == 0x26) {
 		if (rA == 0xC) {
-			pOpName = "brk";
+			opId = MBOP_BRK;
 		} else {
 			if (rA & 0x10) {
 				int al = (rA >> 2) & 3;
 				if (al == 0) {
-					pOpName = "brd";
+					opId = MBOP_BRD;
 				} else if (al == 1) {
-					pOpName = "brld";
+					opId = MBOP_BRLD;
 				} else if (al == 2) {
-					pOpName = "brad";
+					opId = MBOP_BRAD;
 				} else {
-					pOpName = "brald";
+					opId = MBOP_BRALD;
 				}
 			} else {
 				if (rA & 8) {
-					pOpName = "bra";
+					opId = MBOP_BRA;
 				} else {
-					pOpName = "br";
+					opId = MBOP_BR;
 				}
 				rD = -1;
 			}
@@ -210,9 +798,9 @@ static void instr(uint32_t addr, uint32_t code, MBInstrCB cb, void* pWkMem) {
 		rA = -1;
 	} else if (op == 0x2E) {
 		if (rA == 0xC) {
-			pOpName = "brki";
+			opId = MBOP_BRKI;
 		} else if (rA == 2) {
-			pOpName = "mbar";
+			opId = MBOP_MBAR;
 			imm = rD;
 			rD = -1;
 			rA = -1;
@@ -221,21 +809,21 @@ static void instr(uint32_t addr, uint32_t code, MBInstrCB cb, void* pWkMem) {
 			if (rA & 0x10) {
 				int al = (rA >> 2) & 3;
 				if (al == 0) {
-					pOpName = "brid";
+					opId = MBOP_BRID;
 					rD = -1;
 				} else if (al == 1) {
-					pOpName = "brlid";
+					opId = MBOP_BRLID;
 				} else if (al == 2) {
-					pOpName = "braid";
+					opId = MBOP_BRAID;
 					rD = -1;
 				} else {
-					pOpName = "bralid";
+					opId = MBOP_BRALID;
 				}
 			} else {
 				if (rA & 8) {
-					pOpName = "brai";
+					opId = MBOP_BRAI;
 				} else {
-					pOpName = "bri";
+					opId = MBOP_BRI;
 				}
 				rD = -1;
 			}
@@ -245,268 +833,379 @@ static void instr(uint32_t addr, uint32_t code, MBInstrCB cb, void* pWkMem) {
 	} else if (op == 0x11) {
 		int st = (imm >> 9) & 3;
 		if (st == 0) {
-			pOpName = "bsrl";
+			opId = MBOP_BSRL;
 		} else if (st == 1) {
-			pOpName = "bsra";
+			opId = MBOP_BSRA;
 		} else if (st == 2) {
-			pOpName = "bsll";
+			opId = MBOP_BSLL;
 		}
 	} else if (op == 0x19) {
 		int st = (imm >> 9) & 3;
 		if (st == 0) {
-			pOpName = "bsrli";
+			opId = MBOP_BSRLI;
 		} else if (st == 1) {
-			pOpName = "bsrai";
+			opId = MBOP_BSRAI;
 		} else if (st == 2) {
-			pOpName = "bslli";
+			opId = MBOP_BSLLI;
 		}
 		imm &= 0x1F;
 		rB = -1;
 	} else if (op == 0x24) {
 		if (rB == 0 ) {
 			if (imm == 0xE0) {
-				pOpName = "clz";
+				opId = MBOP_CLZ;
 			} else if (imm == 0x61) {
-				pOpName = "sext16";
+				opId = MBOP_SEXT16;
 			} else if (imm == 0x60) {
-				pOpName = "sext8";
+				opId = MBOP_SEXT8;
 			} else if (imm == 1) {
-				pOpName = "sra";
+				opId = MBOP_SRA;
 			} else if (imm == 0x21) {
-				pOpName = "src";
+				opId = MBOP_SRC;
 			} else if (imm == 0x41) {
-				pOpName = "srl";
+				opId = MBOP_SRL;
 			} else if (imm == 0x1E0) {
-				pOpName = "swapb";
+				opId = MBOP_SWAPB;
 			} else if (imm == 0x1E2) {
-				pOpName = "swaph";
+				opId = MBOP_SWAPH;
 			}
 			opr3 = 0;
 		} else {
-			pOpName = "-- wdc/wic --";
+			opId = MBOP_WDC_WIC;
 		}
 	} else if (op == 0x5) {
 		imm &= 0x3FF;
 		if (imm == 1) {
-			pOpName = "cmp";
+			opId = MBOP_CMP;
 		} else if (imm == 3) {
-			pOpName = "cmpu";
+			opId = MBOP_CMPU;
 		}
 	} else if (op == 0x16) {
 		int subop = (imm >> 7) & 0xF;
 		if (subop == 0) {
-			pOpName = "fadd";
+			opId = MBOP_FADD;
 		} else if (subop == 1) {
-			pOpName = "frsub";
+			opId = MBOP_FRSUB;
 		} else if (subop == 2) {
-			pOpName = "fmul";
+			opId = MBOP_FMUL;
 		} else if (subop == 3) {
-			pOpName = "fdiv";
+			opId = MBOP_FDIV;
 		} else if (subop == 4) {
 			int cmpo = (imm >> 4) & 0xF;
 			if (cmpo == 0) {
-				pOpName = "fcmp.un";
+				opId = MBOP_FCMP_UN;
 			} else if (cmpo == 1) {
-				pOpName = "fcmp.lt";
+				opId = MBOP_FCMP_LT;
 			} else if (cmpo == 2) {
-				pOpName = "fcmp.eq";
+				opId = MBOP_FCMP_EQ;
 			} else if (cmpo == 3) {
-				pOpName = "fcmp.le";
+				opId = MBOP_FCMP_LE;
 			} else if (cmpo == 4) {
-				pOpName = "fcmp.gt";
+				opId = MBOP_FCMP_GT;
 			} else if (cmpo == 5) {
-				pOpName = "fcmp.ne";
+				opId = MBOP_FCMP_NE;
 			} else if (cmpo == 6) {
-				pOpName = "fcmp.ge";
+				opId = MBOP_FCMP_GE;
 			}
 		} else if (subop == 5) {
-			pOpName = "flt";
+			opId = MBOP_FLT;
 			opr3 = 0;
 		} else if (subop == 6) {
-			pOpName = "fint";
+			opId = MBOP_FINT;
 			opr3 = 0;
 		} else if (subop == 7) {
-			pOpName = "fsqrt";
+			opId = MBOP_FSQRT;
 			opr3 = 0;
 		}
 	} else if (op == 0x1B) {
 		if ((imm >> 15) & 1) {
-			pOpName = "-- put --";
+			opId = MBOP_PUT;
 		} else {
-			pOpName = "-- get --";
+			opId = MBOP_GET;
 		}
 	} else if (op == 0x13) {
 		if ((imm >> 10) & 1) {
-			pOpName = "-- putd --";
+			opId = MBOP_PUTD;
 		} else {
-			pOpName = "-- getd --";
+			opId = MBOP_GETD;
 		}
 	} else if (op == 0x12) {
-		pOpName = "idiv";
+		opId = MBOP_IDIV;
 	} else if (op == 0x2C) {
-		pOpName = "imm";
+		opId = MBOP_IMM;
 		imm &= 0xFFFF;
 		rD = -1;
 		rA = -1;
 		rB = -1;
 	} else if (op == 0x30) {
 		if (imm & (1 << 7)) {
-			pOpName = "lbuea";
+			opId = MBOP_LBUEA;
 		} else {
 			if (imm & (1 << 9)) {
-				pOpName = "lbur";
+				opId = MBOP_LBUR;
 			} else {
-				pOpName = "lbu";
+				opId = MBOP_LBU;
 			}
 		}
 	} else if (op == 0x38) {
-		pOpName = "lbui";
+		opId = MBOP_LBUI;
 		rB = -1;
 	} else if (op == 0x31) {
 		if (imm & (1 << 7)) {
-			pOpName = "lhuea";
+			opId = MBOP_LHUEA;
 		} else {
 			if (imm & (1 << 9)) {
-				pOpName = "lhur";
+				opId = MBOP_LHUR;
 			} else {
-				pOpName = "lhu";
+				opId = MBOP_LHU;
 			}
 		}
 	} else if (op == 0x39) {
-		pOpName = "lhui";
+		opId = MBOP_LHUI;
 		rB = -1;
 	} else if (op == 0x32) {
 		if (imm & (1 << 10)) {
-			pOpName = "lwx";
+			opId = MBOP_LWX;
 		} else {
 			if (imm & (1 << 7)) {
-				pOpName = "lwea";
+				opId = MBOP_LWEA;
 			} else {
 				if (imm & (1 << 9)) {
-					pOpName = "lwr";
+					opId = MBOP_LWR;
 				} else {
-					pOpName = "lw";
+					opId = MBOP_LW;
 				}
 			}
 		}
 	} else if (op == 0x3A) {
-		pOpName = "lwi";
+		opId = MBOP_LWI;
 		rB = -1;
 	} else if (op == 0x25) {
-		pOpName = "-- mfs/msrclr/msrset/mts -- ";
+		opId = MBOP_MSR;
 	} else if (op == 0x10) {
 		imm &= 0x7FF;
 		if (imm == 0) {
-			pOpName = "mul";
+			opId = MBOP_MUL;
 		} else if (imm == 1) {
-			pOpName = "mulh";
+			opId = MBOP_MULH;
 		} else if (imm == 2) {
-			pOpName = "mulhsu";
+			opId = MBOP_MULHSU;
 		} else if (imm == 3) {
-			pOpName = "mulhu";
+			opId = MBOP_MULHU;
 		}
 	} else if (op == 0x18) {
-		pOpName = "muli";
+		opId = MBOP_MULI;
 		rB = -1;
 	} else if (op == 0x20) {
 		if ((imm >> 10) & 1) {
-			pOpName = "pcmpbf";
+			opId = MBOP_PCMPBF;
 		} else {
-			pOpName = "or";
+			opId = MBOP_OR;
 		}
 	} else if (op == 0x28) {
-		pOpName = "ori";
+		opId = MBOP_ORI;
 		rB = -1;
 	} else if (op == 0x22) {
 		if ((imm >> 10) & 1) {
-			pOpName = "pcmpeq";
+			opId = MBOP_PCMPEQ;
 		} else {
-			pOpName = "xor";
+			opId = MBOP_XOR;
 		}
 	} else if (op == 0x2D) {
 		if (rD == 0x12) {
-			pOpName = "rtbd";
+			opId = MBOP_RTBD;
 		} else if (rD == 0x11) {
-			pOpName = "rtid";
+			opId = MBOP_RTID;
 		} else if (rD == 0x14) {
-			pOpName = "rted";
+			opId = MBOP_RTED;
 		} else if (rD == 0x10) {
-			pOpName = "rtsd";
+			opId = MBOP_RTSD;
 		}
 		rD = -1;
 		rB = -1;
 	} else if (op == 0x34) {
 		if (imm & (1 << 7)) {
-			pOpName = "sbea";
+			opId = MBOP_SBEA;
 		} else {
 			if (imm & (1 << 9)) {
-				pOpName = "sbr";
+				opId = MBOP_SBR;
 			} else {
-				pOpName = "sb";
+				opId = MBOP_SB;
 			}
 		}
 	} else if (op == 0x3C) {
-		pOpName = "sbi";
+		opId = MBOP_SBI;
 		rB = -1;
 	} else if (op == 0x35) {
 		if (imm & (1 << 7)) {
-			pOpName = "shea";
+			opId = MBOP_SHEA;
 		} else {
 			if (imm & (1 << 9)) {
-				pOpName = "shr";
+				opId = MBOP_SHR;
 			} else {
-				pOpName = "sh";
+				opId = MBOP_SH;
 			}
 		}
 	} else if (op == 0x3D) {
-		pOpName = "shi";
+		opId = MBOP_SHI;
 		rB = -1;
 	} else if (op == 0x36) {
 		if (imm & (1 << 7)) {
-			pOpName = "swea";
+			opId = MBOP_SWEA;
 		} else if (imm & (1 << 10)) {
-			pOpName = "swx";
+			opId = MBOP_SWX;
 		} else {
 			if (imm & (1 << 9)) {
-				pOpName = "swr";
+				opId = MBOP_SWR;
 			} else {
-				pOpName = "sw";
+				opId = MBOP_SW;
 			}
 		}
 	} else if (op == 0x3E) {
-		pOpName = "swi";
+		opId = MBOP_SWI;
 		rB = -1;
 	} else if (op == 0x2A) {
-		pOpName = "xori";
+		opId = MBOP_XORI;
 		rB = -1;
 	}
+	pInstr->addr = addr;
+	pInstr->code = code;
+	pInstr->op = opId;
+	pInstr->rD = rD;
+	pInstr->rA = rA;
+	pInstr->rB = rB;
+	pInstr->imm = imm;
+	pInstr->opr3 = opr3;
+}
+
+const char* dismb_op_name(MBOp op) {
+	return (uint32_t)op < MBOP_NUM ? s_opNames[op] : "";
+}
 
+uint32_t dismb_op_flags(MBOp op) {
+	uint32_t flags = 0;
+	switch (op) {
+		case MBOP_BEQ: case MBOP_BGE: case MBOP_BGT: case MBOP_BLE: case MBOP_BLT: case MBOP_BNE:
+		case MBOP_BEQI: case MBOP_BGEI: case MBOP_BGTI: case MBOP_BLEI: case MBOP_BLTI: case MBOP_BNEI:
+			flags = MBOPF_BRANCH | MBOPF_COND;
+			break;
+		case MBOP_BEQD: case MBOP_BGED: case MBOP_BGTD: case MBOP_BLED: case MBOP_BLTD: case MBOP_BNED:
+		case MBOP_BEQID: case MBOP_BGEDI: case MBOP_BGTID: case MBOP_BLEID: case MBOP_BLTID: case MBOP_BNEID:
+			flags = MBOPF_BRANCH | MBOPF_COND | MBOPF_DELAY;
+			break;
+		case MBOP_BR: flags = MBOPF_BRANCH | MBOPF_REG; break;
+		case MBOP_BRA: flags = MBOPF_BRANCH | MBOPF_REG | MBOPF_ABS; break;
+		case MBOP_BRD: flags = MBOPF_BRANCH | MBOPF_REG | MBOPF_DELAY; break;
+		case MBOP_BRAD: flags = MBOPF_BRANCH | MBOPF_REG | MBOPF_ABS | MBOPF_DELAY; break;
+		case MBOP_BRLD: flags = MBOPF_BRANCH | MBOPF_REG | MBOPF_DELAY | MBOPF_LINK; break;
+		case MBOP_BRALD: flags = MBOPF_BRANCH | MBOPF_REG | MBOPF_ABS | MBOPF_DELAY | MBOPF_LINK; break;
+		case MBOP_BRK: flags = MBOPF_BRANCH | MBOPF_REG | MBOPF_ABS | MBOPF_LINK; break;
+		case MBOP_BRI: flags = MBOPF_BRANCH; break;
+		case MBOP_BRAI: flags = MBOPF_BRANCH | MBOPF_ABS; break;
+		case MBOP_BRID: flags = MBOPF_BRANCH | MBOPF_DELAY; break;
+		case MBOP_BRAID: flags = MBOPF_BRANCH | MBOPF_ABS | MBOPF_DELAY; break;
+		case MBOP_BRLID: flags = MBOPF_BRANCH | MBOPF_DELAY | MBOPF_LINK; break;
+		case MBOP_BRALID: flags = MBOPF_BRANCH | MBOPF_ABS | MBOPF_DELAY | MBOPF_LINK; break;
+		case MBOP_BRKI: flags = MBOPF_BRANCH | MBOPF_ABS | MBOPF_LINK; break;
+		case MBOP_RTSD: case MBOP_RTID: case MBOP_RTBD: case MBOP_RTED:
+			flags = MBOPF_BRANCH | MBOPF_REG | MBOPF_DELAY | MBOPF_RETURN;
+			break;
+		case MBOP_LBU: case MBOP_LBUR: case MBOP_LBUEA: case MBOP_LBUI:
+			flags = MBOPF_LOAD | MBOPF_MEM8;
+			break;
+		case MBOP_LHU: case MBOP_LHUR: case MBOP_LHUEA: case MBOP_LHUI:
+			flags = MBOPF_LOAD | MBOPF_MEM16;
+			break;
+		case MBOP_LW: case MBOP_LWR: case MBOP_LWEA: case MBOP_LWX: case MBOP_LWI:
+			flags = MBOPF_LOAD | MBOPF_MEM32;
+			break;
+		case MBOP_SB: case MBOP_SBR: case MBOP_SBEA: case MBOP_SBI:
+			flags = MBOPF_STORE | MBOPF_MEM8;
+			break;
+		case MBOP_SH: case MBOP_SHR: case MBOP_SHEA: case MBOP_SHI:
+			flags = MBOPF_STORE | MBOPF_MEM16;
+			break;
+		case MBOP_SW: case MBOP_SWR: case MBOP_SWEA: case MBOP_SWX: case MBOP_SWI:
+			flags = MBOPF_STORE | MBOPF_MEM32;
+			break;
+		case MBOP_FADD: case MBOP_FRSUB: case MBOP_FMUL: case MBOP_FDIV:
+		case MBOP_FCMP_UN: case MBOP_FCMP_LT: case MBOP_FCMP_EQ: case MBOP_FCMP_LE:
+		case MBOP_FCMP_GT: case MBOP_FCMP_NE: case MBOP_FCMP_GE:
+		case MBOP_FLT: case MBOP_FINT: case MBOP_FSQRT:
+			flags = MBOPF_FPU;
+			break;
+		case MBOP_MUL: case MBOP_MULH: case MBOP_MULHSU: case MBOP_MULHU: case MBOP_MULI:
+			flags = MBOPF_MUL;
+			break;
+		case MBOP_BSRL: case MBOP_BSRA: case MBOP_BSLL: case MBOP_BSRLI: case MBOP_BSRAI: case MBOP_BSLLI:
+			flags = MBOPF_SHIFT;
+			break;
+		default:
+			break;
+	}
+	return flags;
+}
+
+/* full 32-bit immediate of a type B instruction, fused with a preceding imm */
+int32_t dismb_fuse_imm(const MBInstr* pPrev, const MBInstr* pInstr) {
+	int32_t imm = pInstr->imm;
+	if (pPrev && pPrev->op == MBOP_IMM && ((pInstr->code >> 26) & 8)) {
+		imm = (int32_t)(((uint32_t)pPrev->imm << 16) | (pInstr->code & 0xFFFF));
+	}
+	return imm;
+}
+
+static void instr(uint32_t addr, uint32_t code, MBInstrCB cb, void* pWkMem, MBTextFn outFn, void* pOutCtx) {
+	MBInstr ins;
+	const char* pOpName;
+	int32_t rD;
+	int32_t rA;
+	int32_t rB;
+	int32_t imm;
+	int opr3;
+	dismb_decode(addr, code, &ins);
+	pOpName = s_opNames[ins.op];
+	rD = ins.rD;
+	rA = ins.rA;
+	rB = ins.rB;
+	imm = ins.imm;
+	opr3 = ins.opr3;
 	if (cb) {
 		cb(pWkMem, addr, code, pOpName, rD, rA, rB, imm);
 	} else {
-		printf("%08X: %08X   %s\t", addr, code, pOpName);
+		char line[128];
+		int len = snprintf(line, sizeof(line), "%08X: %08X   %s\t", addr, code, pOpName);
 		if (rD >= 0) {
-			printf("r%d, ", rD);
+			len += snprintf(line + len, sizeof(line) - len, "r%d, ", rD);
 		}
 		if (rA >= 0) {
-			printf("r%d%s", rA, opr3 ? ", " : "");
+			len += snprintf(line + len, sizeof(line) - len, "r%d%s", rA, opr3 ? ", " : "");
 		}
 		if (opr3) {
 			if (rB >= 0) {
-				printf("r%d", rB);
+				len += snprintf(line + len, sizeof(line) - len, "r%d", rB);
 			} else {
-				printf("%d", imm);
+				len += snprintf(line + len, sizeof(line) - len, "%d", imm);
 			}
 		}
-		printf("\n");
+		len += snprintf(line + len, sizeof(line) - len, "\n");
+		dismb_text_out(outFn, pOutCtx, line, len);
 	}
 }
 
 void dismb_func(MBDisasm* pDis, int ifunc) {
+	dismb_func_out(pDis, ifunc, NULL, NULL);
+}
+
+void dismb_func_out(MBDisasm* pDis, int ifunc, MBTextFn fn, void* pCtx) {
+	char line[256];
+	int len;
 	uint32_t i;
 	uint32_t addr;
 	uint32_t offs;
 	uint32_t ninstrs;
+	uint32_t lastLine = 0;
+	const char* pLastFile = NULL;
 	if (!pDis) {
 		return;
 	}
@@ -517,17 +1216,24 @@ void dismb_func(MBDisasm* pDis, int ifunc) {
 	addr = pDis->pFuncs[ifunc].addr;
 	offs = pDis->textOffs + (addr - pDis->textAddr);
 	ninstrs = pDis->pFuncs[ifunc].size / 4;
-	printf("function \"%s\": addr=0x%X, offs=0x%X, #instrs=%d\n", pDis->pFuncs[ifunc].pName, addr, offs, ninstrs);
+	len = snprintf(line, sizeof(line), "function \"%s\": addr=0x%X, offs=0x%X, #instrs=%d\n", pDis->pFuncs[ifunc].pName, addr, offs, ninstrs);
+	dismb_text_out(fn, pCtx, line, len < (int)sizeof(line) ? len : (int)sizeof(line) - 1);
 	for (i = 0; i < ninstrs; ++i) {
-		uint32_t code = elfi32_read_u32(pDis->pELF, offs);
-		instr(addr, code, NULL, NULL);
+		uint32_t code = text_word(pDis, addr);
+		elfi32_lineinfo info;
+		if (pDis->lineFn && pDis->lineFn(pDis->pLines, addr, &info) && (info.line != lastLine || info.pFile != pLastFile)) {
+			len = snprintf(line, sizeof(line), "; %s:%u\n", info.pFile, info.line);
+			dismb_text_out(fn, pCtx, line, len < (int)sizeof(line) ? len : (int)sizeof(line) - 1);
+			lastLine = info.line;
+			pLastFile = info.pFile;
+		}
+		instr(addr, code, NULL, NULL, fn, pCtx);
 		offs += 4;
 		addr += 4;
 	}
 }
 
 void dismb_instr(MBDisasm* pDis, uint32_t addr, MBInstrCB cb, void* pWkMem) {
-	uint32_t offs;
 	uint32_t code;
 	if (!pDis) {
 		return;
@@ -538,7 +1244,6 @@ void dismb_instr(MBDisasm* pDis, uint32_t addr, MBInstrCB cb, void* pWkMem) {
 	if (addr >= pDis->textAddr + pDis->textSize) {
 		return;
 	}
-	offs = pDis->textOffs + (addr - pDis->textAddr);
-	code = elfi32_read_u32(pDis->pELF, offs);
-	instr(addr, code, cb, pWkMem);
+	code = text_word(pDis, addr);
+	instr(addr, code, cb, pWkMem, NULL, NULL);
 }
@@ -1,9 +1,218 @@
+
+
+#ifndef DISASM_MICROBLAZE_H
+#define DISASM_MICROBLAZE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef struct _MBFunc {
 	const char* pName;
 	uint32_t addr;
 	uint32_t size;
 } MBFunc;
 
+typedef struct _MBAddrIdx {
+	uint32_t addr;
+	uint32_t size;
+	int ifunc;
+} MBAddrIdx;
+
+typedef struct _MBSection {
+	const char* pName;
+	uint32_t type;
+	uint32_t flags;
+	uint32_t addr;
+	uint32_t offs;
+	uint32_t size;
+} MBSection;
+
+typedef enum _MBOp {
+	MBOP_NONE,
+	MBOP_ADDKC,
+	MBOP_ADDC,
+	MBOP_ADDK,
+	MBOP_ADD,
+	MBOP_ADDIKC,
+	MBOP_ADDIC,
+	MBOP_ADDIK,
+	MBOP_ADDI,
+	MBOP_RSUBKC,
+	MBOP_RSUBC,
+	MBOP_RSUBK,
+	MBOP_RSUB,
+	MBOP_RSUBIKC,
+	MBOP_RSUBIC,
+	MBOP_RSUBIK,
+	MBOP_RSUBI,
+	MBOP_AND,
+	MBOP_ANDI,
+	MBOP_PCMPNE,
+	MBOP_ANDN,
+	MBOP_ANDNI,
+	MBOP_BEQ,
+	MBOP_BEQD,
+	MBOP_BGE,
+	MBOP_BGED,
+	MBOP_BGT,
+	MBOP_BGTD,
+	MBOP_BLE,
+	MBOP_BLED,
+	MBOP_BLT,
+	MBOP_BLTD,
+	MBOP_BNE,
+	MBOP_BNED,
+	MBOP_BEQI,
+	MBOP_BEQID,
+	MBOP_BGEI,
+	MBOP_BGEDI,
+	MBOP_BGTI,
+	MBOP_BGTID,
+	MBOP_BLEI,
+	MBOP_BLEID,
+	MBOP_BLTI,
+	MBOP_BLTID,
+	MBOP_BNEI,
+	MBOP_BNEID,
+	MBOP_BRK,
+	MBOP_BRD,
+	MBOP_BRLD,
+	MBOP_BRAD,
+	MBOP_BRALD,
+	MBOP_BRA,
+	MBOP_BR,
+	MBOP_BRKI,
+	MBOP_MBAR,
+	MBOP_BRID,
+	MBOP_BRLID,
+	MBOP_BRAID,
+	MBOP_BRALID,
+	MBOP_BRAI,
+	MBOP_BRI,
+	MBOP_BSRL,
+	MBOP_BSRA,
+	MBOP_BSLL,
+	MBOP_BSRLI,
+	MBOP_BSRAI,
+	MBOP_BSLLI,
+	MBOP_CLZ,
+	MBOP_SEXT16,
+	MBOP_SEXT8,
+	MBOP_SRA,
+	MBOP_SRC,
+	MBOP_SRL,
+	MBOP_SWAPB,
+	MBOP_SWAPH,
+	MBOP_WDC_WIC,
+	MBOP_CMP,
+	MBOP_CMPU,
+	MBOP_FADD,
+	MBOP_FRSUB,
+	MBOP_FMUL,
+	MBOP_FDIV,
+	MBOP_FCMP_UN,
+	MBOP_FCMP_LT,
+	MBOP_FCMP_EQ,
+	MBOP_FCMP_LE,
+	MBOP_FCMP_GT,
+	MBOP_FCMP_NE,
+	MBOP_FCMP_GE,
+	MBOP_FLT,
+	MBOP_FINT,
+	MBOP_FSQRT,
+	MBOP_PUT,
+	MBOP_GET,
+	MBOP_PUTD,
+	MBOP_GETD,
+	MBOP_IDIV,
+	MBOP_IMM,
+	MBOP_LBUEA,
+	MBOP_LBUR,
+	MBOP_LBU,
+	MBOP_LBUI,
+	MBOP_LHUEA,
+	MBOP_LHUR,
+	MBOP_LHU,
+	MBOP_LHUI,
+	MBOP_LWX,
+	MBOP_LWEA,
+	MBOP_LWR,
+	MBOP_LW,
+	MBOP_LWI,
+	MBOP_MSR,
+	MBOP_MUL,
+	MBOP_MULH,
+	MBOP_MULHSU,
+	MBOP_MULHU,
+	MBOP_MULI,
+	MBOP_PCMPBF,
+	MBOP_OR,
+	MBOP_ORI,
+	MBOP_PCMPEQ,
+	MBOP_XOR,
+	MBOP_RTBD,
+	MBOP_RTID,
+	MBOP_RTED,
+	MBOP_RTSD,
+	MBOP_SBEA,
+	MBOP_SBR,
+	MBOP_SB,
+	MBOP_SBI,
+	MBOP_SHEA,
+	MBOP_SHR,
+	MBOP_SH,
+	MBOP_SHI,
+	MBOP_SWEA,
+	MBOP_SWX,
+	MBOP_SWR,
+	MBOP_SW,
+	MBOP_SWI,
+	MBOP_XORI,
+	MBOP_NUM
+} MBOp;
+
+#define MBOPF_BRANCH 0x0001
+#define MBOPF_COND 0x0002
+#define MBOPF_DELAY 0x0004
+#define MBOPF_LINK 0x0008
+#define MBOPF_ABS 0x0010
+#define MBOPF_REG 0x0020 /* target in a register */
+#define MBOPF_RETURN 0x0040
+#define MBOPF_LOAD 0x0100
+#define MBOPF_STORE 0x0200
+#define MBOPF_MEM8 0x0400
+#define MBOPF_MEM16 0x0800
+#define MBOPF_MEM32 0x1000
+#define MBOPF_FPU 0x2000
+#define MBOPF_MUL 0x4000
+#define MBOPF_SHIFT 0x8000
+
+typedef struct _MBInstr {
+	uint32_t addr;
+	uint32_t code;
+	MBOp op;
+	int32_t rD;
+	int32_t rA;
+	int32_t rB;
+	int32_t imm;
+	int opr3;
+} MBInstr;
+
+struct _MBArenaBlk;
+
+typedef struct _MBArena {
+	struct _MBArenaBlk* pTop;
+	struct _MBArenaBlk* pCur;
+	size_t blkSize;
+} MBArena;
+
+struct _elfi32_lines;
+struct _elfi32_lineinfo;
+
+/* elfi32_lines_lookup() or compatible, so the core does not depend on the DWARF reader */
+typedef int (*MBLineFn)(const struct _elfi32_lines* pLines, uint32_t addr, struct _elfi32_lineinfo* pInfo);
+
 typedef struct _MBDisasm {
 	void* pELF;
 	size_t elfSize;
@@ -13,6 +222,22 @@ typedef struct _MBDisasm {
 	uint32_t textSize;
 	int numFuncs;
 	MBFunc* pFuncs;
+	/* see dismb_build_addr_index() */
+	MBAddrIdx* pAddrIdx;
+	/* see dismb_set_lines() */
+	const struct _elfi32_lines* pLines;
+	MBLineFn lineFn;
+	/* see dismb_refresh() */
+	int numSectHashes;
+	struct _MBSectHash* pSectHashes;
+	/* set by dismb_compact() */
+	int numSects;
+	MBSection* pSects;
+	uint32_t* pText;
+	/* kept across dismb_load() calls */
+	MBArena arena;
+	void* pImgBuf;
+	size_t imgBufSize;
 } MBDisasm;
 
 typedef void (*MBInstrCB)
@@ -20,8 +245,40 @@ typedef void (*MBInstrCB)
 const char* pOpName,
 int32_t rD, int32_t rA, int32_t rB, int32_t imm);
 
+typedef void (*MBWalkFn)(const MBInstr* pPrev, const MBInstr* pInstr, void* pCtx);
+typedef void (*MBTextFn)(void* pCtx, const char* pText, size_t len);
+
+void dismb_arena_init(MBArena* pArena, size_t blkSize);
+void* dismb_arena_alloc(MBArena* pArena, size_t size);
+void dismb_arena_reset(MBArena* pArena);
+void dismb_arena_free(MBArena* pArena);
+
 int dismb_init(MBDisasm* pDis, const char* pElfPath);
+int dismb_load(MBDisasm* pDis, const char* pElfPath);
+int dismb_load_ex(MBDisasm* pDis, const char* pElfPath, int verbose);
+int dismb_load_image(MBDisasm* pDis, void* pELF, size_t size, int verbose);
+void dismb_reset(MBDisasm* pDis);
+void dismb_free(MBDisasm* pDis);
+int dismb_compact(MBDisasm* pDis);
+void dismb_decode(uint32_t addr, uint32_t code, MBInstr* pInstr);
+const char* dismb_op_name(MBOp op);
+uint32_t dismb_op_flags(MBOp op);
+int32_t dismb_fuse_imm(const MBInstr* pPrev, const MBInstr* pInstr);
+uint32_t dismb_read_words(MBDisasm* pDis, uint32_t addr, uint32_t* pDst, uint32_t n);
+void dismb_walk_func(MBDisasm* pDis, int ifunc, MBWalkFn fn, void* pCtx);
 int dismb_find_func(MBDisasm* pDis, const char* pName);
+int dismb_build_addr_index(MBDisasm* pDis);
+int dismb_func_at(MBDisasm* pDis, uint32_t addr);
+void dismb_set_lines(MBDisasm* pDis, const struct _elfi32_lines* pLines, MBLineFn lineFn);
+int dismb_resolve_pc(MBDisasm* pDis, uint32_t addr, char* pBuf, size_t bufSize);
 void dismb_func(MBDisasm* pDis, int ifunc);
+void dismb_func_out(MBDisasm* pDis, int ifunc, MBTextFn fn, void* pCtx);
+void dismb_text_out(MBTextFn fn, void* pCtx, const char* pText, int len);
+void dismb_text_printf(MBTextFn fn, void* pCtx, const char* pFmt, ...);
 void dismb_instr(MBDisasm* pDis, uint32_t addr, MBInstrCB cb, void* pWkMem);
 
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,218 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "elfi32.h"
+#include "disasm_microblaze.h"
+#include "dismb_batch.h"
+
+typedef struct _MBText {
+	char* pBuf;
+	size_t len;
+	size_t cap;
+} MBText;
+
+typedef struct _MBBatchSlot {
+	MBText text;
+	int ok;
+	int ready;
+} MBBatchSlot;
+
+struct _MBBatch {
+	WkPool* pPool;
+	int nworkers;
+	int window;
+	MBDisasm* pWk;
+	MBBatchSlot* pSlots;
+	pthread_mutex_t mtx;
+	pthread_cond_t cv;
+	/* per-run state */
+	const char** ppPaths;
+	int npaths;
+	MBBatchMode mode;
+	MBBatchFn fn;
+	void* pCtx;
+	int nextEmit;
+	int nok;
+};
+
+static void text_append(void* pCtx, const char* pStr, size_t len) {
+	MBText* pText = (MBText*)pCtx;
+	if (pText->len + len + 1 > pText->cap) {
+		size_t cap = pText->cap ? pText->cap : 4096;
+		char* pBuf;
+		while (cap < pText->len + len + 1) {
+			cap *= 2;
+		}
+		pBuf = (char*)realloc(pText->pBuf, cap);
+		if (!pBuf) {
+			return;
+		}
+		pText->pBuf = pBuf;
+		pText->cap = cap;
+	}
+	memcpy(pText->pBuf + pText->len, pStr, len);
+	pText->len += len;
+	pText->pBuf[pText->len] = 0;
+}
+
+static void report_funcs(MBDisasm* pDis, MBText* pText) {
+	int i;
+	for (i = 0; i < pDis->numFuncs; ++i) {
+		MBFunc* pFunc = &pDis->pFuncs[i];
+		dismb_text_printf(text_append, pText, "%08X %8u %s\n", pFunc->addr, pFunc->size, pFunc->pName);
+	}
+}
+
+static void report_disasm(MBDisasm* pDis, MBText* pText) {
+	int i;
+	for (i = 0; i < pDis->numFuncs; ++i) {
+		dismb_func_out(pDis, i, text_append, pText);
+	}
+}
+
+static void report_sizes(MBDisasm* pDis, MBText* pText) {
+	void* pELF = pDis->pELF;
+	int nsects = (int)elfi32_num_sect_header_entries(pELF);
+	uint32_t code = 0;
+	uint32_t data = 0;
+	uint32_t bss = 0;
+	int i;
+	for (i = 0; i < nsects; ++i) {
+		uint32_t flags = elfi32_section_flags(pELF, i);
+		if (flags & 2) {
+			/* SHF_ALLOC */
+			uint32_t addr;
+			uint32_t size;
+			const char* pName = elfi32_section_name(pELF, i);
+			elfi32_section_addrinfo(pELF, i, &addr, NULL, &size);
+			dismb_text_printf(text_append, pText, "%-24s %08X %8u\n", pName ? pName : "", addr, size);
+			if (elfi32_section_type(pELF, i) == 8) {
+				/* SHT_NOBITS */
+				bss += size;
+			} else if (flags & 4) {
+				/* SHF_EXECINSTR */
+				code += size;
+			} else {
+				data += size;
+			}
+		}
+	}
+	dismb_text_printf(text_append, pText, "code=%u data=%u bss=%u total=%u\n", code, data, bss, code + data + bss);
+}
+
+static void batch_job(int ijob, int iwk, void* pCtxMem) {
+	MBBatch* pBatch = (MBBatch*)pCtxMem;
+	MBDisasm* pDis = &pBatch->pWk[iwk];
+	MBBatchSlot* pSlot = &pBatch->pSlots[ijob % pBatch->window];
+	const char* pPath = pBatch->ppPaths[ijob];
+
+	/* keep at most window results buffered ahead of the emitter */
+	pthread_mutex_lock(&pBatch->mtx);
+	while (ijob - pBatch->nextEmit >= pBatch->window) {
+		pthread_cond_wait(&pBatch->cv, &pBatch->mtx);
+	}
+	pthread_mutex_unlock(&pBatch->mtx);
+
+	pSlot->text.len = 0;
+	pSlot->ok = dismb_load_ex(pDis, pPath, 0);
+	if (pSlot->ok) {
+		if (pBatch->mode == MBBATCH_FUNCS) {
+			report_funcs(pDis, &pSlot->text);
+		} else if (pBatch->mode == MBBATCH_DISASM) {
+			report_disasm(pDis, &pSlot->text);
+		} else if (pBatch->mode == MBBATCH_SIZES) {
+			report_sizes(pDis, &pSlot->text);
+		}
+	}
+
+	pthread_mutex_lock(&pBatch->mtx);
+	pSlot->ready = 1;
+	while (pBatch->nextEmit < pBatch->npaths) {
+		int iemit = pBatch->nextEmit;
+		MBBatchSlot* pEmit = &pBatch->pSlots[iemit % pBatch->window];
+		if (!pEmit->ready) {
+			break;
+		}
+		if (pEmit->ok) {
+			++pBatch->nok;
+		}
+		if (pBatch->fn) {
+			pBatch->fn(iemit, pBatch->ppPaths[iemit], pEmit->ok, pEmit->text.pBuf, pEmit->text.len, pBatch->pCtx);
+		}
+		pEmit->ready = 0;
+		++pBatch->nextEmit;
+	}
+	pthread_cond_broadcast(&pBatch->cv);
+	pthread_mutex_unlock(&pBatch->mtx);
+}
+
+MBBatch* dismb_batch_create(WkPool* pPool) {
+	MBBatch* pBatch = (MBBatch*)malloc(sizeof(MBBatch));
+	if (pBatch) {
+		int i;
+		memset(pBatch, 0, sizeof(MBBatch));
+		pBatch->pPool = pPool;
+		pBatch->nworkers = wkpool_num_workers(pPool);
+		pBatch->window = pBatch->nworkers * 2;
+		pBatch->pWk = (MBDisasm*)calloc(pBatch->nworkers, sizeof(MBDisasm));
+		pBatch->pSlots = (MBBatchSlot*)calloc(pBatch->window, sizeof(MBBatchSlot));
+		if (!pBatch->pWk || !pBatch->pSlots) {
+			free(pBatch->pWk);
+			free(pBatch->pSlots);
+			free(pBatch);
+			return NULL;
+		}
+		for (i = 0; i < pBatch->nworkers; ++i) {
+			dismb_arena_init(&pBatch->pWk[i].arena, 0);
+		}
+		pthread_mutex_init(&pBatch->mtx, NULL);
+		pthread_cond_init(&pBatch->cv, NULL);
+	}
+	return pBatch;
+}
+
+void dismb_batch_destroy(MBBatch* pBatch) {
+	if (pBatch) {
+		int i;
+		for (i = 0; i < pBatch->nworkers; ++i) {
+			dismb_free(&pBatch->pWk[i]);
+		}
+		for (i = 0; i < pBatch->window; ++i) {
+			free(pBatch->pSlots[i].text.pBuf);
+		}
+		free(pBatch->pWk);
+		free(pBatch->pSlots);
+		pthread_cond_destroy(&pBatch->cv);
+		pthread_mutex_destroy(&pBatch->mtx);
+		free(pBatch);
+	}
+}
+
+/*
+ * Loads and analyses every image on the batch's pool; results are passed
+ * to fn strictly in input order. Worker disassemblers and result buffers
+ * are kept by the batch, so repeated runs reuse their memory.
+ * Returns the number of images that loaded successfully.
+ */
+int dismb_batch_run(MBBatch* pBatch, const char** ppPaths, int npaths, MBBatchMode mode, MBBatchFn fn, void* pCtx) {
+	int res = 0;
+	if (pBatch && ppPaths && npaths > 0) {
+		pBatch->ppPaths = ppPaths;
+		pBatch->npaths = npaths;
+		pBatch->mode = mode;
+		pBatch->fn = fn;
+		pBatch->pCtx = pCtx;
+		pBatch->nextEmit = 0;
+		pBatch->nok = 0;
+		wkpool_for(pBatch->pPool, npaths, batch_job, pBatch);
+		res = pBatch->nok;
+		pBatch->ppPaths = NULL;
+		pBatch->fn = NULL;
+		pBatch->pCtx = NULL;
+	}
+	return res;
+}
@@ -0,0 +1,29 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wkpool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum _MBBatchMode {
+	MBBATCH_FUNCS,
+	MBBATCH_DISASM,
+	MBBATCH_SIZES
+} MBBatchMode;
+
+/* called in input order, pText is only valid for the duration of the call */
+typedef void (*MBBatchFn)(int idx, const char* pPath, int ok, const char* pText, size_t len, void* pCtx);
+
+typedef struct _MBBatch MBBatch;
+
+MBBatch* dismb_batch_create(WkPool* pPool);
+void dismb_batch_destroy(MBBatch* pBatch);
+int dismb_batch_run(MBBatch* pBatch, const char** ppPaths, int npaths, MBBatchMode mode, MBBatchFn fn, void* pCtx);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,321 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "elfi32.h"
+#include "elfi32_dwline.h"
+#include "disasm_microblaze.h"
+#include "dismb_cost.h"
+
+/*
+ * Latencies follow the MicroBlaze reference guide tables for the two
+ * pipeline configurations; anything not listed issues in one cycle.
+ */
+void dismb_cost_model_init(MBCostModel* pModel, MBPipeline pipe) {
+	int is5 = pipe == MBPIPE_5STAGE;
+	int op;
+	if (!pModel) {
+		return;
+	}
+	for (op = 0; op < MBOP_NUM; ++op) {
+		uint32_t flags = dismb_op_flags((MBOp)op);
+		uint8_t cycles = 1;
+		if (flags & (MBOPF_LOAD | MBOPF_STORE)) {
+			cycles = is5 ? 1 : 2;
+		} else if (flags & MBOPF_MUL) {
+			cycles = is5 ? 1 : 3;
+		} else if (flags & MBOPF_SHIFT) {
+			cycles = is5 ? 1 : 2;
+		} else if (flags & MBOPF_FPU) {
+			cycles = is5 ? 4 : 6;
+		}
+		pModel->cycles[op] = cycles;
+	}
+	pModel->cycles[MBOP_IDIV] = is5 ? 32 : 34;
+	pModel->cycles[MBOP_FDIV] = is5 ? 28 : 30;
+	pModel->cycles[MBOP_FSQRT] = is5 ? 27 : 29;
+	pModel->cycles[MBOP_FINT] = is5 ? 5 : 7;
+	pModel->cycles[MBOP_FCMP_UN] = is5 ? 1 : 3;
+	pModel->cycles[MBOP_FCMP_LT] = is5 ? 1 : 3;
+	pModel->cycles[MBOP_FCMP_EQ] = is5 ? 1 : 3;
+	pModel->cycles[MBOP_FCMP_LE] = is5 ? 1 : 3;
+	pModel->cycles[MBOP_FCMP_GT] = is5 ? 1 : 3;
+	pModel->cycles[MBOP_FCMP_NE] = is5 ? 1 : 3;
+	pModel->cycles[MBOP_FCMP_GE] = is5 ? 1 : 3;
+	pModel->takenExtra = 2;
+	pModel->takenDelayExtra = 1;
+}
+
+typedef struct _BlockCtx {
+	const MBCostModel* pModel;
+	uint32_t funcAddr;
+	uint32_t funcEnd;
+	uint8_t* pLeader; /* one byte per word of the function */
+	int pass;
+	int delayLeft;
+	MBBlockCost cur;
+	MBBlockCost* pBlocks;
+	int maxBlocks;
+	int numBlocks;
+	uint32_t total;
+} BlockCtx;
+
+static void block_flush(BlockCtx* pCtx) {
+	if (pCtx->cur.ninstrs > 0) {
+		if (pCtx->numBlocks < pCtx->maxBlocks) {
+			pCtx->pBlocks[pCtx->numBlocks] = pCtx->cur;
+		}
+		++pCtx->numBlocks;
+		pCtx->total += pCtx->cur.cycles;
+	}
+	memset(&pCtx->cur, 0, sizeof(MBBlockCost));
+}
+
+static void block_instr(const MBInstr* pPrev, const MBInstr* pInstr, void* pCtxMem) {
+	BlockCtx* pCtx = (BlockCtx*)pCtxMem;
+	uint32_t flags = dismb_op_flags(pInstr->op);
+	uint32_t iw = (pInstr->addr - pCtx->funcAddr) / 4;
+	if (pCtx->pass == 0) {
+		/* leaders: branch targets inside the function and fall-through points */
+		if (flags & MBOPF_BRANCH) {
+			if (!(flags & MBOPF_REG)) {
+				int32_t imm = dismb_fuse_imm(pPrev, pInstr);
+				uint32_t target = (flags & MBOPF_ABS) ? (uint32_t)imm : pInstr->addr + (uint32_t)imm;
+				if (target - pCtx->funcAddr < pCtx->funcEnd - pCtx->funcAddr) {
+					pCtx->pLeader[(target - pCtx->funcAddr) / 4] = 1;
+				}
+			}
+			if (pInstr->addr + ((flags & MBOPF_DELAY) ? 8 : 4) < pCtx->funcEnd) {
+				pCtx->pLeader[iw + ((flags & MBOPF_DELAY) ? 2 : 1)] = 1;
+			}
+		}
+		return;
+	}
+	if (pCtx->pLeader[iw] && pCtx->cur.ninstrs > 0) {
+		block_flush(pCtx);
+	}
+	if (pCtx->cur.ninstrs == 0) {
+		pCtx->cur.addr = pInstr->addr;
+	}
+	++pCtx->cur.ninstrs;
+	pCtx->cur.cycles += pCtx->pModel->cycles[pInstr->op];
+	pCtx->cur.cyclesFallthrough += pCtx->pModel->cycles[pInstr->op];
+	if (flags & MBOPF_BRANCH) {
+		pCtx->cur.cycles += (flags & MBOPF_DELAY) ? pCtx->pModel->takenDelayExtra : pCtx->pModel->takenExtra;
+		if (!(flags & MBOPF_COND)) {
+			pCtx->cur.cyclesFallthrough = pCtx->cur.cycles;
+		}
+	}
+}
+
+/*
+ * Splits a function into basic blocks (a delayed branch ends its block
+ * after the delay slot) and returns the sum of the block costs, i.e. the
+ * cost of executing every block once. Up to maxBlocks blocks are stored.
+ */
+uint32_t dismb_cost_func(MBDisasm* pDis, const MBCostModel* pModel, int ifunc, MBBlockCost* pBlocks, int maxBlocks, int* pNumBlocks) {
+	BlockCtx ctx;
+	uint32_t nwords;
+	if (pNumBlocks) {
+		*pNumBlocks = 0;
+	}
+	if (!pDis || !pModel || (uint32_t)ifunc >= (uint32_t)pDis->numFuncs) {
+		return 0;
+	}
+	memset(&ctx, 0, sizeof(ctx));
+	nwords = pDis->pFuncs[ifunc].size / 4;
+	ctx.pModel = pModel;
+	ctx.funcAddr = pDis->pFuncs[ifunc].addr;
+	ctx.funcEnd = ctx.funcAddr + nwords * 4;
+	ctx.pBlocks = pBlocks;
+	ctx.maxBlocks = pBlocks ? maxBlocks : 0;
+	ctx.pLeader = (uint8_t*)calloc(nwords + 1, 1);
+	if (!ctx.pLeader) {
+		return 0;
+	}
+	dismb_walk_func(pDis, ifunc, block_instr, &ctx);
+	ctx.pass = 1;
+	dismb_walk_func(pDis, ifunc, block_instr, &ctx);
+	block_flush(&ctx);
+	free(ctx.pLeader);
+	if (pNumBlocks) {
+		*pNumBlocks = ctx.numBlocks;
+	}
+	return ctx.total;
+}
+
+typedef struct _ImageCostCtx {
+	MBDisasm* pDis;
+	const MBCostModel* pModel;
+	uint32_t* pFuncCycles;
+} ImageCostCtx;
+
+#define COST_FUNCS_PER_JOB 256
+
+static void image_cost_job(int ijob, int iwk, void* pCtxMem) {
+	ImageCostCtx* pCtx = (ImageCostCtx*)pCtxMem;
+	int i = ijob * COST_FUNCS_PER_JOB;
+	int end = i + COST_FUNCS_PER_JOB;
+	(void)iwk;
+	if (end > pCtx->pDis->numFuncs) {
+		end = pCtx->pDis->numFuncs;
+	}
+	for (; i < end; ++i) {
+		pCtx->pFuncCycles[i] = dismb_cost_func(pCtx->pDis, pCtx->pModel, i, NULL, 0, NULL);
+	}
+}
+
+void dismb_cost_image(MBDisasm* pDis, const MBCostModel* pModel, WkPool* pPool, uint32_t* pFuncCycles) {
+	ImageCostCtx ctx;
+	if (!pDis || !pModel || !pFuncCycles) {
+		return;
+	}
+	ctx.pDis = pDis;
+	ctx.pModel = pModel;
+	ctx.pFuncCycles = pFuncCycles;
+	wkpool_for(pPool, (pDis->numFuncs + COST_FUNCS_PER_JOB - 1) / COST_FUNCS_PER_JOB, image_cost_job, &ctx);
+}
+
+#define TRACE_CHUNK_WORDS 4096
+
+/*
+ * Replays a PC trace: every sample adds its instruction cost to the
+ * function containing it, taken branches (the PC after the branch or its
+ * delay slot is not sequential) add the taken penalty. Returns the
+ * number of samples that fell outside all known functions.
+ *
+ * Needs dismb_build_addr_index() first and leaves pDis untouched, so
+ * several threads can replay against one image; without the index
+ * nothing is counted and MBCOST_TRACE_ERROR is returned.
+ */
+size_t dismb_cost_trace(MBDisasm* pDis, const MBCostModel* pModel, const uint32_t* pPCs, size_t npcs, uint64_t* pFuncCycles, uint64_t* pFuncHits) {
+	size_t nmissed = 0;
+	uint32_t nwords;
+	uint8_t* pCost;
+	uint8_t* pKind;
+	size_t i;
+	int lastFunc = -1;
+	if (!pDis || !pDis->pAddrIdx || !pModel || !pPCs || !pFuncCycles) {
+		return MBCOST_TRACE_ERROR;
+	}
+	/* per-word cost and branch kind, so replay never decodes */
+	nwords = pDis->textSize / 4;
+	pCost = (uint8_t*)malloc(nwords + 1);
+	pKind = (uint8_t*)malloc(nwords + 1);
+	if (pCost && pKind) {
+		uint32_t words[TRACE_CHUNK_WORDS];
+		uint32_t iw = 0;
+		while (iw < nwords) {
+			uint32_t n = dismb_read_words(pDis, pDis->textAddr + iw*4, words, nwords - iw < TRACE_CHUNK_WORDS ? nwords - iw : TRACE_CHUNK_WORDS);
+			uint32_t j;
+			if (n == 0) {
+				break;
+			}
+			for (j = 0; j < n; ++j) {
+				MBInstr ins;
+				uint32_t flags;
+				dismb_decode(0, words[j], &ins);
+				flags = dismb_op_flags(ins.op);
+				pCost[iw + j] = pModel->cycles[ins.op];
+				pKind[iw + j] = (flags & MBOPF_BRANCH) ? ((flags & MBOPF_DELAY) ? 2 : 1) : 0;
+			}
+			iw += n;
+		}
+		for (i = 0; i < npcs; ++i) {
+			uint32_t pc = pPCs[i];
+			uint32_t rel = pc - pDis->textAddr;
+			uint32_t cycles;
+			int ifunc;
+			if (rel >= nwords * 4) {
+				++nmissed;
+				continue;
+			}
+			cycles = pCost[rel / 4];
+			if (pKind[rel / 4] == 1) {
+				if (i + 1 < npcs && pPCs[i + 1] != pc + 4) {
+					cycles += pModel->takenExtra;
+				}
+			} else if (pKind[rel / 4] == 2) {
+				if (i + 2 < npcs && pPCs[i + 2] != pc + 8) {
+					cycles += pModel->takenDelayExtra;
+				}
+			}
+			/* traces are local: try the previous function first */
+			if (lastFunc >= 0 && pc - pDis->pFuncs[lastFunc].addr < pDis->pFuncs[lastFunc].size) {
+				ifunc = lastFunc;
+			} else {
+				ifunc = dismb_func_at(pDis, pc);
+				lastFunc = ifunc;
+			}
+			if (ifunc < 0) {
+				++nmissed;
+				continue;
+			}
+			pFuncCycles[ifunc] += cycles;
+			if (pFuncHits) {
+				++pFuncHits[ifunc];
+			}
+		}
+	} else {
+		nmissed = MBCOST_TRACE_ERROR;
+	}
+	free(pCost);
+	free(pKind);
+	return nmissed;
+}
+
+typedef struct _HotFunc {
+	uint64_t cycles;
+	int ifunc;
+} HotFunc;
+
+static int cmp_hot_desc(const void* pA, const void* pB) {
+	uint64_t a = ((const HotFunc*)pA)->cycles;
+	uint64_t b = ((const HotFunc*)pB)->cycles;
+	return a > b ? -1 : a < b ? 1 : 0;
+}
+
+void dismb_cost_hotspots(MBDisasm* pDis, const uint64_t* pFuncCycles, const uint64_t* pFuncHits, int maxLines, MBTextFn fn, void* pCtx) {
+	HotFunc* pOrder;
+	uint64_t total = 0;
+	int i;
+	if (!pDis || !pFuncCycles) {
+		return;
+	}
+	pOrder = (HotFunc*)malloc(sizeof(HotFunc) * (pDis->numFuncs + 1));
+	if (!pOrder) {
+		return;
+	}
+	for (i = 0; i < pDis->numFuncs; ++i) {
+		pOrder[i].cycles = pFuncCycles[i];
+		pOrder[i].ifunc = i;
+		total += pFuncCycles[i];
+	}
+	qsort(pOrder, pDis->numFuncs, sizeof(HotFunc), cmp_hot_desc);
+	for (i = 0; i < pDis->numFuncs && i < maxLines; ++i) {
+		int ifunc = pOrder[i].ifunc;
+		char line[256];
+		char src[160];
+		elfi32_lineinfo info;
+		int len;
+		if (pFuncCycles[ifunc] == 0) {
+			break;
+		}
+		src[0] = 0;
+		if (pDis->lineFn && pDis->lineFn(pDis->pLines, pDis->pFuncs[ifunc].addr, &info)) {
+			snprintf(src, sizeof(src), " (%s:%u)", info.pFile, info.line);
+		}
+		len = snprintf(line, sizeof(line), "%12llu %6.2f%% %12llu  %s%s\n",
+			(unsigned long long)pFuncCycles[ifunc],
+			total ? 100.0 * (double)pFuncCycles[ifunc] / (double)total : 0.0,
+			(unsigned long long)(pFuncHits ? pFuncHits[ifunc] : 0),
+			pDis->pFuncs[ifunc].pName, src);
+		if (len >= (int)sizeof(line)) {
+			len = (int)sizeof(line) - 1;
+		}
+		dismb_text_out(fn, pCtx, line, len);
+	}
+	free(pOrder);
+}
@@ -0,0 +1,38 @@
+/* SPDX-License-Identifier: MIT */
+
+#include "wkpool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum _MBPipeline {
+	MBPIPE_3STAGE, /* area-optimized */
+	MBPIPE_5STAGE
+} MBPipeline;
+
+typedef struct _MBCostModel {
+	uint8_t cycles[MBOP_NUM]; /* issue cost, branches: not taken */
+	uint8_t takenExtra; /* taken branch without delay slot */
+	uint8_t takenDelayExtra; /* taken branch with delay slot, slot counted separately */
+} MBCostModel;
+
+typedef struct _MBBlockCost {
+	uint32_t addr;
+	uint32_t ninstrs;
+	uint32_t cycles; /* branch at the end taken */
+	uint32_t cyclesFallthrough;
+} MBBlockCost;
+
+/* dismb_cost_trace() could not run: bad arguments, no address index or no memory */
+#define MBCOST_TRACE_ERROR ((size_t)-1)
+
+void dismb_cost_model_init(MBCostModel* pModel, MBPipeline pipe);
+uint32_t dismb_cost_func(MBDisasm* pDis, const MBCostModel* pModel, int ifunc, MBBlockCost* pBlocks, int maxBlocks, int* pNumBlocks);
+void dismb_cost_image(MBDisasm* pDis, const MBCostModel* pModel, WkPool* pPool, uint32_t* pFuncCycles);
+size_t dismb_cost_trace(MBDisasm* pDis, const MBCostModel* pModel, const uint32_t* pPCs, size_t npcs, uint64_t* pFuncCycles, uint64_t* pFuncHits);
+void dismb_cost_hotspots(MBDisasm* pDis, const uint64_t* pFuncCycles, const uint64_t* pFuncHits, int maxLines, MBTextFn fn, void* pCtx);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,110 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "elfi32.h"
+#include "disasm_microblaze.h"
+#include "dismb_crc.h"
+
+#define SUM_CHUNK 256 /* words per read */
+#define SUM_FUNCS_PER_JOB 256
+
+static void put_be32(uint8_t* p, uint32_t val) {
+	p[0] = (uint8_t)(val >> 24);
+	p[1] = (uint8_t)(val >> 16);
+	p[2] = (uint8_t)(val >> 8);
+	p[3] = (uint8_t)val;
+}
+
+void dismb_func_checksum(MBDisasm* pDis, int ifunc, MBFuncSum* pSum) {
+	if (!pSum) {
+		return;
+	}
+	memset(pSum, 0, sizeof(MBFuncSum));
+	if (pDis && (uint32_t)ifunc < (uint32_t)pDis->numFuncs) {
+		uint32_t words[SUM_CHUNK];
+		uint8_t bytes[SUM_CHUNK * 4];
+		MBFunc* pFunc = &pDis->pFuncs[ifunc];
+		uint32_t addr = pFunc->addr;
+		uint32_t nleft = pFunc->size / 4;
+		pSum->addr = pFunc->addr;
+		pSum->size = pFunc->size;
+		while (nleft > 0) {
+			uint32_t n = dismb_read_words(pDis, addr, words, nleft < SUM_CHUNK ? nleft : SUM_CHUNK);
+			uint32_t i;
+			if (n == 0) {
+				break;
+			}
+			for (i = 0; i < n; ++i) {
+				put_be32(&bytes[i*4], words[i]);
+			}
+			pSum->crc32 = elfi32_crc32(pSum->crc32, bytes, n * 4);
+			pSum->crc32c = elfi32_crc32c(pSum->crc32c, bytes, n * 4);
+			addr += n * 4;
+			nleft -= n;
+		}
+	}
+}
+
+typedef struct _SumJobCtx {
+	MBDisasm* pDis;
+	MBFuncSum* pSums;
+} SumJobCtx;
+
+static void sum_job(int ijob, int iwk, void* pCtxMem) {
+	SumJobCtx* pCtx = (SumJobCtx*)pCtxMem;
+	int i = ijob * SUM_FUNCS_PER_JOB;
+	int end = i + SUM_FUNCS_PER_JOB;
+	(void)iwk;
+	if (end > pCtx->pDis->numFuncs) {
+		end = pCtx->pDis->numFuncs;
+	}
+	for (; i < end; ++i) {
+		dismb_func_checksum(pCtx->pDis, i, &pCtx->pSums[i]);
+	}
+}
+
+/* pSums has numFuncs entries, in function table order */
+int dismb_func_checksums(MBDisasm* pDis, WkPool* pPool, MBFuncSum* pSums) {
+	SumJobCtx ctx;
+	if (!pDis || !pSums) {
+		return 0;
+	}
+	ctx.pDis = pDis;
+	ctx.pSums = pSums;
+	wkpool_for(pPool, (pDis->numFuncs + SUM_FUNCS_PER_JOB - 1) / SUM_FUNCS_PER_JOB, sum_job, &ctx);
+	return 1;
+}
+
+/*
+ * One value for the whole table: two images with equal digests have the
+ * same functions at the same addresses with the same code.
+ */
+uint64_t dismb_checksums_digest(const MBFuncSum* pSums, int nsums) {
+	uint32_t crc = 0;
+	uint32_t crcc = 0;
+	int i;
+	for (i = 0; i < nsums; ++i) {
+		uint8_t rec[16];
+		put_be32(&rec[0], pSums[i].addr);
+		put_be32(&rec[4], pSums[i].size);
+		put_be32(&rec[8], pSums[i].crc32);
+		put_be32(&rec[12], pSums[i].crc32c);
+		crc = elfi32_crc32(crc, rec, sizeof(rec));
+		crcc = elfi32_crc32c(crcc, rec, sizeof(rec));
+	}
+	return ((uint64_t)crcc << 32) | crc;
+}
+
+/* index of the first differing entry, -1 if the tables are equal */
+int dismb_checksums_first_diff(const MBFuncSum* pSumsA, int nsumsA, const MBFuncSum* pSumsB, int nsumsB) {
+	int n = nsumsA < nsumsB ? nsumsA : nsumsB;
+	int i;
+	for (i = 0; i < n; ++i) {
+		if (memcmp(&pSumsA[i], &pSumsB[i], sizeof(MBFuncSum)) != 0) {
+			return i;
+		}
+	}
+	return nsumsA == nsumsB ? -1 : n;
+}
@@ -0,0 +1,32 @@
+/* SPDX-License-Identifier: MIT */
+
+#ifndef DISMB_CRC_H
+#define DISMB_CRC_H
+
+#include "elfi32_crc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Checksums over the function's instruction words in big-endian order,
+ * so they do not depend on the image byte order or on dismb_compact().
+ */
+typedef struct _MBFuncSum {
+	uint32_t addr;
+	uint32_t size;
+	uint32_t crc32;
+	uint32_t crc32c;
+} MBFuncSum;
+
+void dismb_func_checksum(MBDisasm* pDis, int ifunc, MBFuncSum* pSum);
+int dismb_func_checksums(MBDisasm* pDis, WkPool* pPool, MBFuncSum* pSums);
+uint64_t dismb_checksums_digest(const MBFuncSum* pSums, int nsums);
+int dismb_checksums_first_diff(const MBFuncSum* pSumsA, int nsumsA, const MBFuncSum* pSumsB, int nsumsB);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
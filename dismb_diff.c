@@ -0,0 +1,294 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "elfi32.h"
+#include "disasm_microblaze.h"
+#include "dismb_diff.h"
+
+#define HASH_CHUNK 256
+#define HASH_PRIME 0x9E3779B97F4A7C15ULL
+
+static uint64_t hash_mix(uint64_t h) {
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+/*
+ * Clears the parts of an instruction that change when code is merely
+ * relocated: imm prefix values, the low half they are fused with,
+ * absolute branch targets, and relative branches that leave the function.
+ */
+static uint32_t norm_word(uint32_t code, uint32_t addr, uint32_t funcAddr, uint32_t funcSize, int* pImmPending) {
+	uint32_t op = code >> 26;
+	int fused = *pImmPending;
+	*pImmPending = 0;
+	if (op == 0x2C) {
+		*pImmPending = 1;
+		return code & 0xFFFF0000;
+	}
+	if (fused && (op & 0x08)) {
+		/* type B consumer of an imm prefix */
+		return code & 0xFFFF0000;
+	}
+	if (op == 0x2E || op == 0x2F) {
+		uint32_t ra = (code >> 16) & 0x1F;
+		if (op == 0x2E && (ra & 8)) {
+			/* absolute */
+			return code & 0xFFFF0000;
+		} else {
+			int32_t disp = (int32_t)(code << 16) >> 16;
+			uint32_t target = addr + (uint32_t)disp;
+			if (target - funcAddr >= funcSize) {
+				return code & 0xFFFF0000;
+			}
+		}
+	}
+	return code;
+}
+
+uint64_t dismb_func_hash(MBDisasm* pDis, int ifunc) {
+	uint64_t h = 0;
+	if (pDis && (uint32_t)ifunc < (uint32_t)pDis->numFuncs) {
+		uint32_t words[HASH_CHUNK];
+		uint64_t lanes[4];
+		MBFunc* pFunc = &pDis->pFuncs[ifunc];
+		uint32_t addr = pFunc->addr;
+		uint32_t nleft = pFunc->size / 4;
+		int immPending = 0;
+		int i;
+		for (i = 0; i < 4; ++i) {
+			lanes[i] = HASH_PRIME * (uint64_t)(i + 1);
+		}
+		while (nleft > 0) {
+			uint32_t n = dismb_read_words(pDis, addr, words, nleft < HASH_CHUNK ? nleft : HASH_CHUNK);
+			uint32_t j;
+			if (n == 0) {
+				break;
+			}
+			for (j = 0; j < n; ++j) {
+				words[j] = norm_word(words[j], addr + j*4, pFunc->addr, pFunc->size, &immPending);
+			}
+			for (; n & 3; --n) {
+				/* tail first, the remainder is a multiple of the lane count */
+				lanes[0] = (lanes[0] ^ words[n - 1]) * HASH_PRIME;
+				lanes[0] ^= lanes[0] >> 29;
+			}
+			/* four independent lanes: the loop vectorizes and pipelines */
+			for (j = 0; j < n; j += 4) {
+				lanes[0] = (lanes[0] ^ words[j + 0]) * HASH_PRIME;
+				lanes[1] = (lanes[1] ^ words[j + 1]) * HASH_PRIME;
+				lanes[2] = (lanes[2] ^ words[j + 2]) * HASH_PRIME;
+				lanes[3] = (lanes[3] ^ words[j + 3]) * HASH_PRIME;
+				lanes[0] ^= lanes[0] >> 29;
+				lanes[1] ^= lanes[1] >> 29;
+				lanes[2] ^= lanes[2] >> 29;
+				lanes[3] ^= lanes[3] >> 29;
+			}
+			addr += HASH_CHUNK * 4;
+			nleft -= nleft < HASH_CHUNK ? nleft : HASH_CHUNK;
+		}
+		h = hash_mix(lanes[0] ^ hash_mix(lanes[1] ^ hash_mix(lanes[2] ^ hash_mix(lanes[3] ^ pFunc->size))));
+	}
+	return h;
+}
+
+#define HASH_FUNCS_PER_JOB 512
+
+typedef struct _HashJobCtx {
+	MBDisasm* pDis;
+	uint64_t* pHashes;
+} HashJobCtx;
+
+static void hash_job(int ijob, int iwk, void* pCtxMem) {
+	HashJobCtx* pCtx = (HashJobCtx*)pCtxMem;
+	int i = ijob * HASH_FUNCS_PER_JOB;
+	int end = i + HASH_FUNCS_PER_JOB;
+	(void)iwk;
+	if (end > pCtx->pDis->numFuncs) {
+		end = pCtx->pDis->numFuncs;
+	}
+	for (; i < end; ++i) {
+		pCtx->pHashes[i] = dismb_func_hash(pCtx->pDis, i);
+	}
+}
+
+static void hash_all(MBDisasm* pDis, uint64_t* pHashes, WkPool* pPool) {
+	HashJobCtx ctx;
+	ctx.pDis = pDis;
+	ctx.pHashes = pHashes;
+	wkpool_for(pPool, (pDis->numFuncs + HASH_FUNCS_PER_JOB - 1) / HASH_FUNCS_PER_JOB, hash_job, &ctx);
+}
+
+typedef struct _FuncKey {
+	const char* pName;
+	uint32_t addr;
+	int ifunc;
+} FuncKey;
+
+static int cmp_key_name(const void* pA, const void* pB) {
+	return strcmp(((const FuncKey*)pA)->pName, ((const FuncKey*)pB)->pName);
+}
+
+static int cmp_key_addr(const void* pA, const void* pB) {
+	uint32_t addrA = ((const FuncKey*)pA)->addr;
+	uint32_t addrB = ((const FuncKey*)pB)->addr;
+	return addrA < addrB ? -1 : addrA > addrB ? 1 : 0;
+}
+
+static FuncKey* sorted_funcs(MBDisasm* pDis, int (*cmp)(const void*, const void*)) {
+	FuncKey* pKeys = (FuncKey*)malloc(sizeof(FuncKey) * (pDis->numFuncs + 1));
+	if (pKeys) {
+		int i;
+		for (i = 0; i < pDis->numFuncs; ++i) {
+			pKeys[i].pName = pDis->pFuncs[i].pName;
+			pKeys[i].addr = pDis->pFuncs[i].addr;
+			pKeys[i].ifunc = i;
+		}
+		qsort(pKeys, pDis->numFuncs, sizeof(FuncKey), cmp);
+	}
+	return pKeys;
+}
+
+static void add_entry(MBDiff* pDiff, MBDiffKind kind, MBDisasm* pDisA, int ifuncA, MBDisasm* pDisB, int ifuncB) {
+	MBDiffEntry* pEntry = &pDiff->pEntries[pDiff->numEntries++];
+	uint32_t sizeA = ifuncA >= 0 ? pDisA->pFuncs[ifuncA].size : 0;
+	uint32_t sizeB = ifuncB >= 0 ? pDisB->pFuncs[ifuncB].size : 0;
+	pEntry->kind = kind;
+	pEntry->ifuncA = ifuncA;
+	pEntry->ifuncB = ifuncB;
+	pEntry->sizeDelta = (int32_t)(sizeB - sizeA);
+	switch (kind) {
+		case MBDIFF_SAME: ++pDiff->numSame; break;
+		case MBDIFF_CHANGED: ++pDiff->numChanged; break;
+		case MBDIFF_MOVED: ++pDiff->numMoved; break;
+		case MBDIFF_ADDED: ++pDiff->numAdded; break;
+		case MBDIFF_REMOVED: ++pDiff->numRemoved; break;
+	}
+}
+
+static void pair_funcs(MBDiff* pDiff, MBDisasm* pDisA, int ifuncA, uint64_t hashA, MBDisasm* pDisB, int ifuncB, uint64_t hashB) {
+	MBFunc* pFuncA = &pDisA->pFuncs[ifuncA];
+	MBFunc* pFuncB = &pDisB->pFuncs[ifuncB];
+	MBDiffKind kind = MBDIFF_CHANGED;
+	if (hashA == hashB && pFuncA->size == pFuncB->size) {
+		if (pFuncA->addr == pFuncB->addr && strcmp(pFuncA->pName, pFuncB->pName) == 0) {
+			kind = MBDIFF_SAME;
+		} else {
+			kind = MBDIFF_MOVED;
+		}
+	}
+	add_entry(pDiff, kind, pDisA, ifuncA, pDisB, ifuncB);
+}
+
+/*
+ * Pairs functions by name first; whatever is left on both sides is paired
+ * by its position in address order, which keeps stripped or renamed code
+ * comparable. Hashes ignore relocation, so a function that only moved is
+ * reported as MBDIFF_MOVED rather than changed.
+ */
+int dismb_diff(MBDisasm* pDisA, MBDisasm* pDisB, WkPool* pPool, MBDiff* pDiff) {
+	int res = 0;
+	uint64_t* pHashA;
+	uint64_t* pHashB;
+	FuncKey* pKeyA;
+	FuncKey* pKeyB;
+	int* pPairA;
+	int* pPairB;
+	if (!pDisA || !pDisB || !pDiff) {
+		return 0;
+	}
+	memset(pDiff, 0, sizeof(MBDiff));
+	pHashA = (uint64_t*)malloc(sizeof(uint64_t) * (pDisA->numFuncs + 1));
+	pHashB = (uint64_t*)malloc(sizeof(uint64_t) * (pDisB->numFuncs + 1));
+	pPairA = (int*)malloc(sizeof(int) * (pDisA->numFuncs + 1));
+	pPairB = (int*)malloc(sizeof(int) * (pDisB->numFuncs + 1));
+	pKeyA = sorted_funcs(pDisA, cmp_key_name);
+	pKeyB = sorted_funcs(pDisB, cmp_key_name);
+	pDiff->pEntries = (MBDiffEntry*)malloc(sizeof(MBDiffEntry) * (pDisA->numFuncs + pDisB->numFuncs + 1));
+	if (pHashA && pHashB && pPairA && pPairB && pKeyA && pKeyB && pDiff->pEntries) {
+		int ia = 0;
+		int ib = 0;
+		int i;
+		hash_all(pDisA, pHashA, pPool);
+		hash_all(pDisB, pHashB, pPool);
+		for (i = 0; i < pDisA->numFuncs; ++i) {
+			pPairA[i] = -1;
+		}
+		for (i = 0; i < pDisB->numFuncs; ++i) {
+			pPairB[i] = -1;
+		}
+		while (ia < pDisA->numFuncs && ib < pDisB->numFuncs) {
+			int fa = pKeyA[ia].ifunc;
+			int fb = pKeyB[ib].ifunc;
+			int c = strcmp(pKeyA[ia].pName, pKeyB[ib].pName);
+			if (c == 0) {
+				pPairA[fa] = fb;
+				pPairB[fb] = fa;
+				++ia;
+				++ib;
+			} else if (c < 0) {
+				++ia;
+			} else {
+				++ib;
+			}
+		}
+		/* then walk both sides in address order */
+		qsort(pKeyA, pDisA->numFuncs, sizeof(FuncKey), cmp_key_addr);
+		qsort(pKeyB, pDisB->numFuncs, sizeof(FuncKey), cmp_key_addr);
+		ia = 0;
+		ib = 0;
+		while (ia < pDisA->numFuncs || ib < pDisB->numFuncs) {
+			int fa = ia < pDisA->numFuncs ? pKeyA[ia].ifunc : -1;
+			int fb = ib < pDisB->numFuncs ? pKeyB[ib].ifunc : -1;
+			int unmatchedA = fa >= 0 && pPairA[fa] < 0;
+			int unmatchedB = fb >= 0 && pPairB[fb] < 0;
+			if (unmatchedA && unmatchedB) {
+				/* same gap between name-matched functions */
+				pPairA[fa] = fb;
+				pPairB[fb] = fa;
+				pair_funcs(pDiff, pDisA, fa, pHashA[fa], pDisB, fb, pHashB[fb]);
+				++ia;
+				++ib;
+			} else if (unmatchedA) {
+				add_entry(pDiff, MBDIFF_REMOVED, pDisA, fa, pDisB, -1);
+				++ia;
+			} else if (unmatchedB) {
+				add_entry(pDiff, MBDIFF_ADDED, pDisA, -1, pDisB, fb);
+				++ib;
+			} else {
+				if (fa >= 0) {
+					pair_funcs(pDiff, pDisA, fa, pHashA[fa], pDisB, pPairA[fa], pHashB[pPairA[fa]]);
+					++ia;
+				}
+				if (fb >= 0) {
+					/* emitted with its partner */
+					++ib;
+				}
+			}
+		}
+		res = 1;
+	}
+	free(pHashA);
+	free(pHashB);
+	free(pPairA);
+	free(pPairB);
+	free(pKeyA);
+	free(pKeyB);
+	if (!res) {
+		dismb_diff_free(pDiff);
+	}
+	return res;
+}
+
+void dismb_diff_free(MBDiff* pDiff) {
+	if (pDiff) {
+		free(pDiff->pEntries);
+		memset(pDiff, 0, sizeof(MBDiff));
+	}
+}
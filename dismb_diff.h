@@ -0,0 +1,40 @@
+/* SPDX-License-Identifier: MIT */
+
+#include "wkpool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum _MBDiffKind {
+	MBDIFF_SAME,
+	MBDIFF_CHANGED,
+	MBDIFF_MOVED,
+	MBDIFF_ADDED,
+	MBDIFF_REMOVED
+} MBDiffKind;
+
+typedef struct _MBDiffEntry {
+	MBDiffKind kind;
+	int ifuncA; /* -1 for MBDIFF_ADDED */
+	int ifuncB; /* -1 for MBDIFF_REMOVED */
+	int32_t sizeDelta;
+} MBDiffEntry;
+
+typedef struct _MBDiff {
+	int numEntries;
+	MBDiffEntry* pEntries;
+	int numSame;
+	int numChanged;
+	int numMoved;
+	int numAdded;
+	int numRemoved;
+} MBDiff;
+
+uint64_t dismb_func_hash(MBDisasm* pDis, int ifunc);
+int dismb_diff(MBDisasm* pDisA, MBDisasm* pDisB, WkPool* pPool, MBDiff* pDiff);
+void dismb_diff_free(MBDiff* pDiff);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,185 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "elfi32.h"
+#include "disasm_microblaze.h"
+#include "dismb_hist.h"
+
+#define MB_NOP 0x80000000 /* or r0, r0, r0 */
+
+void dismb_hist_clear(MBHist* pHist) {
+	if (pHist) {
+		memset(pHist, 0, sizeof(MBHist));
+	}
+}
+
+void dismb_hist_merge(MBHist* pDst, const MBHist* pSrc) {
+	if (pDst && pSrc) {
+		int i;
+		for (i = 0; i < MBOP_NUM; ++i) {
+			pDst->ops[i] += pSrc->ops[i];
+		}
+		pDst->ninstrs += pSrc->ninstrs;
+		pDst->nimm += pSrc->nimm;
+		pDst->nfpu += pSrc->nfpu;
+		pDst->nmul += pSrc->nmul;
+		pDst->nshift += pSrc->nshift;
+		for (i = 0; i < 3; ++i) {
+			pDst->nloads[i] += pSrc->nloads[i];
+			pDst->nstores[i] += pSrc->nstores[i];
+		}
+		pDst->ndelay += pSrc->ndelay;
+		pDst->ndelayFilled += pSrc->ndelayFilled;
+	}
+}
+
+static int mem_width_idx(uint32_t flags) {
+	return (flags & MBOPF_MEM8) ? 0 : (flags & MBOPF_MEM16) ? 1 : 2;
+}
+
+static void hist_instr(const MBInstr* pPrev, const MBInstr* pInstr, void* pCtx) {
+	MBHist* pHist = (MBHist*)pCtx;
+	uint32_t flags = dismb_op_flags(pInstr->op);
+	++pHist->ops[pInstr->op];
+	++pHist->ninstrs;
+	if (pInstr->op == MBOP_IMM) {
+		++pHist->nimm;
+	}
+	if (flags & MBOPF_FPU) {
+		++pHist->nfpu;
+	}
+	if (flags & MBOPF_MUL) {
+		++pHist->nmul;
+	}
+	if (flags & MBOPF_SHIFT) {
+		++pHist->nshift;
+	}
+	if (flags & MBOPF_LOAD) {
+		++pHist->nloads[mem_width_idx(flags)];
+	} else if (flags & MBOPF_STORE) {
+		++pHist->nstores[mem_width_idx(flags)];
+	}
+	if (dismb_op_flags(pPrev->op) & MBOPF_DELAY) {
+		++pHist->ndelay;
+		if (pInstr->code != MB_NOP) {
+			++pHist->ndelayFilled;
+		}
+	}
+}
+
+/* pHist is cleared first */
+void dismb_hist_func(MBDisasm* pDis, int ifunc, MBHist* pHist) {
+	if (pHist) {
+		dismb_hist_clear(pHist);
+		dismb_walk_func(pDis, ifunc, hist_instr, pHist);
+	}
+}
+
+#define HIST_FUNCS_PER_JOB 256
+
+typedef struct _HistCtx {
+	MBDisasm* pDis;
+	MBHist* pFuncHists;
+	MBHist* pWkTotals;
+} HistCtx;
+
+static void hist_job(int ijob, int iwk, void* pCtxMem) {
+	HistCtx* pCtx = (HistCtx*)pCtxMem;
+	MBHist* pTotal = &pCtx->pWkTotals[iwk];
+	int i = ijob * HIST_FUNCS_PER_JOB;
+	int end = i + HIST_FUNCS_PER_JOB;
+	if (end > pCtx->pDis->numFuncs) {
+		end = pCtx->pDis->numFuncs;
+	}
+	for (; i < end; ++i) {
+		if (pCtx->pFuncHists) {
+			dismb_hist_func(pCtx->pDis, i, &pCtx->pFuncHists[i]);
+			dismb_hist_merge(pTotal, &pCtx->pFuncHists[i]);
+		} else {
+			/* totals only: count straight into the worker's table */
+			dismb_walk_func(pCtx->pDis, i, hist_instr, pTotal);
+		}
+	}
+}
+
+/*
+ * Per-function histograms (optional, numFuncs entries) and the image
+ * total. Each worker accumulates into its own table, merged at the end.
+ */
+int dismb_hist_image(MBDisasm* pDis, WkPool* pPool, MBHist* pFuncHists, MBHist* pTotal) {
+	HistCtx ctx;
+	int nworkers = wkpool_num_workers(pPool);
+	int i;
+	if (!pDis) {
+		return 0;
+	}
+	ctx.pDis = pDis;
+	ctx.pFuncHists = pFuncHists;
+	ctx.pWkTotals = (MBHist*)calloc(nworkers, sizeof(MBHist));
+	if (!ctx.pWkTotals) {
+		return 0;
+	}
+	wkpool_for(pPool, (pDis->numFuncs + HIST_FUNCS_PER_JOB - 1) / HIST_FUNCS_PER_JOB, hist_job, &ctx);
+	if (pTotal) {
+		dismb_hist_clear(pTotal);
+		for (i = 0; i < nworkers; ++i) {
+			dismb_hist_merge(pTotal, &ctx.pWkTotals[i]);
+		}
+	}
+	free(ctx.pWkTotals);
+	return 1;
+}
+
+typedef struct _OpCount {
+	uint32_t count;
+	int op;
+} OpCount;
+
+static int cmp_count_desc(const void* pA, const void* pB) {
+	uint32_t a = ((const OpCount*)pA)->count;
+	uint32_t b = ((const OpCount*)pB)->count;
+	return a > b ? -1 : a < b ? 1 : ((const OpCount*)pA)->op - ((const OpCount*)pB)->op;
+}
+
+static double pct(uint32_t n, uint32_t total) {
+	return total ? 100.0 * (double)n / (double)total : 0.0;
+}
+
+/* mnemonic mix plus the MicroBlaze configuration options the code relies on */
+void dismb_hist_report(const MBHist* pHist, MBTextFn fn, void* pCtx) {
+	OpCount counts[MBOP_NUM];
+	uint32_t ndiv;
+	uint32_t npcmp;
+	int n = 0;
+	int i;
+	if (!pHist) {
+		return;
+	}
+	for (i = 0; i < MBOP_NUM; ++i) {
+		if (pHist->ops[i]) {
+			counts[n].count = pHist->ops[i];
+			counts[n].op = i;
+			++n;
+		}
+	}
+	qsort(counts, n, sizeof(OpCount), cmp_count_desc);
+	dismb_text_printf(fn, pCtx, "instructions: %u\n", pHist->ninstrs);
+	for (i = 0; i < n; ++i) {
+		dismb_text_printf(fn, pCtx, "  %-10s %10u %6.2f%%\n", dismb_op_name((MBOp)counts[i].op), counts[i].count, pct(counts[i].count, pHist->ninstrs));
+	}
+	dismb_text_printf(fn, pCtx, "imm prefixes: %u (%.2f%%)\n", pHist->nimm, pct(pHist->nimm, pHist->ninstrs));
+	dismb_text_printf(fn, pCtx, "loads b/h/w: %u/%u/%u, stores b/h/w: %u/%u/%u\n",
+		pHist->nloads[0], pHist->nloads[1], pHist->nloads[2],
+		pHist->nstores[0], pHist->nstores[1], pHist->nstores[2]);
+	dismb_text_printf(fn, pCtx, "delay slots: %u, filled: %u (%.2f%%)\n", pHist->ndelay, pHist->ndelayFilled, pct(pHist->ndelayFilled, pHist->ndelay));
+	ndiv = pHist->ops[MBOP_IDIV];
+	npcmp = pHist->ops[MBOP_PCMPBF] + pHist->ops[MBOP_PCMPEQ] + pHist->ops[MBOP_PCMPNE] + pHist->ops[MBOP_CLZ];
+	dismb_text_printf(fn, pCtx, "C_USE_BARREL: %s (%u)\n", pHist->nshift ? "needed" : "unused", pHist->nshift);
+	dismb_text_printf(fn, pCtx, "C_USE_HW_MUL: %s (%u)\n", pHist->nmul ? "needed" : "unused", pHist->nmul);
+	dismb_text_printf(fn, pCtx, "C_USE_DIV: %s (%u)\n", ndiv ? "needed" : "unused", ndiv);
+	dismb_text_printf(fn, pCtx, "C_USE_FPU: %s (%u)\n", pHist->nfpu ? "needed" : "unused", pHist->nfpu);
+	dismb_text_printf(fn, pCtx, "C_USE_PCMP_INSTR: %s (%u)\n", npcmp ? "needed" : "unused", npcmp);
+}
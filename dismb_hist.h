@@ -0,0 +1,30 @@
+/* SPDX-License-Identifier: MIT */
+
+#include "wkpool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _MBHist {
+	uint32_t ops[MBOP_NUM];
+	uint32_t ninstrs;
+	uint32_t nimm; /* imm prefixes */
+	uint32_t nfpu;
+	uint32_t nmul;
+	uint32_t nshift;
+	uint32_t nloads[3]; /* byte, half, word */
+	uint32_t nstores[3];
+	uint32_t ndelay; /* delay slots */
+	uint32_t ndelayFilled; /* delay slots holding something other than a nop */
+} MBHist;
+
+void dismb_hist_clear(MBHist* pHist);
+void dismb_hist_merge(MBHist* pDst, const MBHist* pSrc);
+void dismb_hist_func(MBDisasm* pDis, int ifunc, MBHist* pHist);
+int dismb_hist_image(MBDisasm* pDis, WkPool* pPool, MBHist* pFuncHists, MBHist* pTotal);
+void dismb_hist_report(const MBHist* pHist, MBTextFn fn, void* pCtx);
+
+#ifdef __cplusplus
+}
+#endif
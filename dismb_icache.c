@@ -0,0 +1,374 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "elfi32.h"
+#include "disasm_microblaze.h"
+#include "dismb_icache.h"
+
+#define FEED_CHUNK_PCS (1 << 20)
+
+/*
+ * Tags are line numbers + 1 so that 0 marks an empty way. Every set keeps
+ * its ways in most-recently-used order, as does the victim cache.
+ */
+typedef struct _MBCacheSim {
+	MBCacheGeom geom;
+	uint32_t lineShift;
+	uint32_t setMask;
+	uint32_t* pTags;
+	uint32_t victimTags[MBICACHE_MAX_VICTIMS];
+	uint32_t lastTag;
+	int lastFunc;
+	MBCacheStats stats;
+	uint64_t* pFuncMisses;
+} MBCacheSim;
+
+struct _MBICache {
+	MBDisasm* pDis;
+	int numGeoms;
+	MBCacheSim* pSims;
+	uint64_t* pFuncFetches;
+	int lastFunc;
+	/* per-feed state */
+	const uint32_t* pPCs;
+	size_t npcs;
+	/* dismb_icache_feed_fd() */
+	int fd;
+	uint32_t* pNext;
+	size_t nnext;
+	int readErr;
+};
+
+static int log2_exact(uint32_t val, uint32_t* pShift) {
+	uint32_t shift = 0;
+	if (val == 0 || (val & (val - 1)) != 0) {
+		return 0;
+	}
+	while ((1u << shift) != val) {
+		++shift;
+	}
+	*pShift = shift;
+	return 1;
+}
+
+static int sim_init(MBCacheSim* pSim, const MBCacheGeom* pGeom, int numFuncs) {
+	uint32_t sizeShift;
+	uint32_t nsets;
+	memset(pSim, 0, sizeof(MBCacheSim));
+	if (!log2_exact(pGeom->size, &sizeShift) || !log2_exact(pGeom->lineSize, &pSim->lineShift) || pGeom->lineSize < 4) {
+		return 0;
+	}
+	if (pGeom->ways == 0 || pGeom->ways > MBICACHE_MAX_WAYS || pGeom->victims > MBICACHE_MAX_VICTIMS) {
+		return 0;
+	}
+	if (pGeom->size < pGeom->lineSize * pGeom->ways) {
+		return 0;
+	}
+	nsets = (pGeom->size >> pSim->lineShift) / pGeom->ways;
+	if ((nsets & (nsets - 1)) != 0) {
+		return 0;
+	}
+	pSim->geom = *pGeom;
+	pSim->setMask = nsets - 1;
+	pSim->lastFunc = -1;
+	pSim->pTags = (uint32_t*)calloc((size_t)nsets * pGeom->ways, sizeof(uint32_t));
+	pSim->pFuncMisses = (uint64_t*)calloc(numFuncs + 1, sizeof(uint64_t));
+	return pSim->pTags && pSim->pFuncMisses;
+}
+
+static void sim_free(MBCacheSim* pSim) {
+	free(pSim->pTags);
+	free(pSim->pFuncMisses);
+}
+
+/* traces are local: try the previous function first */
+static int func_of(MBDisasm* pDis, uint32_t pc, int* pLastFunc) {
+	int ifunc = *pLastFunc;
+	if (ifunc < 0 || pc - pDis->pFuncs[ifunc].addr >= pDis->pFuncs[ifunc].size) {
+		ifunc = dismb_func_at(pDis, pc);
+		*pLastFunc = ifunc;
+	}
+	return ifunc >= 0 ? ifunc : pDis->numFuncs;
+}
+
+/* moves pTags[idx] to the front, putting tag there */
+static void mru_insert(uint32_t* pTags, uint32_t idx, uint32_t tag) {
+	memmove(pTags + 1, pTags, idx * sizeof(uint32_t));
+	pTags[0] = tag;
+}
+
+static void sim_run(MBCacheSim* pSim, MBDisasm* pDis, const uint32_t* pPCs, size_t npcs) {
+	uint32_t ways = pSim->geom.ways;
+	uint32_t nvictims = pSim->geom.victims;
+	uint32_t lastTag = pSim->lastTag;
+	uint64_t misses = 0;
+	uint64_t victimHits = 0;
+	size_t i;
+	for (i = 0; i < npcs; ++i) {
+		uint32_t tag = (pPCs[i] >> pSim->lineShift) + 1;
+		uint32_t* pSet;
+		uint32_t evicted;
+		uint32_t w;
+		if (tag == lastTag) {
+			/* still the MRU way of its set */
+			continue;
+		}
+		lastTag = tag;
+		pSet = pSim->pTags + ((tag - 1) & pSim->setMask) * ways;
+		for (w = 0; w < ways && pSet[w] != tag; ++w) {
+		}
+		if (w < ways) {
+			mru_insert(pSet, w, tag);
+			continue;
+		}
+		evicted = pSet[ways - 1];
+		mru_insert(pSet, ways - 1, tag);
+		if (nvictims > 0) {
+			for (w = 0; w < nvictims && pSim->victimTags[w] != tag; ++w) {
+			}
+			if (w < nvictims) {
+				/* swap: the line comes back, the evicted one takes its slot */
+				++victimHits;
+				if (evicted) {
+					mru_insert(pSim->victimTags, w, evicted);
+				} else {
+					memmove(pSim->victimTags + w, pSim->victimTags + w + 1, (nvictims - 1 - w) * sizeof(uint32_t));
+					pSim->victimTags[nvictims - 1] = 0;
+				}
+				continue;
+			}
+			if (evicted) {
+				mru_insert(pSim->victimTags, nvictims - 1, evicted);
+			}
+		}
+		++misses;
+		++pSim->pFuncMisses[func_of(pDis, pPCs[i], &pSim->lastFunc)];
+	}
+	pSim->lastTag = lastTag;
+	pSim->stats.fetches += npcs;
+	pSim->stats.misses += misses;
+	pSim->stats.victimHits += victimHits;
+}
+
+/*
+ * Needs dismb_build_addr_index() first, like the other analysis passes,
+ * and does not modify pDis; returns NULL without the index.
+ */
+MBICache* dismb_icache_create(MBDisasm* pDis, const MBCacheGeom* pGeoms, int ngeoms) {
+	MBICache* pSim = NULL;
+	if (pDis && pDis->pFuncs && pDis->pAddrIdx && pGeoms && ngeoms > 0) {
+		pSim = (MBICache*)calloc(1, sizeof(MBICache));
+		if (pSim) {
+			int ok = 0;
+			pSim->pDis = pDis;
+			pSim->lastFunc = -1;
+			pSim->fd = -1;
+			pSim->pSims = (MBCacheSim*)calloc(ngeoms, sizeof(MBCacheSim));
+			pSim->pFuncFetches = (uint64_t*)calloc(pDis->numFuncs + 1, sizeof(uint64_t));
+			if (pSim->pSims && pSim->pFuncFetches) {
+				ok = 1;
+				for (pSim->numGeoms = 0; pSim->numGeoms < ngeoms && ok; ++pSim->numGeoms) {
+					ok = sim_init(&pSim->pSims[pSim->numGeoms], &pGeoms[pSim->numGeoms], pDis->numFuncs);
+				}
+			}
+			if (!ok) {
+				dismb_icache_destroy(pSim);
+				pSim = NULL;
+			}
+		}
+	}
+	return pSim;
+}
+
+void dismb_icache_destroy(MBICache* pSim) {
+	if (pSim) {
+		int i;
+		for (i = 0; i < pSim->numGeoms; ++i) {
+			sim_free(&pSim->pSims[i]);
+		}
+		free(pSim->pSims);
+		free(pSim->pFuncFetches);
+		free(pSim);
+	}
+}
+
+static void count_fetches(MBICache* pSim) {
+	size_t i;
+	for (i = 0; i < pSim->npcs; ++i) {
+		++pSim->pFuncFetches[func_of(pSim->pDis, pSim->pPCs[i], &pSim->lastFunc)];
+	}
+}
+
+/* fills pNext with up to FEED_CHUNK_PCS words, a partial word at EOF is dropped */
+static void read_next(MBICache* pSim) {
+	size_t want = FEED_CHUNK_PCS * sizeof(uint32_t);
+	size_t got = 0;
+	while (got < want) {
+		ssize_t n = read(pSim->fd, (char*)pSim->pNext + got, want - got);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n < 0) {
+			pSim->readErr = 1;
+		}
+		if (n <= 0) {
+			break;
+		}
+		got += (size_t)n;
+	}
+	pSim->nnext = got / sizeof(uint32_t);
+}
+
+/*
+ * Job layout: one per geometry, then the per-function fetch count, then
+ * (for dismb_icache_feed_fd) reading the next chunk.
+ */
+static void feed_job(int ijob, int iwk, void* pCtxMem) {
+	MBICache* pSim = (MBICache*)pCtxMem;
+	(void)iwk;
+	if (ijob < pSim->numGeoms) {
+		sim_run(&pSim->pSims[ijob], pSim->pDis, pSim->pPCs, pSim->npcs);
+	} else if (ijob == pSim->numGeoms) {
+		count_fetches(pSim);
+	} else {
+		read_next(pSim);
+	}
+}
+
+/*
+ * Replays npcs fetch addresses against every geometry. The geometries are
+ * independent, so they run as parallel jobs over the same chunk; call
+ * repeatedly to stream a trace, the caches keep their state between calls.
+ */
+void dismb_icache_feed(MBICache* pSim, const uint32_t* pPCs, size_t npcs, WkPool* pPool) {
+	if (pSim && pPCs && npcs > 0) {
+		pSim->pPCs = pPCs;
+		pSim->npcs = npcs;
+		wkpool_for(pPool, pSim->numGeoms + 1, feed_job, pSim);
+		pSim->pPCs = NULL;
+		pSim->npcs = 0;
+	}
+}
+
+/*
+ * Streams a trace of host-order 32-bit PCs from fd to its end. With a
+ * pool the next chunk is read while the current one is simulated, so
+ * the trace is read once whatever the number of geometries. Returns 0 on
+ * read or allocation errors.
+ */
+int dismb_icache_feed_fd(MBICache* pSim, int fd, WkPool* pPool) {
+	uint32_t* pBufs[2];
+	int cur = 0;
+	int res = 0;
+	if (!pSim || fd < 0) {
+		return 0;
+	}
+	pBufs[0] = (uint32_t*)malloc(FEED_CHUNK_PCS * sizeof(uint32_t));
+	pBufs[1] = (uint32_t*)malloc(FEED_CHUNK_PCS * sizeof(uint32_t));
+	if (pBufs[0] && pBufs[1]) {
+		pSim->fd = fd;
+		pSim->readErr = 0;
+		pSim->pNext = pBufs[cur];
+		read_next(pSim);
+		while (pSim->nnext > 0 && !pSim->readErr) {
+			pSim->pPCs = pBufs[cur];
+			pSim->npcs = pSim->nnext;
+			cur ^= 1;
+			pSim->pNext = pBufs[cur];
+			pSim->nnext = 0;
+			wkpool_for(pPool, pSim->numGeoms + 2, feed_job, pSim);
+		}
+		res = !pSim->readErr;
+		pSim->pPCs = NULL;
+		pSim->npcs = 0;
+		pSim->pNext = NULL;
+		pSim->fd = -1;
+	}
+	free(pBufs[0]);
+	free(pBufs[1]);
+	return res;
+}
+
+const MBCacheStats* dismb_icache_stats(const MBICache* pSim, int igeom) {
+	return pSim && (uint32_t)igeom < (uint32_t)pSim->numGeoms ? &pSim->pSims[igeom].stats : NULL;
+}
+
+/* numFuncs + 1 entries, the last one counts PCs outside all functions */
+const uint64_t* dismb_icache_func_misses(const MBICache* pSim, int igeom) {
+	return pSim && (uint32_t)igeom < (uint32_t)pSim->numGeoms ? pSim->pSims[igeom].pFuncMisses : NULL;
+}
+
+const uint64_t* dismb_icache_func_fetches(const MBICache* pSim) {
+	return pSim ? pSim->pFuncFetches : NULL;
+}
+
+typedef struct _MissFunc {
+	uint64_t misses;
+	int ifunc;
+} MissFunc;
+
+static int cmp_miss_desc(const void* pA, const void* pB) {
+	const MissFunc* pFuncA = (const MissFunc*)pA;
+	const MissFunc* pFuncB = (const MissFunc*)pB;
+	if (pFuncA->misses != pFuncB->misses) {
+		return pFuncA->misses > pFuncB->misses ? -1 : 1;
+	}
+	return pFuncA->ifunc - pFuncB->ifunc;
+}
+
+/*
+ * One summary line per geometry, then the maxLines functions with the
+ * most misses in the first geometry with their misses in every geometry.
+ */
+void dismb_icache_report(const MBICache* pSim, int maxLines, MBTextFn fn, void* pCtx) {
+	MBDisasm* pDis;
+	MissFunc* pOrder;
+	char line[256];
+	int len;
+	int i;
+	int g;
+	if (!pSim) {
+		return;
+	}
+	pDis = pSim->pDis;
+	for (g = 0; g < pSim->numGeoms; ++g) {
+		const MBCacheSim* pGeomSim = &pSim->pSims[g];
+		const MBCacheStats* pStats = &pGeomSim->stats;
+		len = snprintf(line, sizeof(line), "#%d %6uB line=%-3u ways=%-2u victims=%-2u fetches=%llu misses=%llu (%.3f%%) victim-hits=%llu\n",
+			g, pGeomSim->geom.size, pGeomSim->geom.lineSize, pGeomSim->geom.ways, pGeomSim->geom.victims,
+			(unsigned long long)pStats->fetches, (unsigned long long)pStats->misses,
+			pStats->fetches ? 100.0 * (double)pStats->misses / (double)pStats->fetches : 0.0,
+			(unsigned long long)pStats->victimHits);
+		dismb_text_out(fn, pCtx, line, len < (int)sizeof(line) ? len : (int)sizeof(line) - 1);
+	}
+	pOrder = (MissFunc*)malloc(sizeof(MissFunc) * (pDis->numFuncs + 1));
+	if (!pOrder) {
+		return;
+	}
+	for (i = 0; i <= pDis->numFuncs; ++i) {
+		pOrder[i].misses = pSim->pSims[0].pFuncMisses[i];
+		pOrder[i].ifunc = i;
+	}
+	qsort(pOrder, pDis->numFuncs + 1, sizeof(MissFunc), cmp_miss_desc);
+	for (i = 0; i <= pDis->numFuncs && i < maxLines && pOrder[i].misses > 0; ++i) {
+		int ifunc = pOrder[i].ifunc;
+		len = snprintf(line, sizeof(line), "%12llu", (unsigned long long)pSim->pFuncFetches[ifunc]);
+		for (g = 0; g < pSim->numGeoms && len < (int)sizeof(line); ++g) {
+			len += snprintf(line + len, sizeof(line) - len, " %10llu", (unsigned long long)pSim->pSims[g].pFuncMisses[ifunc]);
+		}
+		if (len < (int)sizeof(line)) {
+			len += snprintf(line + len, sizeof(line) - len, "  %s\n", ifunc < pDis->numFuncs ? pDis->pFuncs[ifunc].pName : "<outside>");
+		}
+		if (len >= (int)sizeof(line)) {
+			line[sizeof(line) - 2] = '\n';
+			len = (int)sizeof(line) - 1;
+		}
+		dismb_text_out(fn, pCtx, line, len);
+	}
+	free(pOrder);
+}
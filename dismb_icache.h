@@ -0,0 +1,38 @@
+/* SPDX-License-Identifier: MIT */
+
+#include "wkpool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MBICACHE_MAX_WAYS 16
+#define MBICACHE_MAX_VICTIMS 16
+
+typedef struct _MBCacheGeom {
+	uint32_t size; /* bytes, power of two */
+	uint32_t lineSize; /* bytes, power of two, at least 4 */
+	uint32_t ways; /* 1 for direct mapped */
+	uint32_t victims; /* lines in the victim cache, 0 for none */
+} MBCacheGeom;
+
+typedef struct _MBCacheStats {
+	uint64_t fetches;
+	uint64_t misses; /* went to memory */
+	uint64_t victimHits; /* L1 misses served by the victim cache */
+} MBCacheStats;
+
+typedef struct _MBICache MBICache;
+
+MBICache* dismb_icache_create(MBDisasm* pDis, const MBCacheGeom* pGeoms, int ngeoms);
+void dismb_icache_destroy(MBICache* pSim);
+void dismb_icache_feed(MBICache* pSim, const uint32_t* pPCs, size_t npcs, WkPool* pPool);
+int dismb_icache_feed_fd(MBICache* pSim, int fd, WkPool* pPool);
+const MBCacheStats* dismb_icache_stats(const MBICache* pSim, int igeom);
+const uint64_t* dismb_icache_func_misses(const MBICache* pSim, int igeom);
+const uint64_t* dismb_icache_func_fetches(const MBICache* pSim);
+void dismb_icache_report(const MBICache* pSim, int maxLines, MBTextFn fn, void* pCtx);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,381 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "elfi32.h"
+#include "disasm_microblaze.h"
+#include "dismb_rec.h"
+
+#define REC_SIZE 20
+#define REC_FUNCS_PER_JOB 256
+#define REC_MAX_IOV 64
+
+typedef char RecSizeCheck[sizeof(MBRec) == REC_SIZE && sizeof(MBRecHdr) == 64 ? 1 : -1];
+
+static void put_le16(uint8_t* p, uint32_t val) {
+	p[0] = (uint8_t)val;
+	p[1] = (uint8_t)(val >> 8);
+}
+
+static void put_le32(uint8_t* p, uint32_t val) {
+	p[0] = (uint8_t)val;
+	p[1] = (uint8_t)(val >> 8);
+	p[2] = (uint8_t)(val >> 16);
+	p[3] = (uint8_t)(val >> 24);
+}
+
+static uint8_t reg_byte(int32_t reg) {
+	return reg < 0 ? MBREC_REG_NONE : (uint8_t)reg;
+}
+
+/* number of instructions dismb_walk_func() visits */
+static uint32_t func_num_recs(const MBDisasm* pDis, const MBFunc* pFunc) {
+	uint32_t rel = pFunc->addr - pDis->textAddr;
+	uint32_t textSize = pDis->textSize & ~3u;
+	uint32_t n = 0;
+	if (rel < textSize && (rel & 3) == 0) {
+		n = pFunc->size / 4;
+		if (n > (textSize - rel) / 4) {
+			n = (textSize - rel) / 4;
+		}
+	}
+	return n;
+}
+
+static void rec_instr(const MBInstr* pPrev, const MBInstr* pInstr, void* pCtx) {
+	uint8_t** ppOut = (uint8_t**)pCtx;
+	uint8_t* p = *ppOut;
+	uint8_t flags = 0;
+	if (pInstr->opr3) {
+		flags |= MBRECF_OPR3;
+		if (pInstr->rB < 0) {
+			flags |= MBRECF_IMM;
+		}
+	}
+	if (pPrev->op == MBOP_IMM && ((pInstr->code >> 26) & 8)) {
+		flags |= MBRECF_FUSED;
+	}
+	if (dismb_op_flags(pPrev->op) & MBOPF_DELAY) {
+		flags |= MBRECF_DELAY;
+	}
+	put_le32(p + 0, pInstr->addr);
+	put_le32(p + 4, pInstr->code);
+	put_le32(p + 8, (uint32_t)dismb_fuse_imm(pPrev, pInstr));
+	put_le16(p + 12, (uint32_t)pInstr->op);
+	put_le16(p + 14, dismb_op_flags(pInstr->op));
+	p[16] = reg_byte(pInstr->rD);
+	p[17] = reg_byte(pInstr->rA);
+	p[18] = reg_byte(pInstr->rB);
+	p[19] = flags;
+	*ppOut = p + REC_SIZE;
+}
+
+typedef struct _RecJob {
+	uint8_t* pBuf;
+	size_t size;
+} RecJob;
+
+typedef struct _RecCtx {
+	MBDisasm* pDis;
+	const uint32_t* pFirstRec; /* numFuncs + 1 prefix sums */
+	RecJob* pJobs;
+	int firstJob;
+	int failed;
+} RecCtx;
+
+static void rec_job(int ijob, int iwk, void* pCtxMem) {
+	RecCtx* pCtx = (RecCtx*)pCtxMem;
+	RecJob* pJob = &pCtx->pJobs[ijob];
+	int i = (pCtx->firstJob + ijob) * REC_FUNCS_PER_JOB;
+	int end = i + REC_FUNCS_PER_JOB;
+	(void)iwk;
+	if (end > pCtx->pDis->numFuncs) {
+		end = pCtx->pDis->numFuncs;
+	}
+	pJob->size = (size_t)(pCtx->pFirstRec[end] - pCtx->pFirstRec[i]) * REC_SIZE;
+	pJob->pBuf = (uint8_t*)malloc(pJob->size + 1);
+	if (!pJob->pBuf) {
+		pCtx->failed = 1;
+		return;
+	}
+	{
+		uint8_t* pOut = pJob->pBuf;
+		for (; i < end; ++i) {
+			dismb_walk_func(pCtx->pDis, i, rec_instr, &pOut);
+		}
+	}
+}
+
+static int write_iov(int fd, struct iovec* pIov, int n) {
+	while (n > 0) {
+		ssize_t nw = writev(fd, pIov, n < REC_MAX_IOV ? n : REC_MAX_IOV);
+		if (nw < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return 0;
+		}
+		while (n > 0 && (size_t)nw >= pIov->iov_len) {
+			nw -= (ssize_t)pIov->iov_len;
+			++pIov;
+			--n;
+		}
+		if (n > 0) {
+			pIov->iov_base = (uint8_t*)pIov->iov_base + nw;
+			pIov->iov_len -= (size_t)nw;
+		}
+	}
+	return 1;
+}
+
+static uint32_t align_up(uint32_t val, uint32_t a) {
+	return (val + a - 1) & ~(a - 1);
+}
+
+/* everything in front of the records */
+static uint8_t* build_meta(MBDisasm* pDis, const uint32_t* pFirstRec, uint32_t* pMetaSize) {
+	uint32_t opNamesSize = 0;
+	uint32_t namesSize = 0;
+	uint32_t opNamesOffs = sizeof(MBRecHdr);
+	uint32_t funcsOffs;
+	uint32_t namesOffs;
+	uint32_t recsOffs;
+	uint8_t* pMeta;
+	int i;
+	for (i = 0; i < MBOP_NUM; ++i) {
+		opNamesSize += (uint32_t)strlen(dismb_op_name((MBOp)i)) + 1;
+	}
+	for (i = 0; i < pDis->numFuncs; ++i) {
+		namesSize += (uint32_t)strlen(pDis->pFuncs[i].pName) + 1;
+	}
+	funcsOffs = align_up(opNamesOffs + MBOP_NUM * 4 + opNamesSize, 4);
+	namesOffs = funcsOffs + (uint32_t)pDis->numFuncs * sizeof(MBRecFunc);
+	recsOffs = align_up(namesOffs + namesSize, 16);
+	pMeta = (uint8_t*)calloc(recsOffs, 1);
+	if (pMeta) {
+		uint32_t strOffs = opNamesOffs + MBOP_NUM * 4;
+		uint32_t nameOffs = 0;
+		put_le32(pMeta + 0x00, MBREC_MAGIC);
+		put_le32(pMeta + 0x04, MBREC_VERSION);
+		put_le32(pMeta + 0x08, sizeof(MBRecHdr));
+		put_le32(pMeta + 0x0C, REC_SIZE);
+		put_le32(pMeta + 0x10, pDis->textAddr);
+		put_le32(pMeta + 0x14, pDis->textSize);
+		put_le32(pMeta + 0x18, MBOP_NUM);
+		put_le32(pMeta + 0x1C, opNamesOffs);
+		put_le32(pMeta + 0x20, (uint32_t)pDis->numFuncs);
+		put_le32(pMeta + 0x24, funcsOffs);
+		put_le32(pMeta + 0x28, namesOffs);
+		put_le32(pMeta + 0x2C, namesSize);
+		put_le32(pMeta + 0x30, pFirstRec[pDis->numFuncs]);
+		put_le32(pMeta + 0x34, recsOffs);
+		for (i = 0; i < MBOP_NUM; ++i) {
+			const char* pName = dismb_op_name((MBOp)i);
+			size_t len = strlen(pName) + 1;
+			put_le32(pMeta + opNamesOffs + i*4, strOffs);
+			memcpy(pMeta + strOffs, pName, len);
+			strOffs += (uint32_t)len;
+		}
+		for (i = 0; i < pDis->numFuncs; ++i) {
+			const MBFunc* pFunc = &pDis->pFuncs[i];
+			uint8_t* p = pMeta + funcsOffs + i * sizeof(MBRecFunc);
+			size_t len = strlen(pFunc->pName) + 1;
+			put_le32(p + 0x00, pFunc->addr);
+			put_le32(p + 0x04, pFunc->size);
+			put_le32(p + 0x08, nameOffs);
+			put_le32(p + 0x0C, pFirstRec[i]);
+			put_le32(p + 0x10, pFirstRec[i + 1] - pFirstRec[i]);
+			memcpy(pMeta + namesOffs + nameOffs, pFunc->pName, len);
+			nameOffs += (uint32_t)len;
+		}
+		*pMetaSize = recsOffs;
+	}
+	return pMeta;
+}
+
+/*
+ * Functions are encoded on the pool a window of jobs at a time and each
+ * window goes out with one writev(), the header and tables with the first.
+ */
+int dismb_rec_write_fd(MBDisasm* pDis, int fd, WkPool* pPool) {
+	int res = 0;
+	uint32_t* pFirstRec;
+	uint8_t* pMeta = NULL;
+	uint32_t metaSize = 0;
+	int i;
+	if (!pDis || fd < 0) {
+		return 0;
+	}
+	pFirstRec = (uint32_t*)malloc((pDis->numFuncs + 1) * sizeof(uint32_t));
+	if (pFirstRec) {
+		pFirstRec[0] = 0;
+		for (i = 0; i < pDis->numFuncs; ++i) {
+			pFirstRec[i + 1] = pFirstRec[i] + func_num_recs(pDis, &pDis->pFuncs[i]);
+		}
+		pMeta = build_meta(pDis, pFirstRec, &metaSize);
+	}
+	if (pMeta) {
+		int njobs = (pDis->numFuncs + REC_FUNCS_PER_JOB - 1) / REC_FUNCS_PER_JOB;
+		int window = wkpool_num_workers(pPool) * 4;
+		RecJob jobs[REC_MAX_IOV];
+		struct iovec iov[REC_MAX_IOV + 1];
+		RecCtx ctx;
+		int niov = 0;
+		if (window < 1) {
+			window = 1;
+		}
+		if (window > REC_MAX_IOV) {
+			window = REC_MAX_IOV;
+		}
+		ctx.pDis = pDis;
+		ctx.pFirstRec = pFirstRec;
+		ctx.pJobs = jobs;
+		ctx.failed = 0;
+		iov[niov].iov_base = pMeta;
+		iov[niov].iov_len = metaSize;
+		++niov;
+		res = 1;
+		for (ctx.firstJob = 0; res && ctx.firstJob < njobs; ctx.firstJob += window) {
+			int n = njobs - ctx.firstJob < window ? njobs - ctx.firstJob : window;
+			memset(jobs, 0, sizeof(jobs));
+			wkpool_for(pPool, n, rec_job, &ctx);
+			for (i = 0; i < n; ++i) {
+				iov[niov].iov_base = jobs[i].pBuf;
+				iov[niov].iov_len = jobs[i].size;
+				++niov;
+			}
+			res = !ctx.failed && write_iov(fd, iov, niov);
+			niov = 0;
+			for (i = 0; i < n; ++i) {
+				free(jobs[i].pBuf);
+			}
+		}
+		if (res && niov > 0) {
+			/* no functions: just the header */
+			res = write_iov(fd, iov, niov);
+		}
+	}
+	free(pMeta);
+	free(pFirstRec);
+	return res;
+}
+
+int dismb_rec_write(MBDisasm* pDis, const char* pPath, WkPool* pPool) {
+	int res = 0;
+	if (pDis && pPath) {
+		int fd = open(pPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd >= 0) {
+			res = dismb_rec_write_fd(pDis, fd, pPool);
+			if (close(fd) != 0) {
+				res = 0;
+			}
+		}
+	}
+	return res;
+}
+
+static int rec_file_valid(const uint8_t* pMap, size_t size) {
+	const MBRecHdr* pHdr = (const MBRecHdr*)pMap;
+	uint64_t end;
+	uint32_t i;
+	if (size < sizeof(MBRecHdr) || pHdr->magic != MBREC_MAGIC || pHdr->version != MBREC_VERSION) {
+		return 0;
+	}
+	if (pHdr->hdrSize < sizeof(MBRecHdr) || pHdr->recSize != REC_SIZE || (pHdr->recsOffs & 15) || (pHdr->funcsOffs & 3) || (pHdr->opNamesOffs & 3)) {
+		return 0;
+	}
+	/* blocks in file order, each ending before the next starts */
+	if ((uint64_t)pHdr->recsOffs + (uint64_t)pHdr->numRecs * REC_SIZE > size || (uint64_t)pHdr->namesOffs + pHdr->namesSize > pHdr->recsOffs) {
+		return 0;
+	}
+	end = (uint64_t)pHdr->funcsOffs + (uint64_t)pHdr->numFuncs * sizeof(MBRecFunc);
+	if (end > pHdr->namesOffs || pHdr->opNamesOffs < pHdr->hdrSize || (uint64_t)pHdr->opNamesOffs + (uint64_t)pHdr->numOps * 4 >= pHdr->funcsOffs) {
+		return 0;
+	}
+	if (pMap[pHdr->funcsOffs - 1] != 0 || (pHdr->namesSize > 0 && pMap[pHdr->namesOffs + pHdr->namesSize - 1] != 0)) {
+		return 0;
+	}
+	for (i = 0; i < pHdr->numOps; ++i) {
+		uint32_t offs = ((const uint32_t*)(pMap + pHdr->opNamesOffs))[i];
+		if (offs < pHdr->opNamesOffs + pHdr->numOps * 4 || offs >= pHdr->funcsOffs) {
+			return 0;
+		}
+	}
+	for (i = 0; i < pHdr->numFuncs; ++i) {
+		const MBRecFunc* pFunc = (const MBRecFunc*)(pMap + pHdr->funcsOffs) + i;
+		if (pFunc->nameOffs >= pHdr->namesSize || (uint64_t)pFunc->firstRec + pFunc->numRecs > pHdr->numRecs) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Maps a stream written by dismb_rec_write() read-only; the tables and
+ * records point straight into the mapping. Little-endian hosts only.
+ */
+int dismb_rec_open(const char* pPath, MBRecFile* pFile) {
+	int res = 0;
+	if (pFile) {
+		memset(pFile, 0, sizeof(MBRecFile));
+	}
+	if (pFile && pPath && elfi32_is_le_sys()) {
+		int fd = open(pPath, O_RDONLY);
+		if (fd >= 0) {
+			struct stat st;
+			if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(MBRecHdr)) {
+				void* pMap = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (pMap != MAP_FAILED) {
+					if (rec_file_valid((const uint8_t*)pMap, (size_t)st.st_size)) {
+						const uint8_t* pBase = (const uint8_t*)pMap;
+						pFile->pMap = pMap;
+						pFile->mapSize = (size_t)st.st_size;
+						pFile->pHdr = (const MBRecHdr*)pBase;
+						pFile->pOpNameOffs = (const uint32_t*)(pBase + pFile->pHdr->opNamesOffs);
+						pFile->pFuncs = (const MBRecFunc*)(pBase + pFile->pHdr->funcsOffs);
+						pFile->pNames = (const char*)pBase + pFile->pHdr->namesOffs;
+						pFile->pRecs = (const MBRec*)(pBase + pFile->pHdr->recsOffs);
+						res = 1;
+					} else {
+						munmap(pMap, (size_t)st.st_size);
+					}
+				}
+			}
+			close(fd);
+		}
+	}
+	return res;
+}
+
+void dismb_rec_close(MBRecFile* pFile) {
+	if (pFile) {
+		if (pFile->pMap) {
+			munmap(pFile->pMap, pFile->mapSize);
+		}
+		memset(pFile, 0, sizeof(MBRecFile));
+	}
+}
+
+const char* dismb_rec_op_name(const MBRecFile* pFile, uint32_t op) {
+	const char* pName = NULL;
+	if (pFile && pFile->pHdr && op < pFile->pHdr->numOps) {
+		pName = (const char*)pFile->pMap + pFile->pOpNameOffs[op];
+	}
+	return pName;
+}
+
+const char* dismb_rec_func_name(const MBRecFile* pFile, uint32_t ifunc) {
+	const char* pName = NULL;
+	if (pFile && pFile->pHdr && ifunc < pFile->pHdr->numFuncs) {
+		pName = pFile->pNames + pFile->pFuncs[ifunc].nameOffs;
+	}
+	return pName;
+}
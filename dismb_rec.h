@@ -0,0 +1,88 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wkpool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Binary instruction stream, little-endian throughout:
+ *   MBRecHdr
+ *   uint32_t opNameOffs[numOps], op names (NUL-terminated)
+ *   MBRecFunc funcs[numFuncs], function names (NUL-terminated)
+ *   MBRec recs[numRecs], 16-byte aligned, grouped by function
+ * Offsets are from the start of the file.
+ */
+
+#define MBREC_MAGIC 0x4352424D /* "MBRC" */
+#define MBREC_VERSION 1
+
+#define MBREC_REG_NONE 0xFF
+
+#define MBRECF_IMM 0x01 /* imm is an operand */
+#define MBRECF_FUSED 0x02 /* imm includes the preceding imm prefix */
+#define MBRECF_DELAY 0x04 /* in the delay slot of the previous record */
+#define MBRECF_OPR3 0x08 /* has a third operand (rB or imm) */
+
+typedef struct _MBRecHdr {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t hdrSize;
+	uint32_t recSize;
+	uint32_t textAddr;
+	uint32_t textSize;
+	uint32_t numOps;
+	uint32_t opNamesOffs;
+	uint32_t numFuncs;
+	uint32_t funcsOffs;
+	uint32_t namesOffs;
+	uint32_t namesSize;
+	uint32_t numRecs;
+	uint32_t recsOffs;
+	uint32_t reserved[2];
+} MBRecHdr;
+
+typedef struct _MBRecFunc {
+	uint32_t addr;
+	uint32_t size;
+	uint32_t nameOffs; /* into the names block */
+	uint32_t firstRec;
+	uint32_t numRecs;
+} MBRecFunc;
+
+typedef struct _MBRec {
+	uint32_t addr;
+	uint32_t code;
+	int32_t imm; /* fused with a preceding imm prefix */
+	uint16_t op; /* MBOp */
+	uint16_t opFlags; /* MBOPF_* */
+	uint8_t rD; /* MBREC_REG_NONE if unused */
+	uint8_t rA;
+	uint8_t rB;
+	uint8_t flags; /* MBRECF_* */
+} MBRec;
+
+typedef struct _MBRecFile {
+	void* pMap;
+	size_t mapSize;
+	const MBRecHdr* pHdr;
+	const uint32_t* pOpNameOffs;
+	const MBRecFunc* pFuncs;
+	const char* pNames;
+	const MBRec* pRecs;
+} MBRecFile;
+
+int dismb_rec_write_fd(MBDisasm* pDis, int fd, WkPool* pPool);
+int dismb_rec_write(MBDisasm* pDis, const char* pPath, WkPool* pPool);
+int dismb_rec_open(const char* pPath, MBRecFile* pFile);
+void dismb_rec_close(MBRecFile* pFile);
+const char* dismb_rec_op_name(const MBRecFile* pFile, uint32_t op);
+const char* dismb_rec_func_name(const MBRecFile* pFile, uint32_t ifunc);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,241 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "elfi32.h"
+#include "disasm_microblaze.h"
+#include "dismb_recover.h"
+
+#define SCAN_CHUNK_WORDS (64 * 1024)
+
+typedef struct _AddrList {
+	uint32_t* pAddrs;
+	int num;
+	int cap;
+} AddrList;
+
+static void list_add(AddrList* pList, uint32_t addr) {
+	if (pList->num >= pList->cap) {
+		int cap = pList->cap ? pList->cap * 2 : 256;
+		uint32_t* pAddrs = (uint32_t*)realloc(pList->pAddrs, sizeof(uint32_t) * cap);
+		if (!pAddrs) {
+			return;
+		}
+		pList->pAddrs = pAddrs;
+		pList->cap = cap;
+	}
+	pList->pAddrs[pList->num++] = addr;
+}
+
+static int cmp_u32(const void* pA, const void* pB) {
+	uint32_t a = *(const uint32_t*)pA;
+	uint32_t b = *(const uint32_t*)pB;
+	return a < b ? -1 : a > b ? 1 : 0;
+}
+
+static int sort_unique(uint32_t* pAddrs, int num) {
+	int i;
+	int n = 0;
+	qsort(pAddrs, num, sizeof(uint32_t), cmp_u32);
+	for (i = 0; i < num; ++i) {
+		if (n == 0 || pAddrs[n - 1] != pAddrs[i]) {
+			pAddrs[n++] = pAddrs[i];
+		}
+	}
+	return n;
+}
+
+typedef struct _ScanResult {
+	AddrList starts;
+	AddrList ends;
+} ScanResult;
+
+typedef struct _ScanCtx {
+	MBDisasm* pDis;
+	uint32_t nwords;
+	ScanResult* pResults;
+} ScanCtx;
+
+/*
+ * One chunk of .text: call targets and prologues become start candidates,
+ * rtsd r15 epilogues (plus delay slot) become end candidates. The word
+ * before the chunk is decoded too so that imm prefixes fuse across chunks.
+ */
+static void scan_job(int ijob, int iwk, void* pCtxMem) {
+	ScanCtx* pCtx = (ScanCtx*)pCtxMem;
+	MBDisasm* pDis = pCtx->pDis;
+	ScanResult* pRes = &pCtx->pResults[ijob];
+	uint32_t iw = (uint32_t)ijob * SCAN_CHUNK_WORDS;
+	uint32_t iend = iw + SCAN_CHUNK_WORDS;
+	uint32_t first = iw > 0 ? iw - 1 : 0;
+	uint32_t textEnd = pDis->textAddr + pCtx->nwords * 4;
+	uint32_t* pWords;
+	uint32_t n;
+	uint32_t i;
+	MBInstr prev;
+	(void)iwk;
+	if (iend > pCtx->nwords) {
+		iend = pCtx->nwords;
+	}
+	pWords = (uint32_t*)malloc(sizeof(uint32_t) * (iend - first));
+	if (!pWords) {
+		return;
+	}
+	n = dismb_read_words(pDis, pDis->textAddr + first*4, pWords, iend - first);
+	memset(&prev, 0, sizeof(prev));
+	for (i = 0; i < n; ++i) {
+		MBInstr ins;
+		uint32_t addr = pDis->textAddr + (first + i)*4;
+		dismb_decode(addr, pWords[i], &ins);
+		if (first + i >= iw) {
+			if (ins.op == MBOP_BRLID || ins.op == MBOP_BRALID) {
+				int32_t imm = dismb_fuse_imm(&prev, &ins);
+				uint32_t target = ins.op == MBOP_BRLID ? addr + (uint32_t)imm : (uint32_t)imm;
+				if (target >= pDis->textAddr && target < textEnd && (target & 3) == 0) {
+					list_add(&pRes->starts, target);
+				}
+			} else if (ins.op == MBOP_ADDIK && ins.rD == 1 && ins.rA == 1 && ins.imm < 0 && prev.op != MBOP_IMM) {
+				/* addik r1, r1, -N */
+				list_add(&pRes->starts, addr);
+			} else if (ins.op == MBOP_RTSD && ins.rA == 15) {
+				list_add(&pRes->ends, addr + 8);
+			}
+		}
+		prev = ins;
+	}
+	free(pWords);
+}
+
+typedef struct _FuncRange {
+	uint32_t addr;
+	uint32_t end;
+} FuncRange;
+
+static int cmp_range(const void* pA, const void* pB) {
+	return cmp_u32(&((const FuncRange*)pA)->addr, &((const FuncRange*)pB)->addr);
+}
+
+/*
+ * Finds function starts that .symtab does not cover and appends synthetic
+ * "sub_XXXXXXXX" entries after the existing ones, so existing function
+ * indices stay valid. Returns the number of functions added or -1.
+ */
+int dismb_recover_funcs(MBDisasm* pDis, WkPool* pPool) {
+	int res = -1;
+	ScanCtx ctx;
+	int njobs;
+	int nstarts = 0;
+	int nends = 0;
+	uint32_t* pStarts = NULL;
+	uint32_t* pEnds = NULL;
+	FuncRange* pRanges = NULL;
+	int i;
+	if (!pDis || pDis->textSize < 4) {
+		return pDis ? 0 : -1;
+	}
+	ctx.pDis = pDis;
+	ctx.nwords = pDis->textSize / 4;
+	njobs = (int)((ctx.nwords + SCAN_CHUNK_WORDS - 1) / SCAN_CHUNK_WORDS);
+	ctx.pResults = (ScanResult*)calloc(njobs, sizeof(ScanResult));
+	if (!ctx.pResults) {
+		return -1;
+	}
+	wkpool_for(pPool, njobs, scan_job, &ctx);
+	for (i = 0; i < njobs; ++i) {
+		nstarts += ctx.pResults[i].starts.num;
+		nends += ctx.pResults[i].ends.num;
+	}
+	pStarts = (uint32_t*)malloc(sizeof(uint32_t) * (nstarts + 1));
+	pEnds = (uint32_t*)malloc(sizeof(uint32_t) * (nends + 1));
+	pRanges = (FuncRange*)malloc(sizeof(FuncRange) * (pDis->numFuncs + 1));
+	if (pStarts && pEnds && pRanges) {
+		int nnew = 0;
+		int iend = 0;
+		int irange = 0;
+		uint32_t textEnd = pDis->textAddr + ctx.nwords * 4;
+		MBFunc* pFuncs;
+		nstarts = 0;
+		nends = 0;
+		for (i = 0; i < njobs; ++i) {
+			memcpy(pStarts + nstarts, ctx.pResults[i].starts.pAddrs, sizeof(uint32_t) * ctx.pResults[i].starts.num);
+			nstarts += ctx.pResults[i].starts.num;
+			memcpy(pEnds + nends, ctx.pResults[i].ends.pAddrs, sizeof(uint32_t) * ctx.pResults[i].ends.num);
+			nends += ctx.pResults[i].ends.num;
+		}
+		nstarts = sort_unique(pStarts, nstarts);
+		nends = sort_unique(pEnds, nends);
+		for (i = 0; i < pDis->numFuncs; ++i) {
+			pRanges[i].addr = pDis->pFuncs[i].addr;
+			pRanges[i].end = pDis->pFuncs[i].addr + (pDis->pFuncs[i].size ? pDis->pFuncs[i].size : 4);
+		}
+		qsort(pRanges, pDis->numFuncs, sizeof(FuncRange), cmp_range);
+		/* drop candidates inside known functions, in one sweep */
+		for (i = 0; i < nstarts; ++i) {
+			uint32_t addr = pStarts[i];
+			int covered = 0;
+			int j;
+			while (irange < pDis->numFuncs && pRanges[irange].end <= addr && pRanges[irange].addr <= addr) {
+				++irange;
+			}
+			for (j = irange; j < pDis->numFuncs && pRanges[j].addr <= addr; ++j) {
+				if (addr < pRanges[j].end) {
+					covered = 1;
+					break;
+				}
+			}
+			if (!covered) {
+				pStarts[nnew++] = addr;
+			}
+		}
+		pFuncs = (MBFunc*)dismb_arena_alloc(&pDis->arena, sizeof(MBFunc) * (pDis->numFuncs + nnew));
+		if (pFuncs) {
+			int nfuncs = pDis->numFuncs;
+			memcpy(pFuncs, pDis->pFuncs, sizeof(MBFunc) * nfuncs);
+			irange = 0;
+			for (i = 0; i < nnew; ++i) {
+				uint32_t addr = pStarts[i];
+				uint32_t next = i + 1 < nnew ? pStarts[i + 1] : textEnd;
+				uint32_t end = 0;
+				char* pName = (char*)dismb_arena_alloc(&pDis->arena, 16);
+				while (irange < pDis->numFuncs && pRanges[irange].addr <= addr) {
+					++irange;
+				}
+				if (irange < pDis->numFuncs && pRanges[irange].addr < next) {
+					next = pRanges[irange].addr;
+				}
+				/* last epilogue before the next start trims trailing padding */
+				while (iend < nends && pEnds[iend] <= addr) {
+					++iend;
+				}
+				while (iend < nends && pEnds[iend] <= next) {
+					end = pEnds[iend++];
+				}
+				if (!pName) {
+					break;
+				}
+				sprintf(pName, "sub_%08X", addr);
+				pFuncs[nfuncs].pName = pName;
+				pFuncs[nfuncs].addr = addr;
+				pFuncs[nfuncs].size = (end ? end : next) - addr;
+				++nfuncs;
+			}
+			res = nfuncs - pDis->numFuncs;
+			pDis->pFuncs = pFuncs;
+			pDis->numFuncs = nfuncs;
+			if (pDis->pAddrIdx) {
+				dismb_build_addr_index(pDis);
+			}
+		}
+	}
+	for (i = 0; i < njobs; ++i) {
+		free(ctx.pResults[i].starts.pAddrs);
+		free(ctx.pResults[i].ends.pAddrs);
+	}
+	free(ctx.pResults);
+	free(pStarts);
+	free(pEnds);
+	free(pRanges);
+	return res;
+}
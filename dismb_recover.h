@@ -0,0 +1,13 @@
+/* SPDX-License-Identifier: MIT */
+
+#include "wkpool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int dismb_recover_funcs(MBDisasm* pDis, WkPool* pPool);
+
+#ifdef __cplusplus
+}
+#endif
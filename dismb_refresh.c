@@ -0,0 +1,350 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "elfi32.h"
+#include "disasm_microblaze.h"
+#include "dismb_recover.h"
+#include "dismb_refresh.h"
+
+static MBSectHash* sect_hashes(void* pELF, WkPool* pPool, int* pNum) {
+	int nsects = (int)elfi32_num_sect_header_entries(pELF);
+	MBSectHash* pHashes = NULL;
+	*pNum = 0;
+	if (nsects > 0) {
+		elfi32_checksum* pSums = (elfi32_checksum*)malloc(nsects * sizeof(elfi32_checksum));
+		pHashes = (MBSectHash*)malloc(nsects * sizeof(MBSectHash));
+		if (pSums && pHashes && elfi32_sections_checksums(pELF, pPool, pSums)) {
+			int i;
+			for (i = 0; i < nsects; ++i) {
+				const char* pName = elfi32_section_name(pELF, i);
+				pHashes[i].nameCrc = pName ? elfi32_crc32(0, pName, strlen(pName)) : 0;
+				elfi32_section_addrinfo(pELF, i, &pHashes[i].addr, NULL, NULL);
+				pHashes[i].sum = pSums[i];
+			}
+			*pNum = nsects;
+		} else {
+			free(pHashes);
+			pHashes = NULL;
+		}
+		free(pSums);
+	}
+	return pHashes;
+}
+
+static int same_sect(const MBSectHash* pA, const MBSectHash* pB) {
+	return pA->nameCrc == pB->nameCrc && pA->addr == pB->addr && pA->sum.size == pB->sum.size
+		&& pA->sum.crc32 == pB->sum.crc32 && pA->sum.crc32c == pB->sum.crc32c;
+}
+
+/*
+ * The function table survives when the section layout is the same and
+ * .symtab/.strtab did not change; .text may differ in contents only.
+ */
+static int can_patch(MBDisasm* pDis, void* pELF, const MBSectHash* pOld, int nold, const MBSectHash* pNew, int nnew) {
+	int isymtab = elfi32_find_section(pELF, ".symtab");
+	int istrtab = elfi32_find_section(pELF, ".strtab");
+	int itext = pDis->itext;
+	int i;
+	if (!pOld || !pNew || nold != nnew || isymtab < 0 || istrtab < 0) {
+		return 0;
+	}
+	if (!pDis->pELF && !pDis->pText) {
+		return 0;
+	}
+	for (i = 0; i < nnew; ++i) {
+		if (pOld[i].nameCrc != pNew[i].nameCrc) {
+			return 0;
+		}
+	}
+	if (itext < 0 || itext >= nnew || elfi32_find_section(pELF, ".text") != itext) {
+		return 0;
+	}
+	if (pOld[itext].addr != pNew[itext].addr || pOld[itext].sum.size != pNew[itext].sum.size) {
+		return 0;
+	}
+	return same_sect(&pOld[isymtab], &pNew[isymtab]) && same_sect(&pOld[istrtab], &pNew[istrtab]);
+}
+
+/* word range of the function inside .text */
+static uint32_t func_words(MBDisasm* pDis, int ifunc, uint32_t* pRel) {
+	uint32_t rel = pDis->pFuncs[ifunc].addr - pDis->textAddr;
+	uint32_t textSize = pDis->textSize & ~3u;
+	uint32_t n = 0;
+	if (rel < textSize && (rel & 3) == 0) {
+		n = pDis->pFuncs[ifunc].size / 4;
+		if (n > (textSize - rel) / 4) {
+			n = (textSize - rel) / 4;
+		}
+	}
+	*pRel = rel;
+	return n;
+}
+
+static int refresh_in_place(MBDisasm* pDis, void* pELF, size_t size, int textChanged, MBRefresh* pRes) {
+	uint32_t newTextOffs = 0;
+	int i;
+	pRes->pChanged = (int*)malloc((pDis->numFuncs + 1) * sizeof(int));
+	if (!pRes->pChanged) {
+		free(pELF);
+		return 0;
+	}
+	elfi32_section_addrinfo(pELF, pDis->itext, NULL, &newTextOffs, NULL);
+	if (textChanged) {
+		for (i = 0; i < pDis->numFuncs; ++i) {
+			uint32_t rel;
+			uint32_t n = func_words(pDis, i, &rel);
+			uint32_t k;
+			int diff = 0;
+			if (pDis->pText) {
+				for (k = 0; k < n && !diff; ++k) {
+					diff = pDis->pText[(rel >> 2) + k] != elfi32_read_u32(pELF, newTextOffs + rel + k*4);
+				}
+			} else {
+				diff = memcmp((uint8_t*)pDis->pELF + pDis->textOffs + rel, (uint8_t*)pELF + newTextOffs + rel, n * 4) != 0;
+			}
+			if (diff) {
+				pRes->pChanged[pRes->numChanged++] = i;
+			}
+		}
+	}
+	if (pDis->pText) {
+		/* compacted: take over the new words and section info, drop the image */
+		uint32_t nwords = pDis->textSize / 4;
+		uint32_t iw;
+		if (textChanged) {
+			for (iw = 0; iw < nwords; ++iw) {
+				pDis->pText[iw] = elfi32_read_u32(pELF, newTextOffs + iw*4);
+			}
+		}
+		for (i = 0; i < pDis->numSects; ++i) {
+			MBSection* pSect = &pDis->pSects[i];
+			pSect->type = elfi32_section_type(pELF, i);
+			pSect->flags = elfi32_section_flags(pELF, i);
+			elfi32_section_addrinfo(pELF, i, &pSect->addr, &pSect->offs, &pSect->size);
+		}
+		free(pELF);
+	} else {
+		/*
+		 * Names move with .strtab, which is byte-identical. Names living
+		 * elsewhere (sub_XXXXXXXX from dismb_recover_funcs() are in the
+		 * arena) stay where they are.
+		 */
+		uint32_t oldStrOffs = 0;
+		uint32_t oldStrSize = 0;
+		uint32_t newStrOffs = 0;
+		uintptr_t strBase;
+		elfi32_section_addrinfo(pDis->pELF, elfi32_find_section(pDis->pELF, ".strtab"), NULL, &oldStrOffs, &oldStrSize);
+		elfi32_section_addrinfo(pELF, elfi32_find_section(pELF, ".strtab"), NULL, &newStrOffs, NULL);
+		strBase = (uintptr_t)pDis->pELF + oldStrOffs;
+		for (i = 0; i < pDis->numFuncs; ++i) {
+			uintptr_t nameOffs = (uintptr_t)pDis->pFuncs[i].pName - strBase;
+			if (nameOffs < oldStrSize) {
+				pDis->pFuncs[i].pName = (const char*)pELF + newStrOffs + nameOffs;
+			}
+		}
+		if (pDis->pImgBuf != pELF) {
+			free(pDis->pImgBuf);
+		}
+		pDis->pImgBuf = pELF;
+		pDis->imgBufSize = size;
+		pDis->pELF = pELF;
+		pDis->elfSize = size;
+	}
+	pDis->textOffs = newTextOffs;
+	return 1;
+}
+
+typedef struct _OldFunc {
+	const char* pName;
+	uint32_t size;
+	uint32_t crc32;
+	uint32_t crc32c;
+} OldFunc;
+
+static int cmp_old_name(const void* pA, const void* pB) {
+	return strcmp(((const OldFunc*)pA)->pName, ((const OldFunc*)pB)->pName);
+}
+
+/* dismb_recover_funcs() appends its functions after the symbol ones */
+static int has_recovered(const MBDisasm* pDis) {
+	char name[16];
+	const MBFunc* pLast;
+	if (pDis->numFuncs <= 0) {
+		return 0;
+	}
+	pLast = &pDis->pFuncs[pDis->numFuncs - 1];
+	sprintf(name, "sub_%08X", pLast->addr);
+	return strcmp(name, pLast->pName) == 0;
+}
+
+/*
+ * Symbols changed: rebuild everything from the new image, then match the
+ * functions to the old ones by name and keep only code changes. Recovered
+ * functions are recovered again from the new code.
+ */
+static int refresh_reload(MBDisasm* pDis, void* pELF, size_t size, WkPool* pPool, MBRefresh* pRes) {
+	const struct _elfi32_lines* pLines = pDis->pLines;
+	MBLineFn lineFn = pDis->lineFn;
+	int wasCompact = pDis->pText != NULL;
+	int hadIdx = pDis->pAddrIdx != NULL;
+	int hadRecovered = has_recovered(pDis);
+	int numOld = pDis->numFuncs;
+	size_t namesSize = 0;
+	OldFunc* pOld;
+	MBFuncSum* pSums;
+	char* pNames;
+	int i;
+	for (i = 0; i < numOld; ++i) {
+		namesSize += strlen(pDis->pFuncs[i].pName) + 1;
+	}
+	pOld = (OldFunc*)malloc((numOld + 1) * sizeof(OldFunc));
+	pNames = (char*)malloc(namesSize + 1);
+	if (!pOld || !pNames) {
+		free(pOld);
+		free(pNames);
+		free(pELF);
+		return 0;
+	}
+	{
+		char* pDst = pNames;
+		for (i = 0; i < numOld; ++i) {
+			MBFuncSum sum;
+			size_t len = strlen(pDis->pFuncs[i].pName) + 1;
+			dismb_func_checksum(pDis, i, &sum);
+			memcpy(pDst, pDis->pFuncs[i].pName, len);
+			pOld[i].pName = pDst;
+			pOld[i].size = sum.size;
+			pOld[i].crc32 = sum.crc32;
+			pOld[i].crc32c = sum.crc32c;
+			pDst += len;
+		}
+	}
+	qsort(pOld, numOld, sizeof(OldFunc), cmp_old_name);
+	pRes->reloaded = 1;
+	if (!dismb_load_image(pDis, pELF, size, 0)) {
+		free(pOld);
+		free(pNames);
+		return 0;
+	}
+	dismb_set_lines(pDis, pLines, lineFn);
+	if (hadRecovered) {
+		dismb_recover_funcs(pDis, pPool);
+	}
+	pSums = (MBFuncSum*)malloc((pDis->numFuncs + 1) * sizeof(MBFuncSum));
+	pRes->pChanged = (int*)malloc((pDis->numFuncs + 1) * sizeof(int));
+	if (pSums && pRes->pChanged) {
+		dismb_func_checksums(pDis, pPool, pSums);
+		for (i = 0; i < pDis->numFuncs; ++i) {
+			OldFunc key;
+			const OldFunc* pMatch;
+			key.pName = pDis->pFuncs[i].pName;
+			pMatch = (const OldFunc*)bsearch(&key, pOld, numOld, sizeof(OldFunc), cmp_old_name);
+			if (!pMatch || pMatch->size != pSums[i].size || pMatch->crc32 != pSums[i].crc32 || pMatch->crc32c != pSums[i].crc32c) {
+				pRes->pChanged[pRes->numChanged++] = i;
+			}
+		}
+	} else {
+		/* no room to compare: report every function */
+		free(pRes->pChanged);
+		pRes->pChanged = NULL;
+		pRes->numChanged = pDis->numFuncs;
+	}
+	free(pSums);
+	free(pOld);
+	free(pNames);
+	if (wasCompact) {
+		dismb_compact(pDis);
+	}
+	if (hadIdx) {
+		dismb_build_addr_index(pDis);
+	}
+	return 1;
+}
+
+/*
+ * Brings pDis up to date with a rebuilt image, taking ownership of it like
+ * dismb_load_image(). Section hashes from the previous refresh (or the
+ * current image) show what changed: with the symbols unchanged the function
+ * table, names, address index and compacted text are patched in place and
+ * only functions whose words differ are reported, otherwise the image is
+ * reloaded and functions are matched by name. A compacted pDis has no image
+ * to hash, so its first refresh always reloads. A dismb_set_lines() table
+ * is kept, rebuilding it is up to the caller. Functions added by
+ * dismb_recover_funcs() survive both paths: patching keeps them, a reload
+ * runs the recovery again.
+ */
+int dismb_refresh_image(MBDisasm* pDis, void* pELF, size_t size, WkPool* pPool, MBRefresh* pRes) {
+	int res = 0;
+	MBRefresh tmp;
+	MBSectHash* pOld;
+	MBSectHash* pNew;
+	int nold;
+	int nnew;
+	int i;
+	if (!pRes) {
+		pRes = &tmp;
+	}
+	memset(pRes, 0, sizeof(MBRefresh));
+	if (!pDis || !pELF || size <= 0x10 || !elfi32_valid(pELF)) {
+		free(pELF);
+		return 0;
+	}
+	if (!pDis->pSectHashes && pDis->pELF) {
+		pDis->pSectHashes = sect_hashes(pDis->pELF, pPool, &pDis->numSectHashes);
+	}
+	pOld = pDis->pSectHashes;
+	nold = pDis->numSectHashes;
+	pDis->pSectHashes = NULL;
+	pDis->numSectHashes = 0;
+	pNew = sect_hashes(pELF, pPool, &nnew);
+	for (i = 0; i < nnew; ++i) {
+		pRes->numSectsChanged += !pOld || i >= nold || !same_sect(&pOld[i], &pNew[i]);
+	}
+	if (can_patch(pDis, pELF, pOld, nold, pNew, nnew)) {
+		res = refresh_in_place(pDis, pELF, size, !same_sect(&pOld[pDis->itext], &pNew[pDis->itext]), pRes);
+	} else {
+		res = refresh_reload(pDis, pELF, size, pPool, pRes);
+	}
+	if (res) {
+		pDis->pSectHashes = pNew;
+		pDis->numSectHashes = pNew ? nnew : 0;
+		free(pOld);
+	} else {
+		free(pNew);
+		if (pDis->pFuncs) {
+			/* the old state is intact */
+			pDis->pSectHashes = pOld;
+			pDis->numSectHashes = nold;
+		} else {
+			free(pOld);
+		}
+	}
+	if (pRes == &tmp) {
+		dismb_refresh_free(pRes);
+	}
+	return res;
+}
+
+int dismb_refresh(MBDisasm* pDis, const char* pElfPath, WkPool* pPool, MBRefresh* pRes) {
+	int res = 0;
+	if (pDis && pElfPath) {
+		size_t size = 0;
+		void* pELF = elfi32_load(pElfPath, &size);
+		if (pELF) {
+			res = dismb_refresh_image(pDis, pELF, size, pPool, pRes);
+		} else if (pRes) {
+			memset(pRes, 0, sizeof(MBRefresh));
+		}
+	}
+	return res;
+}
+
+void dismb_refresh_free(MBRefresh* pRes) {
+	if (pRes) {
+		free(pRes->pChanged);
+		memset(pRes, 0, sizeof(MBRefresh));
+	}
+}
@@ -0,0 +1,33 @@
+/* SPDX-License-Identifier: MIT */
+
+#ifndef DISMB_REFRESH_H
+#define DISMB_REFRESH_H
+
+#include "dismb_crc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _MBSectHash {
+	uint32_t nameCrc;
+	uint32_t addr;
+	elfi32_checksum sum;
+} MBSectHash;
+
+typedef struct _MBRefresh {
+	int reloaded; /* symbols changed, the function table was rebuilt */
+	int numSectsChanged;
+	int numChanged;
+	int* pChanged; /* ascending indices of functions with new or different code */
+} MBRefresh;
+
+int dismb_refresh(MBDisasm* pDis, const char* pElfPath, WkPool* pPool, MBRefresh* pRes);
+int dismb_refresh_image(MBDisasm* pDis, void* pELF, size_t size, WkPool* pPool, MBRefresh* pRes);
+void dismb_refresh_free(MBRefresh* pRes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
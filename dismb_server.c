@@ -0,0 +1,794 @@
+/* SPDX-License-Identifier: MIT */
+
+#ifndef _GNU_SOURCE
+#	define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "elfi32.h"
+#include "elfi32_dwline.h"
+#include "disasm_microblaze.h"
+#include "wkpool.h"
+#include "dismb_server.h"
+
+#ifndef MSG_NOSIGNAL
+#	define MSG_NOSIGNAL 0
+#endif
+
+#define SRV_BACKLOG 64
+#define SRV_IDLE_MS 10000
+
+typedef enum _MBImgState {
+	MBIMG_LOADING,
+	MBIMG_READY,
+	MBIMG_FAILED
+} MBImgState;
+
+typedef struct _MBSrvName {
+	const char* pName;
+	int ifunc;
+} MBSrvName;
+
+/*
+ * One resident image. Once READY nothing in it is written again, so any
+ * number of workers can query it while they hold a reference.
+ */
+typedef struct _MBSrvImage {
+	struct _MBSrvImage* pPrev;
+	struct _MBSrvImage* pNext;
+	char* pPath;
+	dev_t dev;
+	ino_t ino;
+	time_t mtime;
+	off_t fileSize;
+	int refs;
+	int listed;
+	MBImgState state;
+	MBDisasm dis;
+	elfi32_lines lines;
+	MBSrvName* pByName;
+	size_t memSize;
+} MBSrvImage;
+
+typedef struct _MBBuf {
+	char* pBuf;
+	size_t len;
+	size_t cap;
+} MBBuf;
+
+struct _MBServer {
+	MBServerCfg cfg;
+	char* pSockPath;
+	int listenFd;
+	int stopFds[2];
+	WkPool* pPool;
+	pthread_mutex_t mtx;
+	pthread_cond_t cv;
+	/* most recently used first */
+	MBSrvImage* pHead;
+	MBSrvImage* pTail;
+	MBServerStats stats;
+};
+
+static int buf_reserve(MBBuf* pBuf, size_t len) {
+	if (pBuf->len + len > pBuf->cap) {
+		size_t cap = pBuf->cap ? pBuf->cap : 4096;
+		char* pNew;
+		while (cap < pBuf->len + len) {
+			cap *= 2;
+		}
+		pNew = (char*)realloc(pBuf->pBuf, cap);
+		if (!pNew) {
+			return 0;
+		}
+		pBuf->pBuf = pNew;
+		pBuf->cap = cap;
+	}
+	return 1;
+}
+
+static void buf_append(void* pCtx, const char* pStr, size_t len) {
+	MBBuf* pBuf = (MBBuf*)pCtx;
+	if (buf_reserve(pBuf, len)) {
+		memcpy(pBuf->pBuf + pBuf->len, pStr, len);
+		pBuf->len += len;
+	}
+}
+
+static int read_all(int fd, void* pDst, size_t size) {
+	size_t done = 0;
+	while (done < size) {
+		ssize_t n = read(fd, (char*)pDst + done, size - done);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			return 0;
+		}
+		done += (size_t)n;
+	}
+	return 1;
+}
+
+static int write_all(int fd, const void* pSrc, size_t size) {
+	size_t done = 0;
+	while (done < size) {
+		ssize_t n = send(fd, (const char*)pSrc + done, size - done, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			return 0;
+		}
+		done += (size_t)n;
+	}
+	return 1;
+}
+
+static int cmp_srv_name(const void* pA, const void* pB) {
+	const MBSrvName* pNameA = (const MBSrvName*)pA;
+	const MBSrvName* pNameB = (const MBSrvName*)pB;
+	int cmp = strcmp(pNameA->pName, pNameB->pName);
+	return cmp ? cmp : pNameA->ifunc - pNameB->ifunc;
+}
+
+/* strcmp() against a name that is not NUL-terminated */
+static int cmp_name_len(const char* pStr, const char* pName, size_t len) {
+	int cmp = strncmp(pStr, pName, len);
+	return cmp ? cmp : pStr[len] != 0;
+}
+
+/* same answer as dismb_find_func(): the first function with that name */
+static int image_find_func(const MBSrvImage* pImg, const char* pName, size_t len) {
+	int lo = 0;
+	int hi = pImg->dis.numFuncs;
+	if (memchr(pName, 0, len)) {
+		return -1;
+	}
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (cmp_name_len(pImg->pByName[mid].pName, pName, len) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	if (lo < pImg->dis.numFuncs && cmp_name_len(pImg->pByName[lo].pName, pName, len) == 0) {
+		return pImg->pByName[lo].ifunc;
+	}
+	return -1;
+}
+
+static size_t lines_mem(const elfi32_lines* pLines) {
+	size_t size = pLines->numBlks * sizeof(elfi32_lineblk) + pLines->deltasSize + pLines->numFiles * sizeof(elfi32_linefile);
+	int i;
+	for (i = 0; i < pLines->numFiles; ++i) {
+		const elfi32_linefile* pFile = &pLines->pFiles[i];
+		size += (pFile->pDir ? strlen(pFile->pDir) + 1 : 0) + (pFile->pName ? strlen(pFile->pName) + 1 : 0);
+	}
+	return size;
+}
+
+/*
+ * Loads and indexes the image, then drops the ELF itself: queries only
+ * need the compacted text, the function tables and the line rows.
+ */
+static int image_load(MBSrvImage* pImg, int verbose) {
+	MBDisasm* pDis = &pImg->dis;
+	int res = 0;
+	memset(pDis, 0, sizeof(MBDisasm));
+	dismb_arena_init(&pDis->arena, 0);
+	if (dismb_load_ex(pDis, pImg->pPath, 0) && dismb_build_addr_index(pDis)) {
+		size_t names = 0;
+		int i;
+		if (elfi32_lines_build(pDis->pELF, &pImg->lines)) {
+			dismb_set_lines(pDis, &pImg->lines, elfi32_lines_lookup);
+		}
+		dismb_compact(pDis);
+		pImg->pByName = (MBSrvName*)malloc((pDis->numFuncs + 1) * sizeof(MBSrvName));
+		if (pImg->pByName) {
+			for (i = 0; i < pDis->numFuncs; ++i) {
+				pImg->pByName[i].pName = pDis->pFuncs[i].pName;
+				pImg->pByName[i].ifunc = i;
+				names += strlen(pDis->pFuncs[i].pName) + 1;
+			}
+			qsort(pImg->pByName, pDis->numFuncs, sizeof(MBSrvName), cmp_srv_name);
+			pImg->memSize = sizeof(MBSrvImage) + strlen(pImg->pPath) + 1 + pDis->elfSize + (pDis->textSize & ~3u)
+				+ pDis->numFuncs * (sizeof(MBFunc) + sizeof(MBAddrIdx) + sizeof(MBSrvName)) + names
+				+ pDis->numSects * sizeof(MBSection) + lines_mem(&pImg->lines);
+			res = 1;
+		}
+	}
+	if (verbose) {
+		fprintf(stderr, "%s \"%s\": %d funcs, %zu bytes resident\n", res ? "loaded" : "failed to load", pImg->pPath, pDis->numFuncs, pImg->memSize);
+	}
+	return res;
+}
+
+static void image_free(MBSrvImage* pImg) {
+	if (pImg) {
+		dismb_free(&pImg->dis);
+		elfi32_lines_free(&pImg->lines);
+		free(pImg->pByName);
+		free(pImg->pPath);
+		free(pImg);
+	}
+}
+
+static void list_unlink(MBServer* pSrv, MBSrvImage* pImg) {
+	if (pImg->pPrev) {
+		pImg->pPrev->pNext = pImg->pNext;
+	} else {
+		pSrv->pHead = pImg->pNext;
+	}
+	if (pImg->pNext) {
+		pImg->pNext->pPrev = pImg->pPrev;
+	} else {
+		pSrv->pTail = pImg->pPrev;
+	}
+	pImg->pPrev = NULL;
+	pImg->pNext = NULL;
+	pImg->listed = 0;
+}
+
+static void list_push_front(MBServer* pSrv, MBSrvImage* pImg) {
+	pImg->pPrev = NULL;
+	pImg->pNext = pSrv->pHead;
+	if (pSrv->pHead) {
+		pSrv->pHead->pPrev = pImg;
+	} else {
+		pSrv->pTail = pImg;
+	}
+	pSrv->pHead = pImg;
+	pImg->listed = 1;
+}
+
+/* takes an image off the list; it is freed once the last reference goes */
+static MBSrvImage* detach(MBServer* pSrv, MBSrvImage* pImg) {
+	list_unlink(pSrv, pImg);
+	if (pImg->state == MBIMG_READY) {
+		pSrv->stats.memUsed -= pImg->memSize;
+	}
+	--pSrv->stats.numImages;
+	return pImg->refs == 0 ? pImg : NULL;
+}
+
+/*
+ * Drops unreferenced images from the cold end until the budget is met.
+ * Called with the lock held; the returned chain is freed after unlocking.
+ */
+static MBSrvImage* evict(MBServer* pSrv) {
+	MBSrvImage* pFree = NULL;
+	MBSrvImage* pImg = pSrv->pTail;
+	while (pImg && pSrv->cfg.memBudget && pSrv->stats.memUsed > pSrv->cfg.memBudget) {
+		MBSrvImage* pPrev = pImg->pPrev;
+		if (pImg->refs == 0 && pImg->state == MBIMG_READY) {
+			detach(pSrv, pImg);
+			pImg->pNext = pFree;
+			pFree = pImg;
+			++pSrv->stats.evictions;
+			if (pSrv->cfg.verbose) {
+				fprintf(stderr, "evicted \"%s\"\n", pImg->pPath);
+			}
+		}
+		pImg = pPrev;
+	}
+	return pFree;
+}
+
+static void free_chain(MBSrvImage* pImg) {
+	while (pImg) {
+		MBSrvImage* pNext = pImg->pNext;
+		image_free(pImg);
+		pImg = pNext;
+	}
+}
+
+static int same_file(const MBSrvImage* pImg, const struct stat* pSt) {
+	return pImg->dev == pSt->st_dev && pImg->ino == pSt->st_ino && pImg->mtime == pSt->st_mtime && pImg->fileSize == pSt->st_size;
+}
+
+/*
+ * Returns a referenced READY image for pPath, loading it if needed.
+ * A file that changed on disk since it was loaded is loaded again.
+ * Only one worker loads a given path, the others wait for it.
+ */
+static MBSrvImage* image_acquire(MBServer* pSrv, const char* pPath) {
+	MBSrvImage* pImg;
+	MBSrvImage* pFree = NULL;
+	struct stat st;
+	int ok;
+	if (stat(pPath, &st) != 0 || !S_ISREG(st.st_mode)) {
+		return NULL;
+	}
+	pthread_mutex_lock(&pSrv->mtx);
+	for (pImg = pSrv->pHead; pImg; pImg = pImg->pNext) {
+		if (strcmp(pImg->pPath, pPath) == 0) {
+			break;
+		}
+	}
+	if (pImg && pImg->state == MBIMG_READY && !same_file(pImg, &st)) {
+		pFree = detach(pSrv, pImg);
+		pImg = NULL;
+	}
+	if (pImg) {
+		++pImg->refs;
+		++pSrv->stats.hits;
+		list_unlink(pSrv, pImg);
+		list_push_front(pSrv, pImg);
+		while (pImg->state == MBIMG_LOADING) {
+			pthread_cond_wait(&pSrv->cv, &pSrv->mtx);
+		}
+		if (pImg->state != MBIMG_READY) {
+			if (--pImg->refs == 0 && !pImg->listed) {
+				pFree = pImg;
+			}
+			pImg = NULL;
+		}
+		pthread_mutex_unlock(&pSrv->mtx);
+		image_free(pFree);
+		return pImg;
+	}
+	pImg = (MBSrvImage*)calloc(1, sizeof(MBSrvImage));
+	if (pImg) {
+		pImg->pPath = strdup(pPath);
+		if (!pImg->pPath) {
+			free(pImg);
+			pImg = NULL;
+		}
+	}
+	if (!pImg) {
+		pthread_mutex_unlock(&pSrv->mtx);
+		image_free(pFree);
+		return NULL;
+	}
+	pImg->dev = st.st_dev;
+	pImg->ino = st.st_ino;
+	pImg->mtime = st.st_mtime;
+	pImg->fileSize = st.st_size;
+	pImg->refs = 1;
+	pImg->state = MBIMG_LOADING;
+	list_push_front(pSrv, pImg);
+	++pSrv->stats.numImages;
+	pthread_mutex_unlock(&pSrv->mtx);
+	image_free(pFree);
+
+	ok = image_load(pImg, pSrv->cfg.verbose);
+
+	pthread_mutex_lock(&pSrv->mtx);
+	++pSrv->stats.loads;
+	if (ok) {
+		pImg->state = MBIMG_READY;
+		pSrv->stats.memUsed += pImg->memSize;
+		pFree = evict(pSrv);
+	} else {
+		pImg->state = MBIMG_FAILED;
+		detach(pSrv, pImg);
+		pFree = --pImg->refs == 0 ? pImg : NULL;
+		pImg = NULL;
+	}
+	pthread_cond_broadcast(&pSrv->cv);
+	pthread_mutex_unlock(&pSrv->mtx);
+	free_chain(pFree);
+	return pImg;
+}
+
+static void image_release(MBServer* pSrv, MBSrvImage* pImg) {
+	MBSrvImage* pFree = NULL;
+	if (pImg) {
+		pthread_mutex_lock(&pSrv->mtx);
+		if (--pImg->refs == 0) {
+			if (pImg->listed) {
+				/* it may have been pinned while the budget was exceeded */
+				pFree = evict(pSrv);
+			} else {
+				pFree = pImg;
+				pImg->pNext = NULL;
+			}
+		}
+		pthread_mutex_unlock(&pSrv->mtx);
+		free_chain(pFree);
+	}
+}
+
+static void run_query(const MBSrvImage* pImg, const MBQItem* pItem, const char* pArg, MBBuf* pOut) {
+	MBDisasm* pDis = (MBDisasm*)&pImg->dis;
+	size_t top = pOut->len;
+	MBQResult res;
+	int ifunc = -1;
+	memset(&res, 0, sizeof(res));
+	res.kind = pItem->kind;
+	buf_append(pOut, (const char*)&res, sizeof(res));
+	if (pOut->len != top + sizeof(res)) {
+		return;
+	}
+	switch (pItem->kind) {
+	case MBQ_FIND:
+	case MBQ_DISASM:
+		if (pItem->argLen > 0) {
+			ifunc = image_find_func(pImg, pArg, pItem->argLen);
+		} else if (pItem->kind == MBQ_DISASM) {
+			ifunc = dismb_func_at(pDis, pItem->addr);
+		} else {
+			res.status = MBQS_BADQUERY;
+			break;
+		}
+		if (ifunc < 0) {
+			res.status = MBQS_NOTFOUND;
+		} else if (pItem->kind == MBQ_FIND) {
+			buf_append(pOut, pDis->pFuncs[ifunc].pName, strlen(pDis->pFuncs[ifunc].pName));
+		} else {
+			dismb_func_out(pDis, ifunc, buf_append, pOut);
+		}
+		break;
+	case MBQ_RESOLVE: {
+		char text[512];
+		int len = dismb_resolve_pc(pDis, pItem->addr, text, sizeof(text));
+		ifunc = dismb_func_at(pDis, pItem->addr);
+		if (ifunc < 0) {
+			res.status = MBQS_NOTFOUND;
+		}
+		buf_append(pOut, text, (size_t)len);
+		break;
+	}
+	default:
+		res.status = MBQS_BADQUERY;
+		break;
+	}
+	res.ifunc = ifunc;
+	if (ifunc >= 0) {
+		res.addr = pDis->pFuncs[ifunc].addr;
+		res.size = pDis->pFuncs[ifunc].size;
+	}
+	res.textLen = (uint32_t)(pOut->len - top - sizeof(res));
+	memcpy(pOut->pBuf + top, &res, sizeof(res));
+}
+
+static int send_status(int fd, MBQStatus status) {
+	MBQHdr hdr;
+	hdr.magic = MBQ_RESP_MAGIC;
+	hdr.size = sizeof(hdr);
+	hdr.count = 0;
+	hdr.extra = (uint16_t)status;
+	return write_all(fd, &hdr, sizeof(hdr));
+}
+
+/*
+ * Answers one request from pReq (the bytes after the header). Returns 0
+ * when the connection should be closed.
+ */
+static int serve_request(MBServer* pSrv, int fd, const MBQHdr* pHdr, const char* pReq, MBBuf* pOut) {
+	size_t reqSize = pHdr->size - sizeof(MBQHdr);
+	size_t pos = pHdr->extra;
+	char path[4096];
+	MBSrvImage* pImg;
+	MBQHdr hdr;
+	int i;
+	if (pHdr->extra == 0 || pHdr->extra >= sizeof(path) || pos > reqSize) {
+		send_status(fd, MBQS_BADMSG);
+		return 0;
+	}
+	memcpy(path, pReq, pHdr->extra);
+	path[pHdr->extra] = 0;
+	/* validate all items before loading anything */
+	for (i = 0; i < pHdr->count; ++i) {
+		MBQItem item;
+		if (reqSize - pos < sizeof(item)) {
+			send_status(fd, MBQS_BADMSG);
+			return 0;
+		}
+		memcpy(&item, pReq + pos, sizeof(item));
+		pos += sizeof(item);
+		if (reqSize - pos < item.argLen) {
+			send_status(fd, MBQS_BADMSG);
+			return 0;
+		}
+		pos += item.argLen;
+	}
+	if (pos != reqSize) {
+		send_status(fd, MBQS_BADMSG);
+		return 0;
+	}
+	pImg = image_acquire(pSrv, path);
+	if (!pImg) {
+		return send_status(fd, MBQS_LOADFAIL);
+	}
+	pOut->len = 0;
+	buf_reserve(pOut, sizeof(hdr));
+	pOut->len = sizeof(hdr);
+	pos = pHdr->extra;
+	for (i = 0; i < pHdr->count; ++i) {
+		MBQItem item;
+		memcpy(&item, pReq + pos, sizeof(item));
+		pos += sizeof(item);
+		run_query(pImg, &item, pReq + pos, pOut);
+		pos += item.argLen;
+	}
+	image_release(pSrv, pImg);
+	if (!pOut->pBuf || pOut->len > 0xFFFFFFFFu) {
+		return send_status(fd, MBQS_BADMSG);
+	}
+	hdr.magic = MBQ_RESP_MAGIC;
+	hdr.size = (uint32_t)pOut->len;
+	hdr.count = pHdr->count;
+	hdr.extra = MBQS_OK;
+	memcpy(pOut->pBuf, &hdr, sizeof(hdr));
+	return write_all(fd, pOut->pBuf, pOut->len);
+}
+
+/* waits for fd to become readable; 0 once the server is stopping or after timeoutMs (< 0 waits forever) */
+static int wait_readable(MBServer* pSrv, int fd, int timeoutMs) {
+	struct pollfd fds[2];
+	int n;
+	for (;;) {
+		fds[0].fd = fd;
+		fds[0].events = POLLIN;
+		fds[0].revents = 0;
+		fds[1].fd = pSrv->stopFds[0];
+		fds[1].events = POLLIN;
+		fds[1].revents = 0;
+		n = poll(fds, 2, timeoutMs);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return 0;
+		}
+		if (n == 0) {
+			return 0;
+		}
+		if (fds[1].revents) {
+			return 0;
+		}
+		if (fds[0].revents) {
+			return 1;
+		}
+	}
+}
+
+static void serve_conn(MBServer* pSrv, int fd, MBBuf* pReq, MBBuf* pOut) {
+	for (;;) {
+		MBQHdr hdr;
+		if (!wait_readable(pSrv, fd, pSrv->cfg.idleMs) || !read_all(fd, &hdr, sizeof(hdr))) {
+			break;
+		}
+		if (hdr.magic != MBQ_REQ_MAGIC || hdr.size < sizeof(hdr) || hdr.size > MBQ_MAX_MSG) {
+			send_status(fd, MBQS_BADMSG);
+			break;
+		}
+		pReq->len = 0;
+		if (!buf_reserve(pReq, hdr.size - sizeof(hdr) + 1) || !read_all(fd, pReq->pBuf, hdr.size - sizeof(hdr))) {
+			break;
+		}
+		pthread_mutex_lock(&pSrv->mtx);
+		++pSrv->stats.requests;
+		pthread_mutex_unlock(&pSrv->mtx);
+		if (!serve_request(pSrv, fd, &hdr, pReq->pBuf, pOut)) {
+			break;
+		}
+	}
+}
+
+/* one per worker: accepts and serves connections until stopped */
+static void conn_worker(int ijob, int iwk, void* pCtxMem) {
+	MBServer* pSrv = (MBServer*)pCtxMem;
+	MBBuf req;
+	MBBuf out;
+	(void)ijob;
+	(void)iwk;
+	memset(&req, 0, sizeof(req));
+	memset(&out, 0, sizeof(out));
+	while (wait_readable(pSrv, pSrv->listenFd, -1)) {
+		int fd = accept(pSrv->listenFd, NULL, NULL);
+		if (fd < 0) {
+			/* another worker got it, or the client went away */
+			continue;
+		}
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+		if (pSrv->cfg.idleMs > 0) {
+			/* a client stalling inside a message or not reading its reply */
+			struct timeval tv;
+			tv.tv_sec = pSrv->cfg.idleMs / 1000;
+			tv.tv_usec = (pSrv->cfg.idleMs % 1000) * 1000;
+			setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+			setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+		}
+		serve_conn(pSrv, fd, &req, &out);
+		close(fd);
+	}
+	free(req.pBuf);
+	free(out.pBuf);
+}
+
+MBServer* dismb_server_create(const MBServerCfg* pCfg) {
+	MBServer* pSrv = NULL;
+	struct sockaddr_un addr;
+	struct stat st;
+	if (!pCfg || !pCfg->pSockPath || strlen(pCfg->pSockPath) >= sizeof(addr.sun_path)) {
+		return NULL;
+	}
+	pSrv = (MBServer*)calloc(1, sizeof(MBServer));
+	if (!pSrv) {
+		return NULL;
+	}
+	pSrv->cfg = *pCfg;
+	if (pSrv->cfg.idleMs == 0) {
+		pSrv->cfg.idleMs = SRV_IDLE_MS;
+	}
+	pSrv->pSockPath = strdup(pCfg->pSockPath);
+	pSrv->cfg.pSockPath = pSrv->pSockPath;
+	pSrv->listenFd = -1;
+	pSrv->stopFds[0] = -1;
+	pSrv->stopFds[1] = -1;
+	pthread_mutex_init(&pSrv->mtx, NULL);
+	pthread_cond_init(&pSrv->cv, NULL);
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, pCfg->pSockPath);
+	/* a stale socket from an earlier run, never a regular file */
+	if (lstat(pCfg->pSockPath, &st) == 0 && S_ISSOCK(st.st_mode)) {
+		unlink(pCfg->pSockPath);
+	}
+	if (!pSrv->pSockPath || pipe(pSrv->stopFds) != 0
+		|| (pSrv->listenFd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0
+		|| bind(pSrv->listenFd, (struct sockaddr*)&addr, sizeof(addr)) != 0
+		|| listen(pSrv->listenFd, SRV_BACKLOG) != 0) {
+		dismb_server_destroy(pSrv);
+		return NULL;
+	}
+	fcntl(pSrv->listenFd, F_SETFL, fcntl(pSrv->listenFd, F_GETFL) | O_NONBLOCK);
+	fcntl(pSrv->listenFd, F_SETFD, FD_CLOEXEC);
+	if (pCfg->nworkers > 1) {
+		pSrv->pPool = wkpool_create(pCfg->nworkers);
+	}
+	return pSrv;
+}
+
+/* serves until dismb_server_stop(), returns the number of workers used */
+int dismb_server_run(MBServer* pSrv) {
+	int nworkers = 0;
+	if (pSrv) {
+		nworkers = wkpool_num_workers(pSrv->pPool);
+		wkpool_for(pSrv->pPool, nworkers, conn_worker, pSrv);
+	}
+	return nworkers;
+}
+
+/* only writes to a pipe, so it may be called from a signal handler */
+void dismb_server_stop(MBServer* pSrv) {
+	if (pSrv && pSrv->stopFds[1] >= 0) {
+		char c = 0;
+		ssize_t n = write(pSrv->stopFds[1], &c, 1);
+		(void)n;
+	}
+}
+
+void dismb_server_destroy(MBServer* pSrv) {
+	if (pSrv) {
+		wkpool_destroy(pSrv->pPool);
+		if (pSrv->listenFd >= 0) {
+			close(pSrv->listenFd);
+			unlink(pSrv->pSockPath);
+		}
+		if (pSrv->stopFds[0] >= 0) {
+			close(pSrv->stopFds[0]);
+			close(pSrv->stopFds[1]);
+		}
+		while (pSrv->pHead) {
+			MBSrvImage* pImg = pSrv->pHead;
+			list_unlink(pSrv, pImg);
+			image_free(pImg);
+		}
+		pthread_cond_destroy(&pSrv->cv);
+		pthread_mutex_destroy(&pSrv->mtx);
+		free(pSrv->pSockPath);
+		free(pSrv);
+	}
+}
+
+void dismb_server_stats(MBServer* pSrv, MBServerStats* pStats) {
+	if (pSrv && pStats) {
+		pthread_mutex_lock(&pSrv->mtx);
+		*pStats = pSrv->stats;
+		pthread_mutex_unlock(&pSrv->mtx);
+	}
+}
+
+int dismb_query_connect(const char* pSockPath) {
+	struct sockaddr_un addr;
+	int fd;
+	if (!pSockPath || strlen(pSockPath) >= sizeof(addr.sun_path)) {
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, pSockPath);
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd >= 0 && connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+		close(fd);
+		fd = -1;
+	}
+	return fd;
+}
+
+/*
+ * Sends the n queries as one request on a connected socket and calls fn
+ * for every result in order. Returns the MBQS_* status of the reply, or
+ * -1 on I/O or protocol errors.
+ */
+int dismb_query(int fd, const char* pElfPath, const MBQuery* pQueries, int n, MBQueryFn fn, void* pCtx) {
+	MBBuf buf;
+	MBQHdr hdr;
+	size_t pathLen = pElfPath ? strlen(pElfPath) : 0;
+	size_t pos;
+	int res = -1;
+	int i;
+	if (fd < 0 || pathLen == 0 || pathLen > 0xFFFF || n < 0 || n > 0xFFFF || (n > 0 && !pQueries)) {
+		return -1;
+	}
+	memset(&buf, 0, sizeof(buf));
+	buf.len = sizeof(hdr);
+	if (!buf_reserve(&buf, 0)) {
+		return -1;
+	}
+	buf_append(&buf, pElfPath, pathLen);
+	for (i = 0; i < n; ++i) {
+		MBQItem item;
+		size_t argLen = pQueries[i].pName ? strlen(pQueries[i].pName) : 0;
+		item.kind = (uint8_t)pQueries[i].kind;
+		item.reserved = 0;
+		item.argLen = (uint16_t)(argLen > 0xFFFF ? 0xFFFF : argLen);
+		item.addr = pQueries[i].addr;
+		buf_append(&buf, (const char*)&item, sizeof(item));
+		if (item.argLen > 0) {
+			buf_append(&buf, pQueries[i].pName, item.argLen);
+		}
+	}
+	hdr.magic = MBQ_REQ_MAGIC;
+	hdr.size = (uint32_t)buf.len;
+	hdr.count = (uint16_t)n;
+	hdr.extra = (uint16_t)pathLen;
+	if (buf.len <= MBQ_MAX_MSG) {
+		memcpy(buf.pBuf, &hdr, sizeof(hdr));
+		if (write_all(fd, buf.pBuf, buf.len) && read_all(fd, &hdr, sizeof(hdr))
+			&& hdr.magic == MBQ_RESP_MAGIC && hdr.size >= sizeof(hdr)) {
+			buf.len = 0;
+			if (buf_reserve(&buf, hdr.size - sizeof(hdr)) && read_all(fd, buf.pBuf, hdr.size - sizeof(hdr))) {
+				size_t size = hdr.size - sizeof(hdr);
+				res = hdr.extra;
+				pos = 0;
+				for (i = 0; i < hdr.count; ++i) {
+					MBQResult qres;
+					if (size - pos < sizeof(qres)) {
+						res = -1;
+						break;
+					}
+					memcpy(&qres, buf.pBuf + pos, sizeof(qres));
+					pos += sizeof(qres);
+					if (size - pos < qres.textLen) {
+						res = -1;
+						break;
+					}
+					if (fn) {
+						fn(i, &qres, buf.pBuf + pos, pCtx);
+					}
+					pos += qres.textLen;
+				}
+			}
+		}
+	}
+	free(buf.pBuf);
+	return res;
+}
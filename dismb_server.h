@@ -0,0 +1,100 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Wire format, host byte order (the socket is local). A request is an
+ * MBQHdr with magic MBQ_REQ_MAGIC and extra = length of the ELF path,
+ * the path bytes, then count MBQItem entries each followed by argLen name
+ * bytes. The reply is an MBQHdr with magic MBQ_RESP_MAGIC and extra = an
+ * MBQS_* status, then count MBQResult entries each followed by textLen
+ * bytes. size always covers the whole message including the header.
+ * A connection may carry any number of requests.
+ */
+#define MBQ_REQ_MAGIC 0x3151424D /* "MBQ1" */
+#define MBQ_RESP_MAGIC 0x3152424D /* "MBR1" */
+#define MBQ_MAX_MSG (16 << 20)
+
+typedef enum _MBQKind {
+	MBQ_FIND = 1, /* name -> function */
+	MBQ_DISASM, /* name, or addr when argLen is 0 -> dismb_func_out() listing */
+	MBQ_RESOLVE /* addr -> dismb_resolve_pc() text */
+} MBQKind;
+
+typedef enum _MBQStatus {
+	MBQS_OK,
+	MBQS_NOTFOUND,
+	MBQS_BADQUERY,
+	MBQS_LOADFAIL,
+	MBQS_BADMSG
+} MBQStatus;
+
+typedef struct _MBQHdr {
+	uint32_t magic;
+	uint32_t size;
+	uint16_t count;
+	uint16_t extra;
+} MBQHdr;
+
+typedef struct _MBQItem {
+	uint8_t kind;
+	uint8_t reserved;
+	uint16_t argLen;
+	uint32_t addr;
+} MBQItem;
+
+typedef struct _MBQResult {
+	uint8_t kind;
+	uint8_t status;
+	uint16_t reserved;
+	int32_t ifunc;
+	uint32_t addr; /* of the function */
+	uint32_t size;
+	uint32_t textLen;
+} MBQResult;
+
+typedef struct _MBServerCfg {
+	const char* pSockPath;
+	int nworkers; /* concurrent connections, <= 1 serves them one at a time */
+	size_t memBudget; /* for resident images, 0 means no limit */
+	int verbose;
+	int idleMs; /* a connection with no request for this long is closed, 0 picks a default, < 0 waits forever */
+} MBServerCfg;
+
+typedef struct _MBServerStats {
+	int numImages;
+	size_t memUsed;
+	uint64_t loads;
+	uint64_t hits;
+	uint64_t evictions;
+	uint64_t requests;
+} MBServerStats;
+
+typedef struct _MBServer MBServer;
+
+MBServer* dismb_server_create(const MBServerCfg* pCfg);
+int dismb_server_run(MBServer* pSrv);
+void dismb_server_stop(MBServer* pSrv);
+void dismb_server_destroy(MBServer* pSrv);
+void dismb_server_stats(MBServer* pSrv, MBServerStats* pStats);
+
+typedef struct _MBQuery {
+	MBQKind kind;
+	uint32_t addr;
+	const char* pName; /* NULL for address queries */
+} MBQuery;
+
+/* pText is not NUL-terminated and only valid for the duration of the call */
+typedef void (*MBQueryFn)(int iquery, const MBQResult* pRes, const char* pText, void* pCtx);
+
+int dismb_query_connect(const char* pSockPath);
+int dismb_query(int fd, const char* pElfPath, const MBQuery* pQueries, int n, MBQueryFn fn, void* pCtx);
+
+#ifdef __cplusplus
+}
+#endif
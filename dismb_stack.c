@@ -0,0 +1,223 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "elfi32.h"
+#include "disasm_microblaze.h"
+#include "dismb_stack.h"
+
+typedef struct _CallEdges {
+	int* pTargets;
+	int num;
+	int cap;
+} CallEdges;
+
+static void edge_add(CallEdges* pEdges, int ifunc) {
+	if (pEdges->num >= pEdges->cap) {
+		int cap = pEdges->cap ? pEdges->cap * 2 : 1024;
+		int* pTargets = (int*)realloc(pEdges->pTargets, sizeof(int) * cap);
+		if (!pTargets) {
+			return;
+		}
+		pEdges->pTargets = pTargets;
+		pEdges->cap = cap;
+	}
+	pEdges->pTargets[pEdges->num++] = ifunc;
+}
+
+static void frame_instr(const MBInstr* pPrev, const MBInstr* pInstr, void* pCtx) {
+	int* pFrame = (int*)pCtx;
+	if (*pFrame < 0 && pInstr->op == MBOP_ADDIK && pInstr->rD == 1 && pInstr->rA == 1) {
+		int32_t imm = dismb_fuse_imm(pPrev, pInstr);
+		if (imm < 0) {
+			*pFrame = -imm;
+		}
+	}
+}
+
+/* size of the frame allocated by the addik r1, r1, -N prologue, 0 if none */
+int dismb_func_frame(MBDisasm* pDis, int ifunc) {
+	int frame = -1;
+	if (pDis && (uint32_t)ifunc < (uint32_t)pDis->numFuncs) {
+		dismb_walk_func(pDis, ifunc, frame_instr, &frame);
+	}
+	return frame < 0 ? 0 : frame;
+}
+
+typedef struct _ScanCtx {
+	MBDisasm* pDis;
+	int ifunc;
+	int frame;
+	uint32_t flags;
+	CallEdges* pEdges;
+} ScanCtx;
+
+static void scan_instr(const MBInstr* pPrev, const MBInstr* pInstr, void* pCtxMem) {
+	ScanCtx* pCtx = (ScanCtx*)pCtxMem;
+	MBOp op = pInstr->op;
+	frame_instr(pPrev, pInstr, &pCtx->frame);
+	if (op == MBOP_BRLID || op == MBOP_BRALID) {
+		int32_t imm = dismb_fuse_imm(pPrev, pInstr);
+		uint32_t target = op == MBOP_BRLID ? pInstr->addr + (uint32_t)imm : (uint32_t)imm;
+		int icallee = dismb_func_at(pCtx->pDis, target);
+		if (icallee >= 0) {
+			edge_add(pCtx->pEdges, icallee);
+		} else {
+			pCtx->flags |= MBSTACK_UNRESOLVED;
+		}
+	} else if (op == MBOP_BRLD || op == MBOP_BRALD) {
+		pCtx->flags |= MBSTACK_INDIRECT;
+	}
+}
+
+/*
+ * Worst-case stack depth of every function: its own frame plus the
+ * deepest direct callee. One iterative DFS over the call graph visits
+ * every function and edge once; back edges mark recursion and are not
+ * followed, so recursive depths are lower bounds.
+ *
+ * Needs dismb_build_addr_index() first to resolve call targets and does
+ * not modify pDis; returns 0 without the index.
+ */
+int dismb_stack_analyze(MBDisasm* pDis, MBStackInfo* pInfo) {
+	int res = 0;
+	int nfuncs;
+	int* pEdgeTop;
+	int* pState;
+	int* pStack;
+	int* pEdgeIt;
+	CallEdges edges;
+	int i;
+	if (!pDis || !pDis->pAddrIdx || !pInfo) {
+		return 0;
+	}
+	nfuncs = pDis->numFuncs;
+	memset(&edges, 0, sizeof(edges));
+	pEdgeTop = (int*)malloc(sizeof(int) * (nfuncs + 1));
+	pState = (int*)calloc(nfuncs + 1, sizeof(int));
+	pStack = (int*)malloc(sizeof(int) * (nfuncs + 1));
+	pEdgeIt = (int*)malloc(sizeof(int) * (nfuncs + 1));
+	if (pEdgeTop && pState && pStack && pEdgeIt) {
+		ScanCtx ctx;
+		ctx.pDis = pDis;
+		ctx.pEdges = &edges;
+		/* call graph in CSR form: edges of i are [pEdgeTop[i], pEdgeTop[i + 1]) */
+		for (i = 0; i < nfuncs; ++i) {
+			pEdgeTop[i] = edges.num;
+			ctx.ifunc = i;
+			ctx.frame = -1;
+			ctx.flags = 0;
+			dismb_walk_func(pDis, i, scan_instr, &ctx);
+			pInfo[i].frame = ctx.frame < 0 ? 0 : (uint32_t)ctx.frame;
+			pInfo[i].depth = 0;
+			pInfo[i].worstCallee = -1;
+			pInfo[i].numCallers = 0;
+			pInfo[i].flags = ctx.flags;
+			if (ctx.flags & (MBSTACK_INDIRECT | MBSTACK_UNRESOLVED)) {
+				pInfo[i].flags |= MBSTACK_INCOMPLETE;
+			}
+		}
+		pEdgeTop[nfuncs] = edges.num;
+		for (i = 0; i < nfuncs; ++i) {
+			int e;
+			for (e = pEdgeTop[i]; e < pEdgeTop[i + 1]; ++e) {
+				if (edges.pTargets[e] != i) {
+					++pInfo[edges.pTargets[e]].numCallers;
+				}
+			}
+		}
+		for (i = 0; i < nfuncs; ++i) {
+			int sp = 0;
+			if (pState[i] != 0) {
+				continue;
+			}
+			pStack[sp++] = i;
+			pState[i] = 1;
+			pEdgeIt[i] = pEdgeTop[i];
+			while (sp > 0) {
+				int f = pStack[sp - 1];
+				if (pEdgeIt[f] < pEdgeTop[f + 1]) {
+					int callee = edges.pTargets[pEdgeIt[f]++];
+					if (pState[callee] == 0) {
+						pState[callee] = 1;
+						pEdgeIt[callee] = pEdgeTop[callee];
+						pStack[sp++] = callee;
+					} else if (pState[callee] == 1) {
+						/* back edge: everything from callee up to f is on a cycle */
+						int j = sp - 1;
+						for (;;) {
+							pInfo[pStack[j]].flags |= MBSTACK_RECURSIVE | MBSTACK_INCOMPLETE;
+							if (pStack[j] == callee || j == 0) {
+								break;
+							}
+							--j;
+						}
+					} else {
+						uint32_t depth = pInfo[f].frame + pInfo[callee].depth;
+						if (depth > pInfo[f].depth) {
+							pInfo[f].depth = depth;
+							pInfo[f].worstCallee = callee;
+						}
+						pInfo[f].flags |= pInfo[callee].flags & MBSTACK_INCOMPLETE;
+					}
+				} else {
+					/* all callees done */
+					if (pInfo[f].depth < pInfo[f].frame) {
+						pInfo[f].depth = pInfo[f].frame;
+					}
+					pState[f] = 2;
+					--sp;
+					if (sp > 0) {
+						int caller = pStack[sp - 1];
+						uint32_t depth = pInfo[caller].frame + pInfo[f].depth;
+						if (depth > pInfo[caller].depth) {
+							pInfo[caller].depth = depth;
+							pInfo[caller].worstCallee = f;
+						}
+						pInfo[caller].flags |= pInfo[f].flags & MBSTACK_INCOMPLETE;
+					}
+				}
+			}
+		}
+		res = 1;
+	}
+	free(edges.pTargets);
+	free(pEdgeTop);
+	free(pState);
+	free(pStack);
+	free(pEdgeIt);
+	return res;
+}
+
+/* entry points (functions without direct callers) and their worst call path */
+void dismb_stack_report(MBDisasm* pDis, const MBStackInfo* pInfo, MBTextFn fn, void* pCtx) {
+	int i;
+	if (!pDis || !pInfo) {
+		return;
+	}
+	for (i = 0; i < pDis->numFuncs; ++i) {
+		if (pInfo[i].numCallers == 0) {
+			char line[512];
+			int len;
+			int f = i;
+			int n = 0;
+			len = snprintf(line, sizeof(line), "%-32s depth=%u%s%s%s:", pDis->pFuncs[i].pName, pInfo[i].depth,
+				(pInfo[i].flags & MBSTACK_INCOMPLETE) ? "+" : "",
+				(pInfo[i].flags & MBSTACK_RECURSIVE) ? " recursive" : "",
+				(pInfo[i].flags & MBSTACK_INDIRECT) ? " indirect" : "");
+			while (f >= 0 && n < pDis->numFuncs && len < (int)sizeof(line)) {
+				len += snprintf(line + len, sizeof(line) - len, " %s(%u)", pDis->pFuncs[f].pName, pInfo[f].frame);
+				f = pInfo[f].worstCallee;
+				++n;
+			}
+			if (len >= (int)sizeof(line) - 1) {
+				len = (int)sizeof(line) - 2;
+			}
+			line[len++] = '\n';
+			line[len] = 0;
+			dismb_text_out(fn, pCtx, line, len);
+		}
+	}
+}
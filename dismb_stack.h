@@ -0,0 +1,26 @@
+/* SPDX-License-Identifier: MIT */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MBSTACK_INDIRECT 1 /* makes calls through a register */
+#define MBSTACK_RECURSIVE 2 /* lies on a call cycle */
+#define MBSTACK_INCOMPLETE 4 /* depth is a lower bound (indirect calls or recursion below) */
+#define MBSTACK_UNRESOLVED 8 /* calls an address outside all known functions */
+
+typedef struct _MBStackInfo {
+	uint32_t frame;
+	uint32_t depth;
+	int worstCallee;
+	int numCallers;
+	uint32_t flags;
+} MBStackInfo;
+
+int dismb_func_frame(MBDisasm* pDis, int ifunc);
+int dismb_stack_analyze(MBDisasm* pDis, MBStackInfo* pInfo);
+void dismb_stack_report(MBDisasm* pDis, const MBStackInfo* pInfo, MBTextFn fn, void* pCtx);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,516 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "elfi32.h"
+#include "disasm_microblaze.h"
+#include "dismb_xref.h"
+
+#define XREF_FUNCS_PER_JOB 256
+
+/* r3-r12, r15, r17, r18: not preserved across calls */
+#define VOLATILE_REGS 0x00069FF8u
+
+#define CLEAR_VOLATILE 1
+#define CLEAR_ALL 2
+
+typedef struct _ObjList {
+	MBDataObj* pObjs;
+	int num;
+	int cap;
+	size_t namesSize;
+	MBXrefTable* pTab;
+} ObjList;
+
+typedef struct _RawRef {
+	int iobj;
+	uint32_t kind;
+} RawRef;
+
+typedef struct _XrefJob {
+	MBXref* pRefs;
+	uint32_t num;
+	uint32_t cap;
+	uint64_t unresolved;
+	int failed;
+} XrefJob;
+
+typedef struct _XrefCtx {
+	MBDisasm* pDis;
+	MBXrefTable* pTab;
+	XrefJob* pJobs;
+	uint32_t* pFuncCnt;
+} XrefCtx;
+
+/* register values known at the current instruction of one function */
+typedef struct _ScanState {
+	const MBXrefTable* pTab;
+	uint32_t funcAddr;
+	uint32_t funcSize;
+	uint32_t* pTargets; /* bit per word: branch target inside the function */
+	uint32_t baseKnown; /* r0 and the small data base registers */
+	uint32_t known;
+	uint32_t vals[32];
+	int pendingClear;
+	RawRef* pRaw;
+	uint32_t numRaw;
+	uint32_t capRaw;
+	uint64_t unresolved;
+	int failed;
+} ScanState;
+
+static int obj_symfn(int isym, const char* pName, uint32_t addr, uint32_t size, uint32_t attr, void* pCtxMem) {
+	ObjList* pList = (ObjList*)pCtxMem;
+	uint32_t shndx = attr >> 16;
+	(void)isym;
+	if (strcmp(pName, "_SDA_BASE_") == 0) {
+		pList->pTab->sdaBase = addr;
+		pList->pTab->hasSda = 1;
+	} else if (strcmp(pName, "_SDA2_BASE_") == 0) {
+		pList->pTab->sda2Base = addr;
+		pList->pTab->hasSda2 = 1;
+	}
+	/* STT_OBJECT, defined in a real section */
+	if ((attr & 0xF) == 1 && shndx != 0 && shndx < 0xFF00) {
+		if (pList->num >= pList->cap) {
+			int cap = pList->cap ? pList->cap * 2 : 256;
+			MBDataObj* pObjs = (MBDataObj*)realloc(pList->pObjs, sizeof(MBDataObj) * cap);
+			if (!pObjs) {
+				return 0;
+			}
+			pList->pObjs = pObjs;
+			pList->cap = cap;
+		}
+		pList->pObjs[pList->num].addr = addr;
+		pList->pObjs[pList->num].size = size;
+		pList->pObjs[pList->num].pName = pName;
+		pList->namesSize += strlen(pName) + 1;
+		++pList->num;
+	}
+	return 1;
+}
+
+static int cmp_obj_addr(const void* pA, const void* pB) {
+	const MBDataObj* pObjA = (const MBDataObj*)pA;
+	const MBDataObj* pObjB = (const MBDataObj*)pB;
+	if (pObjA->addr != pObjB->addr) {
+		return pObjA->addr < pObjB->addr ? -1 : 1;
+	}
+	if (pObjA->size != pObjB->size) {
+		return pObjA->size > pObjB->size ? -1 : 1;
+	}
+	return strcmp(pObjA->pName, pObjB->pName);
+}
+
+/* same lookup rules as dismb_func_at() */
+int dismb_xref_obj_at(const MBXrefTable* pTab, uint32_t addr) {
+	int iobj = -1;
+	if (pTab && pTab->pObjs) {
+		const MBDataObj* pObjs = pTab->pObjs;
+		int lo = 0;
+		int hi = pTab->numObjs;
+		/* first entry above addr */
+		while (lo < hi) {
+			int mid = (lo + hi) / 2;
+			if (pObjs[mid].addr <= addr) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
+		}
+		/* walk back over aliases and zero-sized labels */
+		while (--lo >= 0) {
+			if (addr - pObjs[lo].addr < pObjs[lo].size || addr == pObjs[lo].addr) {
+				iobj = lo;
+				break;
+			}
+			if (lo > 0 && pObjs[lo - 1].addr != pObjs[lo].addr && pObjs[lo].size > 0) {
+				break;
+			}
+		}
+	}
+	return iobj;
+}
+
+int dismb_xref_find_obj(const MBXrefTable* pTab, const char* pName) {
+	int idx = -1;
+	if (pTab && pName) {
+		int i;
+		for (i = 0; i < pTab->numObjs; ++i) {
+			if (strcmp(pName, pTab->pObjs[i].pName) == 0) {
+				idx = i;
+				break;
+			}
+		}
+	}
+	return idx;
+}
+
+static void target_instr(const MBInstr* pPrev, const MBInstr* pInstr, void* pCtxMem) {
+	ScanState* pState = (ScanState*)pCtxMem;
+	uint32_t flags = dismb_op_flags(pInstr->op);
+	if ((flags & MBOPF_BRANCH) && !(flags & MBOPF_REG)) {
+		int32_t imm = dismb_fuse_imm(pPrev, pInstr);
+		uint32_t target = (flags & MBOPF_ABS) ? (uint32_t)imm : pInstr->addr + (uint32_t)imm;
+		uint32_t rel = target - pState->funcAddr;
+		if (rel < pState->funcSize) {
+			pState->pTargets[rel >> 7] |= 1u << ((rel >> 2) & 31);
+		}
+	}
+}
+
+static void add_ref(ScanState* pState, uint32_t addr, uint32_t kind) {
+	int iobj = dismb_xref_obj_at(pState->pTab, addr);
+	if (iobj < 0) {
+		/* constants are not always addresses, only count real accesses */
+		if (kind != MBXREF_ADDR) {
+			++pState->unresolved;
+		}
+		return;
+	}
+	if (pState->numRaw >= pState->capRaw) {
+		uint32_t cap = pState->capRaw ? pState->capRaw * 2 : 256;
+		RawRef* pRaw = (RawRef*)realloc(pState->pRaw, sizeof(RawRef) * cap);
+		if (!pRaw) {
+			pState->failed = 1;
+			return;
+		}
+		pState->pRaw = pRaw;
+		pState->capRaw = cap;
+	}
+	pState->pRaw[pState->numRaw].iobj = iobj;
+	pState->pRaw[pState->numRaw].kind = kind;
+	++pState->numRaw;
+}
+
+static void set_reg(ScanState* pState, int32_t reg, int known, uint32_t val) {
+	if (reg > 0) {
+		if (known) {
+			pState->known |= 1u << reg;
+			pState->vals[reg] = val;
+		} else {
+			pState->known &= ~(1u << reg);
+		}
+	}
+}
+
+static int reg_known(const ScanState* pState, int32_t reg) {
+	return reg >= 0 && ((pState->known >> reg) & 1);
+}
+
+/*
+ * Forward constant tracking through one function: addik/addi/ori build
+ * addresses from r0 (absolute, usually behind an imm prefix) or from the
+ * small data bases in r13/r2, and loads/stores resolve against known base
+ * registers. Branch targets inside the function reset what is known, as
+ * do calls (volatile registers) and unconditional jumps (everything).
+ */
+static void track_instr(const MBInstr* pPrev, const MBInstr* pInstr, void* pCtxMem) {
+	ScanState* pState = (ScanState*)pCtxMem;
+	MBOp op = pInstr->op;
+	uint32_t flags = dismb_op_flags(op);
+	uint32_t rel = pInstr->addr - pState->funcAddr;
+	int pending = pState->pendingClear;
+	int32_t imm;
+	pState->pendingClear = 0;
+	if (rel < pState->funcSize && (pState->pTargets[rel >> 7] >> ((rel >> 2) & 31)) & 1) {
+		pState->known = pState->baseKnown;
+	}
+	imm = dismb_fuse_imm(pPrev, pInstr);
+	if (op == MBOP_ADDIK || op == MBOP_ADDI || op == MBOP_ORI) {
+		if (reg_known(pState, pInstr->rA)) {
+			uint32_t val = op == MBOP_ORI ? pState->vals[pInstr->rA] | (uint32_t)imm : pState->vals[pInstr->rA] + (uint32_t)imm;
+			add_ref(pState, val, MBXREF_ADDR);
+			set_reg(pState, pInstr->rD, 1, val);
+		} else {
+			set_reg(pState, pInstr->rD, 0, 0);
+		}
+	} else if ((flags & (MBOPF_LOAD | MBOPF_STORE)) && op != MBOP_LBUEA && op != MBOP_LHUEA && op != MBOP_LWEA
+		&& op != MBOP_SBEA && op != MBOP_SHEA && op != MBOP_SWEA) {
+		uint32_t kind = (flags & MBOPF_LOAD) ? MBXREF_LOAD : MBXREF_STORE;
+		if (pInstr->rB < 0) {
+			if (reg_known(pState, pInstr->rA)) {
+				add_ref(pState, pState->vals[pInstr->rA] + (uint32_t)imm, kind);
+			}
+		} else if (reg_known(pState, pInstr->rA) && reg_known(pState, pInstr->rB)) {
+			add_ref(pState, pState->vals[pInstr->rA] + pState->vals[pInstr->rB], kind);
+		}
+		if (flags & MBOPF_LOAD) {
+			set_reg(pState, pInstr->rD, 0, 0);
+		}
+	} else if (!(flags & MBOPF_STORE) && (!(flags & MBOPF_BRANCH) || (flags & MBOPF_LINK)) && op != MBOP_IMM) {
+		set_reg(pState, pInstr->rD, 0, 0);
+	}
+	if (flags & MBOPF_BRANCH) {
+		int clear = 0;
+		if (flags & MBOPF_LINK) {
+			clear = CLEAR_VOLATILE;
+		} else if (!(flags & MBOPF_COND)) {
+			clear = CLEAR_ALL;
+		}
+		if (flags & MBOPF_DELAY) {
+			pState->pendingClear = clear;
+		} else {
+			pending |= clear;
+		}
+	}
+	if (pending & CLEAR_ALL) {
+		pState->known = pState->baseKnown;
+	} else if (pending & CLEAR_VOLATILE) {
+		pState->known &= ~VOLATILE_REGS;
+	}
+}
+
+static int cmp_raw(const void* pA, const void* pB) {
+	const RawRef* pRawA = (const RawRef*)pA;
+	const RawRef* pRawB = (const RawRef*)pB;
+	return pRawA->iobj - pRawB->iobj;
+}
+
+static void job_add(XrefJob* pJob, int iobj, uint32_t kinds, uint32_t count, int* pFailed) {
+	if (pJob->num >= pJob->cap) {
+		uint32_t cap = pJob->cap ? pJob->cap * 2 : 1024;
+		MBXref* pRefs = (MBXref*)realloc(pJob->pRefs, sizeof(MBXref) * cap);
+		if (!pRefs) {
+			*pFailed = 1;
+			return;
+		}
+		pJob->pRefs = pRefs;
+		pJob->cap = cap;
+	}
+	pJob->pRefs[pJob->num].idx = iobj;
+	pJob->pRefs[pJob->num].kinds = kinds;
+	pJob->pRefs[pJob->num].count = count;
+	++pJob->num;
+}
+
+/* one range of functions; refs of each function are merged per object */
+static void xref_job(int ijob, int iwk, void* pCtxMem) {
+	XrefCtx* pCtx = (XrefCtx*)pCtxMem;
+	MBDisasm* pDis = pCtx->pDis;
+	XrefJob* pJob = &pCtx->pJobs[ijob];
+	ScanState state;
+	uint32_t capTargets = 0;
+	int first = ijob * XREF_FUNCS_PER_JOB;
+	int last = first + XREF_FUNCS_PER_JOB < pDis->numFuncs ? first + XREF_FUNCS_PER_JOB : pDis->numFuncs;
+	int i;
+	(void)iwk;
+	memset(&state, 0, sizeof(state));
+	state.pTab = pCtx->pTab;
+	state.baseKnown = 1;
+	if (pCtx->pTab->hasSda) {
+		state.baseKnown |= 1u << 13;
+		state.vals[13] = pCtx->pTab->sdaBase;
+	}
+	if (pCtx->pTab->hasSda2) {
+		state.baseKnown |= 1u << 2;
+		state.vals[2] = pCtx->pTab->sda2Base;
+	}
+	for (i = first; i < last && !state.failed; ++i) {
+		uint32_t nwords = (pDis->pFuncs[i].size / 4 + 31) / 32;
+		uint32_t r;
+		uint32_t top = pJob->num;
+		if (nwords > capTargets) {
+			uint32_t* pTargets = (uint32_t*)realloc(state.pTargets, sizeof(uint32_t) * nwords);
+			if (!pTargets) {
+				state.failed = 1;
+				break;
+			}
+			state.pTargets = pTargets;
+			capTargets = nwords;
+		}
+		if (nwords > 0) {
+			memset(state.pTargets, 0, sizeof(uint32_t) * nwords);
+		}
+		state.funcAddr = pDis->pFuncs[i].addr;
+		state.funcSize = pDis->pFuncs[i].size & ~3u;
+		state.known = state.baseKnown;
+		state.pendingClear = 0;
+		state.numRaw = 0;
+		dismb_walk_func(pDis, i, target_instr, &state);
+		dismb_walk_func(pDis, i, track_instr, &state);
+		qsort(state.pRaw, state.numRaw, sizeof(RawRef), cmp_raw);
+		for (r = 0; r < state.numRaw; ++r) {
+			if (pJob->num > top && pJob->pRefs[pJob->num - 1].idx == state.pRaw[r].iobj) {
+				pJob->pRefs[pJob->num - 1].kinds |= state.pRaw[r].kind;
+				++pJob->pRefs[pJob->num - 1].count;
+			} else {
+				job_add(pJob, state.pRaw[r].iobj, state.pRaw[r].kind, 1, &state.failed);
+			}
+		}
+		pCtx->pFuncCnt[i] = pJob->num - top;
+	}
+	pJob->unresolved = state.unresolved;
+	pJob->failed = state.failed;
+	free(state.pTargets);
+	free(state.pRaw);
+}
+
+static int collect_objs(MBDisasm* pDis, MBXrefTable* pTab) {
+	ObjList list;
+	char* pPool;
+	int i;
+	memset(&list, 0, sizeof(list));
+	list.pTab = pTab;
+	elfi32_foreach_sym(pDis->pELF, obj_symfn, &list);
+	qsort(list.pObjs, list.num, sizeof(MBDataObj), cmp_obj_addr);
+	pTab->pNames = (char*)malloc(list.namesSize + 1);
+	if (!pTab->pNames || (list.num > 0 && !list.pObjs)) {
+		free(list.pObjs);
+		return 0;
+	}
+	pPool = pTab->pNames;
+	for (i = 0; i < list.num; ++i) {
+		size_t len = strlen(list.pObjs[i].pName) + 1;
+		memcpy(pPool, list.pObjs[i].pName, len);
+		list.pObjs[i].pName = pPool;
+		pPool += len;
+	}
+	pTab->pObjs = list.pObjs;
+	pTab->numObjs = list.num;
+	return 1;
+}
+
+/*
+ * Function <-> data object references of the whole image. Needs the ELF
+ * for the symbol table, so it does not work on a compacted MBDisasm.
+ * Functions are scanned in parallel ranges; the reverse direction is a
+ * counting sort of the forward edges.
+ */
+int dismb_xref_build(MBDisasm* pDis, WkPool* pPool, MBXrefTable* pTab) {
+	int res = 0;
+	XrefCtx ctx;
+	int njobs;
+	int i;
+	if (!pDis || !pTab) {
+		return 0;
+	}
+	memset(pTab, 0, sizeof(MBXrefTable));
+	if (!pDis->pELF || !pDis->pFuncs || !collect_objs(pDis, pTab)) {
+		dismb_xref_free(pTab);
+		return 0;
+	}
+	pTab->numFuncs = pDis->numFuncs;
+	njobs = (pDis->numFuncs + XREF_FUNCS_PER_JOB - 1) / XREF_FUNCS_PER_JOB;
+	ctx.pDis = pDis;
+	ctx.pTab = pTab;
+	ctx.pJobs = (XrefJob*)calloc(njobs + 1, sizeof(XrefJob));
+	ctx.pFuncCnt = (uint32_t*)calloc(pDis->numFuncs + 1, sizeof(uint32_t));
+	pTab->pFuncTop = (uint32_t*)malloc(sizeof(uint32_t) * (pDis->numFuncs + 1));
+	pTab->pObjTop = (uint32_t*)calloc(pTab->numObjs + 1, sizeof(uint32_t));
+	if (ctx.pJobs && ctx.pFuncCnt && pTab->pFuncTop && pTab->pObjTop) {
+		uint32_t total = 0;
+		int ok = 1;
+		wkpool_for(pPool, njobs, xref_job, &ctx);
+		for (i = 0; i < njobs; ++i) {
+			ok &= !ctx.pJobs[i].failed;
+			total += ctx.pJobs[i].num;
+			pTab->numUnresolved += ctx.pJobs[i].unresolved;
+		}
+		pTab->pFuncRefs = (MBXref*)malloc(sizeof(MBXref) * (total + 1));
+		pTab->pObjRefs = (MBXref*)malloc(sizeof(MBXref) * (total + 1));
+		if (ok && pTab->pFuncRefs && pTab->pObjRefs) {
+			uint32_t pos = 0;
+			uint32_t* pFill;
+			for (i = 0; i < njobs; ++i) {
+				if (ctx.pJobs[i].num > 0) {
+					memcpy(pTab->pFuncRefs + pos, ctx.pJobs[i].pRefs, sizeof(MBXref) * ctx.pJobs[i].num);
+				}
+				pos += ctx.pJobs[i].num;
+			}
+			pos = 0;
+			for (i = 0; i < pDis->numFuncs; ++i) {
+				pTab->pFuncTop[i] = pos;
+				pos += ctx.pFuncCnt[i];
+			}
+			pTab->pFuncTop[pDis->numFuncs] = pos;
+			/* reverse edges: count per object, prefix sum, fill in function order */
+			for (i = 0; i < (int)total; ++i) {
+				++pTab->pObjTop[pTab->pFuncRefs[i].idx + 1];
+			}
+			for (i = 0; i < pTab->numObjs; ++i) {
+				pTab->pObjTop[i + 1] += pTab->pObjTop[i];
+			}
+			pFill = (uint32_t*)malloc(sizeof(uint32_t) * (pTab->numObjs + 1));
+			if (pFill) {
+				memcpy(pFill, pTab->pObjTop, sizeof(uint32_t) * (pTab->numObjs + 1));
+				for (i = 0; i < pDis->numFuncs; ++i) {
+					uint32_t e;
+					for (e = pTab->pFuncTop[i]; e < pTab->pFuncTop[i + 1]; ++e) {
+						MBXref* pRef = &pTab->pObjRefs[pFill[pTab->pFuncRefs[e].idx]++];
+						pRef->idx = i;
+						pRef->kinds = pTab->pFuncRefs[e].kinds;
+						pRef->count = pTab->pFuncRefs[e].count;
+					}
+				}
+				free(pFill);
+				pTab->numRefs = total;
+				res = 1;
+			}
+		}
+	}
+	if (ctx.pJobs) {
+		for (i = 0; i < njobs; ++i) {
+			free(ctx.pJobs[i].pRefs);
+		}
+	}
+	free(ctx.pJobs);
+	free(ctx.pFuncCnt);
+	if (!res) {
+		dismb_xref_free(pTab);
+	}
+	return res;
+}
+
+void dismb_xref_free(MBXrefTable* pTab) {
+	if (pTab) {
+		free(pTab->pObjs);
+		free(pTab->pFuncTop);
+		free(pTab->pFuncRefs);
+		free(pTab->pObjTop);
+		free(pTab->pObjRefs);
+		free(pTab->pNames);
+		memset(pTab, 0, sizeof(MBXrefTable));
+	}
+}
+
+/*
+ * byFunc lists the objects each function touches, otherwise the functions
+ * touching each object. Kinds are shown as a (address taken), r, w.
+ */
+void dismb_xref_report(const MBXrefTable* pTab, MBDisasm* pDis, int byFunc, MBTextFn fn, void* pCtx) {
+	char line[256];
+	int n;
+	int i;
+	if (!pTab || !pDis || pTab->numFuncs != pDis->numFuncs) {
+		return;
+	}
+	n = byFunc ? pTab->numFuncs : pTab->numObjs;
+	for (i = 0; i < n; ++i) {
+		const uint32_t* pTop = byFunc ? pTab->pFuncTop : pTab->pObjTop;
+		const MBXref* pRefs = byFunc ? pTab->pFuncRefs : pTab->pObjRefs;
+		uint32_t e;
+		int len;
+		if (pTop[i] == pTop[i + 1]) {
+			continue;
+		}
+		if (byFunc) {
+			len = snprintf(line, sizeof(line), "%08X %s:\n", pDis->pFuncs[i].addr, pDis->pFuncs[i].pName);
+		} else {
+			len = snprintf(line, sizeof(line), "%08X %6u %s:\n", pTab->pObjs[i].addr, pTab->pObjs[i].size, pTab->pObjs[i].pName);
+		}
+		dismb_text_out(fn, pCtx, line, len < (int)sizeof(line) ? len : (int)sizeof(line) - 1);
+		for (e = pTop[i]; e < pTop[i + 1]; ++e) {
+			const MBXref* pRef = &pRefs[e];
+			const char* pName = byFunc ? pTab->pObjs[pRef->idx].pName : pDis->pFuncs[pRef->idx].pName;
+			len = snprintf(line, sizeof(line), "    %c%c%c %6u  %s\n",
+				(pRef->kinds & MBXREF_ADDR) ? 'a' : '-',
+				(pRef->kinds & MBXREF_LOAD) ? 'r' : '-',
+				(pRef->kinds & MBXREF_STORE) ? 'w' : '-',
+				pRef->count, pName);
+			dismb_text_out(fn, pCtx, line, len < (int)sizeof(line) ? len : (int)sizeof(line) - 1);
+		}
+	}
+}
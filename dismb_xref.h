@@ -0,0 +1,58 @@
+/* SPDX-License-Identifier: MIT */
+
+#include "wkpool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MBXREF_ADDR 1 /* address taken into a register */
+#define MBXREF_LOAD 2
+#define MBXREF_STORE 4
+
+/* STT_OBJECT symbol, the names are owned by the table */
+typedef struct _MBDataObj {
+	uint32_t addr;
+	uint32_t size;
+	const char* pName;
+} MBDataObj;
+
+/* one function/object pair, idx is the object or the function depending on the direction */
+typedef struct _MBXref {
+	int idx;
+	uint32_t kinds; /* MBXREF_* */
+	uint32_t count; /* instructions making the reference */
+} MBXref;
+
+/*
+ * Both directions in CSR form: the objects referenced by function i are
+ * pFuncRefs[pFuncTop[i] .. pFuncTop[i + 1]) in object order, the functions
+ * referencing object j are pObjRefs[pObjTop[j] .. pObjTop[j + 1]) in
+ * function order.
+ */
+typedef struct _MBXrefTable {
+	int numFuncs;
+	int numObjs;
+	MBDataObj* pObjs; /* by address */
+	uint32_t* pFuncTop;
+	MBXref* pFuncRefs;
+	uint32_t* pObjTop;
+	MBXref* pObjRefs;
+	uint32_t numRefs;
+	uint32_t sdaBase; /* _SDA_BASE_, what r13 holds */
+	uint32_t sda2Base; /* _SDA2_BASE_, what r2 holds */
+	int hasSda;
+	int hasSda2;
+	uint64_t numUnresolved; /* data addresses outside all objects */
+	char* pNames;
+} MBXrefTable;
+
+int dismb_xref_build(MBDisasm* pDis, WkPool* pPool, MBXrefTable* pTab);
+void dismb_xref_free(MBXrefTable* pTab);
+int dismb_xref_obj_at(const MBXrefTable* pTab, uint32_t addr);
+int dismb_xref_find_obj(const MBXrefTable* pTab, const char* pName);
+void dismb_xref_report(const MBXrefTable* pTab, MBDisasm* pDis, int byFunc, MBTextFn fn, void* pCtx);
+
+#ifdef __cplusplus
+}
+#endif
@@ -47,7 +47,81 @@ static size_t file_read(FILE* pFile, void* pDst, size_t size) {
 	return nread;
 }
 
-static void* bin_load(const char* pPath, size_t* pSize) {
+static void* mem_alloc(size_t size, void* pCtx) {
+	(void)pCtx;
+	return malloc(size);
+}
+
+#define STREAM_CHUNK_SIZE (64 * 1024)
+
+/*
+ * Reads until EOF without seeking, so pipes and stdin work. The buffer
+ * grows geometrically; once the ELF header is in, it is sized up front
+ * for the end of the section/program header tables, which normally
+ * covers the whole file and saves the intermediate reallocations.
+ */
+static void* stream_load(FILE* pFile, size_t* pSize) {
+	uint8_t* pData = NULL;
+	size_t size = 0;
+	size_t cap = 0;
+	int hdrChecked = 0;
+	int ok = 1;
+	if (pFile) {
+		for (;;) {
+			size_t nread;
+			if (cap - size < STREAM_CHUNK_SIZE) {
+				size_t newCap = cap ? cap * 2 : STREAM_CHUNK_SIZE;
+				uint8_t* pNew = (uint8_t*)realloc(pData, newCap);
+				if (!pNew) {
+					ok = 0;
+					break;
+				}
+				pData = pNew;
+				cap = newCap;
+			}
+			nread = file_read(pFile, pData + size, cap - size);
+			if (nread == 0) {
+				break;
+			}
+			size += nread;
+			if (!hdrChecked && size >= 0x34) {
+				uint8_t hdr[0x34];
+				hdrChecked = 1;
+				memcpy(hdr, pData, sizeof(hdr));
+				if (!elfi32_valid(hdr)) {
+					ok = 0;
+					break;
+				} else {
+					size_t shEnd;
+					size_t phEnd;
+					size_t expected;
+					elfi32_set_swap(hdr);
+					shEnd = (size_t)elfi32_sect_header_offs(hdr) + (size_t)elfi32_sect_header_entry_size(hdr) * elfi32_num_sect_header_entries(hdr);
+					phEnd = (size_t)elfi32_prog_header_offs(hdr) + (size_t)elfi32_read_u16(hdr, 0x2A) * elfi32_read_u16(hdr, 0x2C);
+					expected = shEnd > phEnd ? shEnd : phEnd;
+					if (expected > cap) {
+						uint8_t* pNew = (uint8_t*)realloc(pData, expected + STREAM_CHUNK_SIZE);
+						if (pNew) {
+							pData = pNew;
+							cap = expected + STREAM_CHUNK_SIZE;
+						}
+					}
+				}
+			}
+		}
+	}
+	if (!ok || size == 0) {
+		free(pData);
+		pData = NULL;
+		size = 0;
+	}
+	if (pSize) {
+		*pSize = size;
+	}
+	return pData;
+}
+
+static void* bin_load(const char* pPath, size_t* pSize, elfi32_allocfn fnAlloc, void* pAllocCtx) {
 	void* pData = NULL;
 	size_t size = 0;
 	if (pPath) {
@@ -55,11 +129,24 @@ static void* bin_load(const char* pPath, size_t* pSize) {
 		if (pFile) {
 			size = file_size(pFile);
 			if (size > 0) {
-				pData = malloc(size);
+				pData = fnAlloc(size, pAllocCtx);
 				if (pData) {
 					fseek(pFile, 0, SEEK_SET);
 					size = file_read(pFile, pData, size);
 				}
+			} else {
+				/* not seekable (pipe, FIFO, character device) */
+				pData = stream_load(pFile, &size);
+				if (pData && fnAlloc != mem_alloc) {
+					void* pDst = fnAlloc(size, pAllocCtx);
+					if (pDst) {
+						memcpy(pDst, pData, size);
+					} else {
+						size = 0;
+					}
+					free(pData);
+					pData = pDst;
+				}
 			}
 			fclose(pFile);
 		}
@@ -104,7 +191,7 @@ void* elfi32_load(const char* pPath, size_t* pSize) {
 	size_t size = 0;
 	void* pELF = NULL;
 	if (pPath) {
-		pELF = bin_load(pPath, &size);
+		pELF = bin_load(pPath, &size, mem_alloc, NULL);
 		if (pELF && size > 0x10) {
 			if (!elfi32_valid(pELF)) {
 				free(pELF);
@@ -124,6 +211,39 @@ void* elfi32_load(const char* pPath, size_t* pSize) {
 	return pELF;
 }
 
+void* elfi32_load_stream(FILE* pFile, size_t* pSize) {
+	size_t size = 0;
+	void* pELF = stream_load(pFile, &size);
+	if (pELF && (size <= 0x10 || !elfi32_valid(pELF))) {
+		free(pELF);
+		pELF = NULL;
+		size = 0;
+	}
+	elfi32_set_swap(pELF);
+	if (pSize) {
+		*pSize = size;
+	}
+	return pELF;
+}
+
+void* elfi32_load_alloc(const char* pPath, size_t* pSize, elfi32_allocfn fnAlloc, void* pAllocCtx) {
+	size_t size = 0;
+	void* pELF = NULL;
+	if (pPath && fnAlloc) {
+		pELF = bin_load(pPath, &size, fnAlloc, pAllocCtx);
+		if (!pELF || size <= 0x10 || !elfi32_valid(pELF)) {
+			/* memory belongs to the allocator, nothing to free here */
+			pELF = NULL;
+			size = 0;
+		}
+	}
+	elfi32_set_swap(pELF);
+	if (pSize) {
+		*pSize = size;
+	}
+	return pELF;
+}
+
 uint8_t elfi32_read_u8(void* pELF, uint32_t offs) {
 	uint8_t val = 0;
 	if (pELF) {
@@ -183,6 +303,22 @@ uint32_t elfi32_prog_header_offs(void* pELF) {
 	return offs;
 }
 
+uint32_t elfi32_prog_header_entry_size(void* pELF) {
+	uint16_t size = 0;
+	if (elfi32_valid(pELF)) {
+		size = elfi32_read_u16(pELF, 0x2A);
+	}
+	return size;
+}
+
+uint32_t elfi32_num_prog_header_entries(void* pELF) {
+	uint16_t num = 0;
+	if (elfi32_valid(pELF)) {
+		num = elfi32_read_u16(pELF, 0x2C);
+	}
+	return num;
+}
+
 uint32_t elfi32_sect_header_offs(void* pELF) {
 	uint32_t offs = 0;
 	if (elfi32_valid(pELF)) {
@@ -265,6 +401,80 @@ void elfi32_section_addrinfo(void* pELF, int isect, uint32_t* pAddr, uint32_t* p
 	}
 }
 
+const char* elfi32_section_name(void* pELF, int isect) {
+	const char* pName = NULL;
+	uint32_t nsects = elfi32_num_sect_header_entries(pELF);
+	if ((uint32_t)isect < nsects) {
+		uint32_t hoffs = elfi32_sect_header_offs(pELF);
+		uint32_t esize = elfi32_sect_header_entry_size(pELF);
+		uint32_t nid = elfi32_sect_names_entry_id(pELF);
+		if (nid < nsects) {
+			uint32_t nameStrsOffs = elfi32_read_u32(pELF, hoffs + nid*esize + 0x10);
+			uint32_t nameOffs = elfi32_read_u32(pELF, hoffs + isect*esize);
+			pName = (const char*)pELF + nameStrsOffs + nameOffs;
+		}
+	}
+	return pName;
+}
+
+uint32_t elfi32_section_type(void* pELF, int isect) {
+	uint32_t type = 0;
+	uint32_t nsects = elfi32_num_sect_header_entries(pELF);
+	if ((uint32_t)isect < nsects) {
+		uint32_t hoffs = elfi32_sect_header_offs(pELF);
+		uint32_t esize = elfi32_sect_header_entry_size(pELF);
+		type = elfi32_read_u32(pELF, hoffs + isect*esize + 0x04);
+	}
+	return type;
+}
+
+uint32_t elfi32_section_flags(void* pELF, int isect) {
+	uint32_t flags = 0;
+	uint32_t nsects = elfi32_num_sect_header_entries(pELF);
+	if ((uint32_t)isect < nsects) {
+		uint32_t hoffs = elfi32_sect_header_offs(pELF);
+		uint32_t esize = elfi32_sect_header_entry_size(pELF);
+		flags = elfi32_read_u32(pELF, hoffs + isect*esize + 0x08);
+	}
+	return flags;
+}
+
+/* pSize gets p_filesz, the part of the segment present in the file */
+void elfi32_segment_addrinfo(void* pELF, int iseg, uint32_t* pAddr, uint32_t* pOffs, uint32_t* pSize) {
+	uint32_t addr = 0;
+	uint32_t offs = 0;
+	uint32_t size = 0;
+	uint32_t nsegs = elfi32_num_prog_header_entries(pELF);
+	if ((uint32_t)iseg < nsegs) {
+		uint32_t hoffs = elfi32_prog_header_offs(pELF);
+		uint32_t esize = elfi32_prog_header_entry_size(pELF);
+		uint32_t infoTop = hoffs + iseg*esize;
+		offs = elfi32_read_u32(pELF, infoTop + 0x04);
+		addr = elfi32_read_u32(pELF, infoTop + 0x08);
+		size = elfi32_read_u32(pELF, infoTop + 0x10);
+	}
+	if (pAddr) {
+		*pAddr = addr;
+	}
+	if (pOffs) {
+		*pOffs = offs;
+	}
+	if (pSize) {
+		*pSize = size;
+	}
+}
+
+uint32_t elfi32_segment_type(void* pELF, int iseg) {
+	uint32_t type = 0;
+	uint32_t nsegs = elfi32_num_prog_header_entries(pELF);
+	if ((uint32_t)iseg < nsegs) {
+		uint32_t hoffs = elfi32_prog_header_offs(pELF);
+		uint32_t esize = elfi32_prog_header_entry_size(pELF);
+		type = elfi32_read_u32(pELF, hoffs + iseg*esize);
+	}
+	return type;
+}
+
 static void sym_foreach_sub(void* pELF, elfi32_symfn fn, void* pCtx, int mode, int* pSymCount) {
 	int isymtab = elfi32_find_section(pELF, ".symtab");
 	int istrtab = elfi32_find_section(pELF, ".strtab");
@@ -326,8 +536,123 @@ void elfi32_foreach_global_func(void* pELF, elfi32_symfn fn, void* pCtx) {
 	sym_foreach_sub(pELF, fn, pCtx, 1, NULL);
 }
 
+/* same preconditions as elfi32_foreach_global_func(): no .strtab, no names, nothing visited */
 int elfi32_num_global_funcs(void* pELF) {
 	int cnt = 0;
-	sym_foreach_sub(pELF, NULL, NULL, 1, &cnt);
+	uint32_t strtabOffs = 0;
+	uint32_t strtabSize = 0;
+	elfi32_section_addrinfo(pELF, elfi32_find_section(pELF, ".strtab"), NULL, &strtabOffs, &strtabSize);
+	if (strtabOffs > 0 && strtabSize > 0) {
+		elfi32_symfilter filter;
+		elfi32_symfilter_init(&filter);
+		filter.bindMask = 1 << 1; /* STB_GLOBAL */
+		filter.typeMask = 1 << 2; /* STT_FUNC */
+		cnt = elfi32_count_syms(pELF, &filter);
+	}
+	return cnt;
+}
+
+/* matches every symbol */
+void elfi32_symfilter_init(elfi32_symfilter* pFilter) {
+	if (pFilter) {
+		pFilter->bindMask = 0xFFFF;
+		pFilter->typeMask = 0xFFFF;
+		pFilter->visMask = 0xF;
+		pFilter->shndxMin = 0;
+		pFilter->shndxMax = 0xFFFF;
+		pFilter->addrMin = 0;
+		pFilter->addrMax = 0xFFFFFFFF;
+		pFilter->minSize = 0;
+	}
+}
+
+#define SYMFILTER_CHUNK 256
+
+typedef struct _SymChunk {
+	uint32_t addr[SYMFILTER_CHUNK];
+	uint32_t size[SYMFILTER_CHUNK];
+	uint32_t attr[SYMFILTER_CHUNK]; /* same layout as elfi32_symfn attr */
+} SymChunk;
+
+static uint32_t load_u32(const uint8_t* p, int be) {
+	return be
+		? ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3]
+		: ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+}
+
+static void sym_chunk_decode(SymChunk* pChunk, const uint8_t* pSym, int n, int be) {
+	int i;
+	for (i = 0; i < n; ++i) {
+		pChunk->addr[i] = load_u32(pSym + 4, be);
+		pChunk->size[i] = load_u32(pSym + 8, be);
+		pChunk->attr[i] = pSym[12] | ((uint32_t)pSym[13] << 8)
+			| (uint32_t)(be ? (pSym[14] << 8) | pSym[15] : (pSym[15] << 8) | pSym[14]) << 16;
+		pSym += 0x10;
+	}
+}
+
+static uint32_t sym_hit(const elfi32_symfilter* pFilter, const SymChunk* pChunk, int i, uint32_t shndxSpan, uint32_t addrSpan) {
+	uint32_t attr = pChunk->attr[i];
+	uint32_t hit = (pFilter->bindMask >> ((attr >> 4) & 0xF))
+		& (pFilter->typeMask >> (attr & 0xF))
+		& (pFilter->visMask >> ((attr >> 8) & 3))
+		& ((attr >> 16) - pFilter->shndxMin <= shndxSpan)
+		& (pChunk->addr[i] - pFilter->addrMin <= addrSpan)
+		& (pChunk->size[i] >= pFilter->minSize);
+	return hit & 1;
+}
+
+/*
+ * Decodes .symtab a chunk at a time and evaluates the filter without
+ * branching per symbol: every index is stored, and the output position
+ * only advances on a match. pSyms may be NULL to just count.
+ */
+static int sym_filter_sub(void* pELF, const elfi32_symfilter* pFilter, int* pSyms, int maxSyms) {
+	int isymtab = elfi32_find_section(pELF, ".symtab");
+	int cnt = 0;
+	if (isymtab >= 0 && pFilter) {
+		uint32_t symtabOffs = 0;
+		uint32_t symtabSize = 0;
+		elfi32_section_addrinfo(pELF, isymtab, NULL, &symtabOffs, &symtabSize);
+		if (symtabOffs > 0 && symtabSize > 0xF) {
+			SymChunk chunk;
+			int idx[SYMFILTER_CHUNK];
+			int be = (((uint8_t*)pELF)[5] & 0x7F) == 2;
+			uint32_t shndxSpan = pFilter->shndxMax - pFilter->shndxMin;
+			uint32_t addrSpan = pFilter->addrMax - pFilter->addrMin;
+			uint32_t nsym = symtabSize / 0x10;
+			uint32_t base;
+			for (base = 0; base < nsym; base += SYMFILTER_CHUNK) {
+				int n = nsym - base < SYMFILTER_CHUNK ? (int)(nsym - base) : SYMFILTER_CHUNK;
+				int nhit = 0;
+				int i;
+				sym_chunk_decode(&chunk, (const uint8_t*)pELF + symtabOffs + base*0x10, n, be);
+				if (pSyms) {
+					for (i = 0; i < n; ++i) {
+						idx[nhit] = (int)(base + i);
+						nhit += (int)sym_hit(pFilter, &chunk, i, shndxSpan, addrSpan);
+					}
+					if (cnt < maxSyms) {
+						int ncopy = maxSyms - cnt < nhit ? maxSyms - cnt : nhit;
+						memcpy(pSyms + cnt, idx, ncopy * sizeof(int));
+					}
+				} else {
+					for (i = 0; i < n; ++i) {
+						nhit += (int)sym_hit(pFilter, &chunk, i, shndxSpan, addrSpan);
+					}
+				}
+				cnt += nhit;
+			}
+		}
+	}
 	return cnt;
 }
+
+/* matching .symtab indices in ascending order, returns the total match count */
+int elfi32_filter_syms(void* pELF, const elfi32_symfilter* pFilter, int* pSyms, int maxSyms) {
+	return sym_filter_sub(pELF, pFilter, pSyms, maxSyms);
+}
+
+int elfi32_count_syms(void* pELF, const elfi32_symfilter* pFilter) {
+	return sym_filter_sub(pELF, pFilter, NULL, 0);
+}
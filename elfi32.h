@@ -1,35 +1,65 @@
 /* SPDX-License-Identifier: MIT */
 /* SPDX-FileCopyrightText: 2023 Sergey Chaban <sergey.chaban@gmail.com> */
 
+#ifndef ELFI32_H
+#define ELFI32_H
+
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 typedef int (*elfi32_symfn)(int isym, const char* pName, uint32_t addr, uint32_t size, uint32_t attr, void* pCtx);
+typedef void* (*elfi32_allocfn)(size_t size, void* pCtx);
+
+/* bit masks are indexed by STB_*, STT_* and STV_* values, ranges are inclusive */
+typedef struct _elfi32_symfilter {
+	uint32_t bindMask;
+	uint32_t typeMask;
+	uint32_t visMask;
+	uint32_t shndxMin;
+	uint32_t shndxMax;
+	uint32_t addrMin;
+	uint32_t addrMax;
+	uint32_t minSize;
+} elfi32_symfilter;
 
 int elfi32_is_le_sys();
 int elfi32_valid(void* pELF);
 void elfi32_set_swap(void* pELF);
 void* elfi32_load(const char* pPath, size_t* pSize);
+void* elfi32_load_stream(FILE* pFile, size_t* pSize);
+void* elfi32_load_alloc(const char* pPath, size_t* pSize, elfi32_allocfn fnAlloc, void* pAllocCtx);
 uint8_t elfi32_read_u8(void* pELF, uint32_t offs);
 uint16_t elfi32_read_u16(void* pELF, uint32_t offs);
 uint32_t elfi32_read_u32(void* pELF, uint32_t offs);
 uint32_t elfi32_entry_point(void* pELF);
 uint32_t elfi32_prog_header_offs(void* pELF);
+uint32_t elfi32_prog_header_entry_size(void* pELF);
+uint32_t elfi32_num_prog_header_entries(void* pELF);
 uint32_t elfi32_sect_header_offs(void* pELF);
 uint32_t elfi32_sect_header_entry_size(void* pELF);
 uint32_t elfi32_num_sect_header_entries(void* pELF);
 uint32_t elfi32_sect_names_entry_id(void* pELF);
 int elfi32_find_section(void* pELF, const char* pSectName);
 void elfi32_section_addrinfo(void* pELF, int isect, uint32_t* pAddr, uint32_t* pOffs, uint32_t* pSize);
+const char* elfi32_section_name(void* pELF, int isect);
+uint32_t elfi32_section_type(void* pELF, int isect);
+uint32_t elfi32_section_flags(void* pELF, int isect);
+void elfi32_segment_addrinfo(void* pELF, int iseg, uint32_t* pAddr, uint32_t* pOffs, uint32_t* pSize);
+uint32_t elfi32_segment_type(void* pELF, int iseg);
 void elfi32_foreach_sym(void* pELF, elfi32_symfn fn, void* pCtx);
 void elfi32_foreach_global_func(void* pELF, elfi32_symfn fn, void* pCtx);
 int elfi32_num_global_funcs(void* pELF);
+void elfi32_symfilter_init(elfi32_symfilter* pFilter);
+int elfi32_filter_syms(void* pELF, const elfi32_symfilter* pFilter, int* pSyms, int maxSyms);
+int elfi32_count_syms(void* pELF, const elfi32_symfilter* pFilter);
 
 #ifdef __cplusplus
 }
 #endif
 
+#endif
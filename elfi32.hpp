@@ -0,0 +1,445 @@
+/* SPDX-License-Identifier: MIT */
+
+/*
+ * Header-only C++17 views over elfi32 images and MBDisasm functions.
+ * Everything is read in place: iterators decode entries on dereference,
+ * names are std::string_view and lambdas passed to for_each() are
+ * inlined, so range-for loops have no indirect calls or allocations.
+ * Only SymbolTable allocates, once, for its name lengths.
+ */
+
+#ifndef ELFI32_HPP
+#define ELFI32_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "elfi32.h"
+#include "disasm_microblaze.h"
+
+namespace elfi32 {
+
+namespace detail {
+
+inline uint32_t bswap32(uint32_t val) {
+#if defined(__GNUC__)
+	return __builtin_bswap32(val);
+#else
+	return (val >> 24) | ((val >> 8) & 0xFF00) | ((val << 8) & 0xFF0000) | (val << 24);
+#endif
+}
+
+/* same byte order handling as elfi32_read_u32(): the swap flag lives in EI_DATA */
+inline uint32_t rd32(const uint8_t* pImg, uint32_t offs) {
+	uint32_t val;
+	std::memcpy(&val, pImg + offs, 4);
+	return (pImg[5] & 0x80) ? bswap32(val) : val;
+}
+
+inline uint16_t rd16(const uint8_t* pImg, uint32_t offs) {
+	uint16_t val;
+	std::memcpy(&val, pImg + offs, 2);
+	return (pImg[5] & 0x80) ? uint16_t((val >> 8) | (val << 8)) : val;
+}
+
+/* NUL-terminated string at pStr, never reaching past pEnd */
+inline std::string_view cstr(const char* pStr, const char* pEnd) {
+	const void* pNul = std::memchr(pStr, 0, size_t(pEnd - pStr));
+	return std::string_view(pStr, pNul ? size_t((const char*)pNul - pStr) : size_t(pEnd - pStr));
+}
+
+/* random access iterator over an index range, Owner::at(i) builds the element */
+template <class Owner, class T>
+class IndexIter {
+public:
+	using iterator_category = std::random_access_iterator_tag;
+	using value_type = T;
+	using difference_type = std::ptrdiff_t;
+	using pointer = void;
+	using reference = T;
+
+	IndexIter() = default;
+	IndexIter(const Owner* pOwner, uint32_t idx) : mpOwner(pOwner), mIdx(idx) {}
+
+	T operator*() const { return mpOwner->at(mIdx); }
+	T operator[](difference_type n) const { return mpOwner->at(uint32_t(mIdx + n)); }
+	IndexIter& operator++() { ++mIdx; return *this; }
+	IndexIter operator++(int) { IndexIter it = *this; ++mIdx; return it; }
+	IndexIter& operator--() { --mIdx; return *this; }
+	IndexIter operator--(int) { IndexIter it = *this; --mIdx; return it; }
+	IndexIter& operator+=(difference_type n) { mIdx = uint32_t(mIdx + n); return *this; }
+	IndexIter& operator-=(difference_type n) { mIdx = uint32_t(mIdx - n); return *this; }
+	IndexIter operator+(difference_type n) const { return IndexIter(mpOwner, uint32_t(mIdx + n)); }
+	IndexIter operator-(difference_type n) const { return IndexIter(mpOwner, uint32_t(mIdx - n)); }
+	difference_type operator-(const IndexIter& it) const { return difference_type(mIdx) - difference_type(it.mIdx); }
+	bool operator==(const IndexIter& it) const { return mIdx == it.mIdx; }
+	bool operator!=(const IndexIter& it) const { return mIdx != it.mIdx; }
+	bool operator<(const IndexIter& it) const { return mIdx < it.mIdx; }
+	bool operator>(const IndexIter& it) const { return mIdx > it.mIdx; }
+	bool operator<=(const IndexIter& it) const { return mIdx <= it.mIdx; }
+	bool operator>=(const IndexIter& it) const { return mIdx >= it.mIdx; }
+
+private:
+	const Owner* mpOwner = nullptr;
+	uint32_t mIdx = 0;
+};
+
+} // namespace detail
+
+class Image;
+
+struct Section {
+	uint32_t index;
+	std::string_view name;
+	uint32_t type;
+	uint32_t flags;
+	uint32_t addr;
+	uint32_t offs;
+	uint32_t size;
+	uint32_t link;
+	const uint8_t* pData; /* nullptr for SHT_NOBITS */
+
+	bool alloc() const { return (flags & 0x2) != 0; }
+	bool exec() const { return (flags & 0x4) != 0; }
+	bool compressed() const { return (flags & 0x800) != 0; }
+};
+
+struct Symbol {
+	uint32_t index;
+	std::string_view name;
+	uint32_t value;
+	uint32_t size;
+	uint8_t info;
+	uint8_t other;
+	uint16_t shndx;
+
+	uint32_t bind() const { return info >> 4; }
+	uint32_t type() const { return info & 0xF; }
+	uint32_t visibility() const { return other & 3; }
+	bool is_func() const { return type() == 2; }
+	bool is_object() const { return type() == 1; }
+	bool is_global() const { return bind() == 1; }
+	/* what elfi32_foreach_global_func() visits */
+	bool is_global_func() const { return info == 0x12; }
+	/* the attr argument of elfi32_symfn */
+	uint32_t attr() const { return info | (uint32_t(other) << 8) | (uint32_t(shndx) << 16); }
+};
+
+class SectionTable {
+public:
+	using iterator = detail::IndexIter<SectionTable, Section>;
+
+	SectionTable() = default;
+	explicit SectionTable(const uint8_t* pImg) : mpImg(pImg) {
+		if (pImg && elfi32_valid(const_cast<uint8_t*>(pImg))) {
+			mHdrOffs = detail::rd32(pImg, 0x20);
+			mEntSize = detail::rd16(pImg, 0x2E);
+			mNum = mHdrOffs && mEntSize ? detail::rd16(pImg, 0x30) : 0;
+			uint32_t nid = detail::rd16(pImg, 0x32);
+			if (nid < mNum) {
+				uint32_t top = mHdrOffs + nid*mEntSize;
+				mpNames = (const char*)pImg + detail::rd32(pImg, top + 0x10);
+				mNamesSize = detail::rd32(pImg, top + 0x14);
+			}
+		}
+	}
+
+	uint32_t size() const { return mNum; }
+	bool empty() const { return mNum == 0; }
+	iterator begin() const { return iterator(this, 0); }
+	iterator end() const { return iterator(this, mNum); }
+	Section operator[](uint32_t i) const { return at(i); }
+
+	Section at(uint32_t i) const {
+		uint32_t top = mHdrOffs + i*mEntSize;
+		Section sect;
+		uint32_t nameOffs = detail::rd32(mpImg, top);
+		sect.index = i;
+		sect.name = mpNames && nameOffs < mNamesSize ? detail::cstr(mpNames + nameOffs, mpNames + mNamesSize) : std::string_view();
+		sect.type = detail::rd32(mpImg, top + 0x04);
+		sect.flags = detail::rd32(mpImg, top + 0x08);
+		sect.addr = detail::rd32(mpImg, top + 0x0C);
+		sect.offs = detail::rd32(mpImg, top + 0x10);
+		sect.size = detail::rd32(mpImg, top + 0x14);
+		sect.link = detail::rd32(mpImg, top + 0x18);
+		sect.pData = sect.type != 8 && sect.offs ? mpImg + sect.offs : nullptr;
+		return sect;
+	}
+
+	std::optional<Section> find(std::string_view name) const {
+		for (Section sect : *this) {
+			if (sect.name == name) {
+				return sect;
+			}
+		}
+		return std::nullopt;
+	}
+
+	template <class F>
+	void for_each(F&& fn) const {
+		for (uint32_t i = 0; i < mNum; ++i) {
+			fn(at(i));
+		}
+	}
+
+private:
+	const uint8_t* mpImg = nullptr;
+	uint32_t mHdrOffs = 0;
+	uint32_t mEntSize = 0;
+	uint32_t mNum = 0;
+	const char* mpNames = nullptr;
+	uint32_t mNamesSize = 0;
+};
+
+/*
+ * .symtab (or any SHT_SYMTAB/SHT_DYNSYM section) with the length of every
+ * name measured once up front.
+ */
+class SymbolTable {
+public:
+	using iterator = detail::IndexIter<SymbolTable, Symbol>;
+
+	SymbolTable() = default;
+	SymbolTable(const uint8_t* pImg, const Section& symtab, const Section& strtab) { init(pImg, symtab, strtab); }
+
+	uint32_t size() const { return mNum; }
+	bool empty() const { return mNum == 0; }
+	iterator begin() const { return iterator(this, 0); }
+	iterator end() const { return iterator(this, mNum); }
+	Symbol operator[](uint32_t i) const { return at(i); }
+
+	Symbol at(uint32_t i) const {
+		const uint8_t* pImg = mpImg;
+		uint32_t top = mSymOffs + i*0x10;
+		Symbol sym;
+		sym.index = i;
+		sym.name = mLens[i] ? std::string_view(mpStrs + detail::rd32(pImg, top), mLens[i]) : std::string_view();
+		sym.value = detail::rd32(pImg, top + 4);
+		sym.size = detail::rd32(pImg, top + 8);
+		sym.info = pImg[top + 12];
+		sym.other = pImg[top + 13];
+		sym.shndx = detail::rd16(pImg, top + 14);
+		return sym;
+	}
+
+	std::optional<Symbol> find(std::string_view name) const {
+		for (uint32_t i = 0; i < mNum; ++i) {
+			if (mLens[i] == name.size() && at(i).name == name) {
+				return at(i);
+			}
+		}
+		return std::nullopt;
+	}
+
+	template <class F>
+	void for_each(F&& fn) const {
+		for (uint32_t i = 0; i < mNum; ++i) {
+			fn(at(i));
+		}
+	}
+
+	template <class Pred>
+	uint32_t count_if(Pred&& pred) const {
+		uint32_t n = 0;
+		for (uint32_t i = 0; i < mNum; ++i) {
+			n += pred(at(i)) ? 1 : 0;
+		}
+		return n;
+	}
+
+private:
+	void init(const uint8_t* pImg, const Section& symtab, const Section& strtab) {
+		if (!symtab.pData || !strtab.pData || strtab.size == 0) {
+			return;
+		}
+		mpImg = pImg;
+		mSymOffs = symtab.offs;
+		mpStrs = (const char*)strtab.pData;
+		mNum = symtab.size / 0x10;
+		mLens.resize(mNum);
+		const char* pEnd = mpStrs + strtab.size;
+		for (uint32_t i = 0; i < mNum; ++i) {
+			uint32_t nameOffs = detail::rd32(pImg, mSymOffs + i*0x10);
+			mLens[i] = nameOffs < strtab.size ? uint32_t(detail::cstr(mpStrs + nameOffs, pEnd).size()) : 0;
+		}
+	}
+
+	const uint8_t* mpImg = nullptr;
+	uint32_t mSymOffs = 0;
+	const char* mpStrs = nullptr;
+	uint32_t mNum = 0;
+	std::vector<uint32_t> mLens;
+};
+
+/* a loaded ELF image, not owned */
+class Image {
+public:
+	Image() = default;
+	Image(void* pELF, size_t size) : mpImg((const uint8_t*)pELF), mSize(size) {}
+
+	bool valid() const { return mpImg && mSize > 0x34 && elfi32_valid(const_cast<uint8_t*>(mpImg)); }
+	const uint8_t* data() const { return mpImg; }
+	size_t size() const { return mSize; }
+	bool big_endian() const { return (mpImg[5] & 0x7F) == 2; }
+	uint32_t entry() const { return detail::rd32(mpImg, 0x18); }
+	uint32_t u32(uint32_t offs) const { return detail::rd32(mpImg, offs); }
+	uint16_t u16(uint32_t offs) const { return detail::rd16(mpImg, offs); }
+
+	SectionTable sections() const { return valid() ? SectionTable(mpImg) : SectionTable(); }
+	std::optional<Section> find_section(std::string_view name) const { return sections().find(name); }
+
+	SymbolTable symbols(std::string_view symtabName = ".symtab") const {
+		SectionTable sects = sections();
+		std::optional<Section> symtab = sects.find(symtabName);
+		if (symtab && symtab->link < sects.size()) {
+			return SymbolTable(mpImg, *symtab, sects[symtab->link]);
+		}
+		return SymbolTable();
+	}
+
+private:
+	const uint8_t* mpImg = nullptr;
+	size_t mSize = 0;
+};
+
+/* an instruction with what dismb_walk_func() would pass alongside it */
+struct Instr {
+	MBInstr ins;
+	int32_t imm; /* fused with a preceding imm prefix */
+	bool delay; /* in the delay slot of the previous instruction */
+
+	const char* op_name() const { return dismb_op_name(ins.op); }
+	uint32_t op_flags() const { return dismb_op_flags(ins.op); }
+};
+
+/* instructions of one MBDisasm function, decoded as the iterator advances */
+class Code {
+public:
+	class iterator {
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = Instr;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const Instr*;
+		using reference = const Instr&;
+
+		iterator() = default;
+		iterator(const Code* pCode, uint32_t idx) : mpCode(pCode), mIdx(idx) {
+			std::memset(&mPrev, 0, sizeof(mPrev));
+			if (mIdx < mpCode->mNum) {
+				load();
+			}
+		}
+
+		const Instr& operator*() const { return mCur; }
+		const Instr* operator->() const { return &mCur; }
+		iterator& operator++() {
+			mPrev = mCur.ins;
+			if (++mIdx < mpCode->mNum) {
+				load();
+			}
+			return *this;
+		}
+		iterator operator++(int) { iterator it = *this; ++*this; return it; }
+		bool operator==(const iterator& it) const { return mIdx == it.mIdx; }
+		bool operator!=(const iterator& it) const { return mIdx != it.mIdx; }
+
+	private:
+		void load() {
+			uint32_t addr = mpCode->mAddr + mIdx*4;
+			dismb_decode(addr, mpCode->word(addr), &mCur.ins);
+			mCur.imm = mCur.ins.imm;
+			if (mPrev.op == MBOP_IMM && ((mCur.ins.code >> 26) & 8)) {
+				mCur.imm = int32_t((uint32_t(mPrev.imm) << 16) | (mCur.ins.code & 0xFFFF));
+			}
+			mCur.delay = (dismb_op_flags(mPrev.op) & MBOPF_DELAY) != 0;
+		}
+
+		const Code* mpCode = nullptr;
+		uint32_t mIdx = 0;
+		MBInstr mPrev;
+		Instr mCur;
+	};
+
+	Code() = default;
+	Code(const MBDisasm& dis, uint32_t addr, uint32_t size) : mpDis(&dis), mAddr(addr) {
+		uint32_t rel = addr - dis.textAddr;
+		uint32_t textSize = dis.textSize & ~3u;
+		if (rel < textSize && (rel & 3) == 0) {
+			mNum = size / 4;
+			if (mNum > (textSize - rel) / 4) {
+				mNum = (textSize - rel) / 4;
+			}
+		}
+	}
+
+	uint32_t size() const { return mNum; }
+	bool empty() const { return mNum == 0; }
+	iterator begin() const { return iterator(this, 0); }
+	iterator end() const { return iterator(this, mNum); }
+
+	template <class F>
+	void for_each(F&& fn) const {
+		for (const Instr& instr : *this) {
+			fn(instr);
+		}
+	}
+
+	/* host-order word, from the compacted text or the image */
+	uint32_t word(uint32_t addr) const {
+		uint32_t rel = addr - mpDis->textAddr;
+		if (mpDis->pText) {
+			return mpDis->pText[rel >> 2];
+		}
+		return detail::rd32((const uint8_t*)mpDis->pELF, mpDis->textOffs + rel);
+	}
+
+private:
+	const MBDisasm* mpDis = nullptr;
+	uint32_t mAddr = 0;
+	uint32_t mNum = 0;
+};
+
+struct Function {
+	uint32_t index;
+	std::string_view name;
+	uint32_t addr;
+	uint32_t size;
+	Code code;
+};
+
+class FunctionTable {
+public:
+	using iterator = detail::IndexIter<FunctionTable, Function>;
+
+	FunctionTable() = default;
+	explicit FunctionTable(const MBDisasm& dis) : mpDis(&dis) {}
+
+	uint32_t size() const { return mpDis ? uint32_t(mpDis->numFuncs) : 0; }
+	bool empty() const { return size() == 0; }
+	iterator begin() const { return iterator(this, 0); }
+	iterator end() const { return iterator(this, size()); }
+	Function operator[](uint32_t i) const { return at(i); }
+
+	Function at(uint32_t i) const {
+		const MBFunc& func = mpDis->pFuncs[i];
+		return Function { i, std::string_view(func.pName), func.addr, func.size, Code(*mpDis, func.addr, func.size) };
+	}
+
+private:
+	const MBDisasm* mpDis = nullptr;
+};
+
+inline FunctionTable functions(const MBDisasm& dis) { return FunctionTable(dis); }
+inline Code code(const MBDisasm& dis, uint32_t ifunc) {
+	return (uint32_t)ifunc < (uint32_t)dis.numFuncs ? Code(dis, dis.pFuncs[ifunc].addr, dis.pFuncs[ifunc].size) : Code();
+}
+
+} // namespace elfi32
+
+#endif
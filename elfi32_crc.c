@@ -0,0 +1,368 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#	include <nmmintrin.h>
+#	include <wmmintrin.h>
+#	define CRC_HW_X64 1
+#endif
+
+#include "elfi32.h"
+#include "elfi32_crc.h"
+
+#define CRC32_POLY 0xEDB88320 /* reflected */
+#define CRC32C_POLY 0x82F63B78
+#define CRC_CHUNK_SIZE (1 << 18) /* bytes per job, chunk CRCs are combined afterwards */
+#define SHT_NOBITS 8
+
+static uint32_t s_tabCrc32[8][256];
+static uint32_t s_tabCrc32c[8][256];
+static int s_hwCrc32;
+static int s_hwCrc32c;
+static pthread_once_t s_tabOnce = PTHREAD_ONCE_INIT;
+
+static void tab_build(uint32_t tab[8][256], uint32_t poly) {
+	int i;
+	int k;
+	for (i = 0; i < 256; ++i) {
+		uint32_t crc = (uint32_t)i;
+		for (k = 0; k < 8; ++k) {
+			crc = (crc >> 1) ^ (poly & (0 - (crc & 1)));
+		}
+		tab[0][i] = crc;
+	}
+	for (k = 1; k < 8; ++k) {
+		for (i = 0; i < 256; ++i) {
+			tab[k][i] = (tab[k - 1][i] >> 8) ^ tab[0][tab[k - 1][i] & 0xFF];
+		}
+	}
+}
+
+static void tab_init(void) {
+	tab_build(s_tabCrc32, CRC32_POLY);
+	tab_build(s_tabCrc32c, CRC32C_POLY);
+#ifdef CRC_HW_X64
+	__builtin_cpu_init();
+	s_hwCrc32 = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+	s_hwCrc32c = __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+/* slicing-by-8: eight table lookups retire eight input bytes */
+static uint32_t crc_slice8(uint32_t tab[8][256], uint32_t crc, const uint8_t* p, size_t n) {
+	while (n > 0 && ((uintptr_t)p & 7)) {
+		crc = (crc >> 8) ^ tab[0][(crc ^ *p++) & 0xFF];
+		--n;
+	}
+	while (n >= 8) {
+		uint32_t a = crc ^ ((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+		uint32_t b = (uint32_t)p[4] | ((uint32_t)p[5] << 8) | ((uint32_t)p[6] << 16) | ((uint32_t)p[7] << 24);
+		crc = tab[7][a & 0xFF] ^ tab[6][(a >> 8) & 0xFF] ^ tab[5][(a >> 16) & 0xFF] ^ tab[4][a >> 24]
+			^ tab[3][b & 0xFF] ^ tab[2][(b >> 8) & 0xFF] ^ tab[1][(b >> 16) & 0xFF] ^ tab[0][b >> 24];
+		p += 8;
+		n -= 8;
+	}
+	while (n > 0) {
+		crc = (crc >> 8) ^ tab[0][(crc ^ *p++) & 0xFF];
+		--n;
+	}
+	return crc;
+}
+
+#ifdef CRC_HW_X64
+/*
+ * CRC32 by carry-less multiplication (Intel, "Fast CRC Computation for
+ * Generic Polynomials Using PCLMULQDQ"): four 128-bit lanes are folded
+ * across 64-byte blocks, then into one lane, then Barrett-reduced. Takes
+ * n >= 64 and consumes a multiple of 16 bytes, the caller does the rest.
+ */
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32_clmul(uint32_t crc, const uint8_t* p, size_t n) {
+	const __m128i k1k2 = _mm_set_epi64x(0x01C6E41596, 0x0154442BD4);
+	const __m128i k3k4 = _mm_set_epi64x(0x00CCAA009E, 0x01751997D0);
+	const __m128i k5 = _mm_set_epi64x(0, 0x0163CD6124);
+	const __m128i poly = _mm_set_epi64x(0x01F7011641, 0x01DB710641);
+	const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+	__m128i x1 = _mm_loadu_si128((const __m128i*)(p + 0x00));
+	__m128i x2 = _mm_loadu_si128((const __m128i*)(p + 0x10));
+	__m128i x3 = _mm_loadu_si128((const __m128i*)(p + 0x20));
+	__m128i x4 = _mm_loadu_si128((const __m128i*)(p + 0x30));
+	__m128i t;
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+	p += 64;
+	n -= 64;
+	while (n >= 64) {
+		__m128i t1 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+		__m128i t2 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+		__m128i t3 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+		__m128i t4 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, t1), _mm_loadu_si128((const __m128i*)(p + 0x00)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, t2), _mm_loadu_si128((const __m128i*)(p + 0x10)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, t3), _mm_loadu_si128((const __m128i*)(p + 0x20)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, t4), _mm_loadu_si128((const __m128i*)(p + 0x30)));
+		p += 64;
+		n -= 64;
+	}
+	t = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), t), x2);
+	t = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), t), x3);
+	t = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), t), x4);
+	while (n >= 16) {
+		t = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+		x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), t), _mm_loadu_si128((const __m128i*)p));
+		p += 16;
+		n -= 16;
+	}
+	/* 128 -> 64 bits */
+	t = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), t);
+	t = _mm_srli_si128(x1, 4);
+	x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k5, 0x00), t);
+	/* Barrett reduction to 32 bits */
+	t = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), poly, 0x10);
+	t = _mm_clmulepi64_si128(_mm_and_si128(t, mask32), poly, 0x00);
+	x1 = _mm_xor_si128(x1, t);
+	return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const uint8_t* p, size_t n) {
+	uint64_t crc64;
+	while (n > 0 && ((uintptr_t)p & 7)) {
+		crc = _mm_crc32_u8(crc, *p++);
+		--n;
+	}
+	crc64 = crc;
+	while (n >= 8) {
+		uint64_t w;
+		memcpy(&w, p, 8);
+		crc64 = _mm_crc32_u64(crc64, w);
+		p += 8;
+		n -= 8;
+	}
+	crc = (uint32_t)crc64;
+	while (n > 0) {
+		crc = _mm_crc32_u8(crc, *p++);
+		--n;
+	}
+	return crc;
+}
+#endif
+
+/* crc is the value returned for the preceding data, 0 to start */
+uint32_t elfi32_crc32(uint32_t crc, const void* pData, size_t size) {
+	const uint8_t* p = (const uint8_t*)pData;
+	pthread_once(&s_tabOnce, tab_init);
+	crc = ~crc;
+#ifdef CRC_HW_X64
+	if (s_hwCrc32 && size >= 64) {
+		crc = crc32_clmul(crc, p, size);
+		p += size & ~(size_t)15;
+		size &= 15;
+	}
+#endif
+	return ~crc_slice8(s_tabCrc32, crc, p, size);
+}
+
+uint32_t elfi32_crc32c(uint32_t crc, const void* pData, size_t size) {
+	pthread_once(&s_tabOnce, tab_init);
+#ifdef CRC_HW_X64
+	if (s_hwCrc32c) {
+		return ~crc32c_hw(~crc, (const uint8_t*)pData, size);
+	}
+#endif
+	return ~crc_slice8(s_tabCrc32c, ~crc, (const uint8_t*)pData, size);
+}
+
+/* a * b modulo the (reflected) polynomial */
+static uint32_t mult_modp(uint32_t a, uint32_t b, uint32_t poly) {
+	uint32_t m = (uint32_t)1 << 31;
+	uint32_t p = 0;
+	for (;;) {
+		if (a & m) {
+			p ^= b;
+			if ((a & (m - 1)) == 0) {
+				break;
+			}
+		}
+		m >>= 1;
+		b = (b >> 1) ^ (poly & (0 - (b & 1)));
+	}
+	return p;
+}
+
+/* x^(8 * n) modulo the polynomial, by squaring */
+static uint32_t x8n_modp(size_t n, uint32_t poly) {
+	uint32_t sq = (uint32_t)1 << 23; /* x^8 */
+	uint32_t p = (uint32_t)1 << 31; /* x^0 */
+	while (n) {
+		if (n & 1) {
+			p = mult_modp(sq, p, poly);
+		}
+		n >>= 1;
+		sq = mult_modp(sq, sq, poly);
+	}
+	return p;
+}
+
+/* CRC of A followed by B from the CRCs of A and B and the length of B */
+uint32_t elfi32_crc32_combine(uint32_t crc1, uint32_t crc2, size_t size2) {
+	return mult_modp(x8n_modp(size2, CRC32_POLY), crc1, CRC32_POLY) ^ crc2;
+}
+
+uint32_t elfi32_crc32c_combine(uint32_t crc1, uint32_t crc2, size_t size2) {
+	return mult_modp(x8n_modp(size2, CRC32C_POLY), crc1, CRC32C_POLY) ^ crc2;
+}
+
+typedef struct _CrcRange {
+	const uint8_t* pData;
+	size_t size;
+	int ijob; /* first chunk */
+} CrcRange;
+
+typedef struct _CrcJobCtx {
+	const CrcRange* pRanges;
+	int* pJobRange;
+	uint32_t* pCrcs; /* crc32, crc32c per chunk */
+} CrcJobCtx;
+
+static void crc_job(int ijob, int iwk, void* pMem) {
+	CrcJobCtx* pCtx = (CrcJobCtx*)pMem;
+	const CrcRange* pRange = &pCtx->pRanges[pCtx->pJobRange[ijob]];
+	size_t offs = (size_t)(ijob - pRange->ijob) * CRC_CHUNK_SIZE;
+	size_t n = pRange->size - offs;
+	(void)iwk;
+	if (n > CRC_CHUNK_SIZE) {
+		n = CRC_CHUNK_SIZE;
+	}
+	pCtx->pCrcs[ijob*2] = elfi32_crc32(0, pRange->pData + offs, n);
+	pCtx->pCrcs[ijob*2 + 1] = elfi32_crc32c(0, pRange->pData + offs, n);
+}
+
+/*
+ * All ranges are cut into CRC_CHUNK_SIZE jobs for a single pool pass, so
+ * one huge section and many small ones spread over the workers alike.
+ */
+static int sum_ranges(CrcRange* pRanges, int nranges, WkPool* pPool, elfi32_checksum* pSums) {
+	CrcJobCtx ctx;
+	int njobs = 0;
+	int i;
+	for (i = 0; i < nranges; ++i) {
+		pRanges[i].ijob = njobs;
+		njobs += (int)((pRanges[i].size + CRC_CHUNK_SIZE - 1) / CRC_CHUNK_SIZE);
+	}
+	ctx.pRanges = pRanges;
+	ctx.pJobRange = (int*)malloc((njobs + 1) * sizeof(int));
+	ctx.pCrcs = (uint32_t*)malloc((njobs + 1) * 2 * sizeof(uint32_t));
+	if (!ctx.pJobRange || !ctx.pCrcs) {
+		free(ctx.pJobRange);
+		free(ctx.pCrcs);
+		return 0;
+	}
+	for (i = 0; i < nranges; ++i) {
+		int ijob;
+		int end = i + 1 < nranges ? pRanges[i + 1].ijob : njobs;
+		for (ijob = pRanges[i].ijob; ijob < end; ++ijob) {
+			ctx.pJobRange[ijob] = i;
+		}
+	}
+	pthread_once(&s_tabOnce, tab_init);
+	wkpool_for(njobs > 1 ? pPool : NULL, njobs, crc_job, &ctx);
+	for (i = 0; i < nranges; ++i) {
+		elfi32_checksum* pSum = &pSums[i];
+		int end = i + 1 < nranges ? pRanges[i + 1].ijob : njobs;
+		int ijob;
+		size_t offs = 0;
+		pSum->size = (uint32_t)pRanges[i].size;
+		pSum->crc32 = 0;
+		pSum->crc32c = 0;
+		for (ijob = pRanges[i].ijob; ijob < end; ++ijob) {
+			size_t n = pRanges[i].size - offs;
+			if (n > CRC_CHUNK_SIZE) {
+				n = CRC_CHUNK_SIZE;
+			}
+			pSum->crc32 = elfi32_crc32_combine(pSum->crc32, ctx.pCrcs[ijob*2], n);
+			pSum->crc32c = elfi32_crc32c_combine(pSum->crc32c, ctx.pCrcs[ijob*2 + 1], n);
+			offs += n;
+		}
+	}
+	free(ctx.pJobRange);
+	free(ctx.pCrcs);
+	return 1;
+}
+
+void elfi32_checksum_data(const void* pData, size_t size, WkPool* pPool, elfi32_checksum* pSum) {
+	if (pSum) {
+		CrcRange range;
+		range.pData = (const uint8_t*)pData;
+		range.size = pData ? size : 0;
+		if (!sum_ranges(&range, 1, pPool, pSum)) {
+			/* out of memory for the job table, do it in one go */
+			pSum->size = (uint32_t)range.size;
+			pSum->crc32 = elfi32_crc32(0, range.pData, range.size);
+			pSum->crc32c = elfi32_crc32c(0, range.pData, range.size);
+		}
+	}
+}
+
+/* file contents of the section, SHT_NOBITS sections are empty */
+static void section_range(void* pELF, int isect, CrcRange* pRange) {
+	uint32_t offs = 0;
+	uint32_t size = 0;
+	elfi32_section_addrinfo(pELF, isect, NULL, &offs, &size);
+	if (elfi32_section_type(pELF, isect) == SHT_NOBITS || offs == 0) {
+		size = 0;
+	}
+	pRange->pData = (const uint8_t*)pELF + offs;
+	pRange->size = size;
+}
+
+int elfi32_section_checksum(void* pELF, int isect, WkPool* pPool, elfi32_checksum* pSum) {
+	int res = 0;
+	if (pSum && elfi32_valid(pELF) && (uint32_t)isect < elfi32_num_sect_header_entries(pELF)) {
+		CrcRange range;
+		section_range(pELF, isect, &range);
+		elfi32_checksum_data(range.pData, range.size, pPool, pSum);
+		res = 1;
+	}
+	return res;
+}
+
+/* pSums has one entry per section header */
+int elfi32_sections_checksums(void* pELF, WkPool* pPool, elfi32_checksum* pSums) {
+	int res = 0;
+	int nsects = (int)elfi32_num_sect_header_entries(pELF);
+	if (pSums && nsects > 0) {
+		CrcRange* pRanges = (CrcRange*)malloc(nsects * sizeof(CrcRange));
+		if (pRanges) {
+			int i;
+			for (i = 0; i < nsects; ++i) {
+				section_range(pELF, i, &pRanges[i]);
+			}
+			res = sum_ranges(pRanges, nsects, pPool, pSums);
+			free(pRanges);
+		}
+	}
+	return res;
+}
+
+int elfi32_segment_checksum(void* pELF, int iseg, WkPool* pPool, elfi32_checksum* pSum) {
+	int res = 0;
+	if (pSum && (uint32_t)iseg < elfi32_num_prog_header_entries(pELF)) {
+		uint32_t offs = 0;
+		uint32_t size = 0;
+		elfi32_segment_addrinfo(pELF, iseg, NULL, &offs, &size);
+		elfi32_checksum_data((const uint8_t*)pELF + offs, size, pPool, pSum);
+		res = 1;
+	}
+	return res;
+}
@@ -0,0 +1,37 @@
+/* SPDX-License-Identifier: MIT */
+
+#ifndef ELFI32_CRC_H
+#define ELFI32_CRC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wkpool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the pair of CRCs doubles as a 64-bit content fingerprint */
+typedef struct _elfi32_checksum {
+	uint32_t size;
+	uint32_t crc32; /* IEEE 802.3, same as zlib crc32() */
+	uint32_t crc32c; /* Castagnoli */
+} elfi32_checksum;
+
+#define ELFI32_FINGERPRINT(sum) (((uint64_t)(sum).crc32c << 32) | (sum).crc32)
+
+uint32_t elfi32_crc32(uint32_t crc, const void* pData, size_t size);
+uint32_t elfi32_crc32c(uint32_t crc, const void* pData, size_t size);
+uint32_t elfi32_crc32_combine(uint32_t crc1, uint32_t crc2, size_t size2);
+uint32_t elfi32_crc32c_combine(uint32_t crc1, uint32_t crc2, size_t size2);
+void elfi32_checksum_data(const void* pData, size_t size, WkPool* pPool, elfi32_checksum* pSum);
+int elfi32_section_checksum(void* pELF, int isect, WkPool* pPool, elfi32_checksum* pSum);
+int elfi32_sections_checksums(void* pELF, WkPool* pPool, elfi32_checksum* pSums);
+int elfi32_segment_checksum(void* pELF, int iseg, WkPool* pPool, elfi32_checksum* pSum);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
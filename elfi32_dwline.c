@@ -0,0 +1,759 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "elfi32.h"
+#include "elfi32_dwline.h"
+#include "elfi32_sectcache.h"
+
+#define DW_LNS_copy 1
+#define DW_LNS_advance_pc 2
+#define DW_LNS_advance_line 3
+#define DW_LNS_set_file 4
+#define DW_LNS_const_add_pc 8
+#define DW_LNS_fixed_advance_pc 9
+
+#define DW_LNE_end_sequence 1
+#define DW_LNE_set_address 2
+#define DW_LNE_define_file 3
+
+#define DW_LNCT_path 1
+#define DW_LNCT_directory_index 2
+
+#define DW_FORM_block2 0x03
+#define DW_FORM_block4 0x04
+#define DW_FORM_data2 0x05
+#define DW_FORM_data4 0x06
+#define DW_FORM_data8 0x07
+#define DW_FORM_string 0x08
+#define DW_FORM_block 0x09
+#define DW_FORM_block1 0x0A
+#define DW_FORM_data1 0x0B
+#define DW_FORM_strp 0x0E
+#define DW_FORM_udata 0x0F
+#define DW_FORM_strx 0x1A
+#define DW_FORM_data16 0x1E
+#define DW_FORM_line_strp 0x1F
+#define DW_FORM_strx1 0x25
+#define DW_FORM_strx2 0x26
+#define DW_FORM_strx3 0x27
+#define DW_FORM_strx4 0x28
+
+#define NO_FILE 0xFFFFFFFF
+
+typedef struct _DwReader {
+	const uint8_t* p;
+	const uint8_t* pEnd;
+	int be;
+	int err;
+} DwReader;
+
+static int rd_avail(DwReader* pRd, size_t n) {
+	if (pRd->err || (size_t)(pRd->pEnd - pRd->p) < n) {
+		pRd->err = 1;
+		pRd->p = pRd->pEnd;
+		return 0;
+	}
+	return 1;
+}
+
+static uint64_t rd_uint(DwReader* pRd, int n) {
+	uint64_t val = 0;
+	int i;
+	if (!rd_avail(pRd, (size_t)n)) {
+		return 0;
+	}
+	for (i = 0; i < n; ++i) {
+		val |= (uint64_t)pRd->p[pRd->be ? n - 1 - i : i] << (i*8);
+	}
+	pRd->p += n;
+	return val;
+}
+
+static uint8_t rd_u8(DwReader* pRd) {
+	return (uint8_t)rd_uint(pRd, 1);
+}
+
+static uint64_t rd_uleb(DwReader* pRd) {
+	uint64_t val = 0;
+	int shift = 0;
+	while (rd_avail(pRd, 1)) {
+		uint8_t b = *pRd->p++;
+		if (shift < 64) {
+			val |= (uint64_t)(b & 0x7F) << shift;
+		}
+		shift += 7;
+		if (!(b & 0x80)) {
+			break;
+		}
+	}
+	return val;
+}
+
+static int64_t rd_sleb(DwReader* pRd) {
+	int64_t val = 0;
+	int shift = 0;
+	uint8_t b = 0;
+	while (rd_avail(pRd, 1)) {
+		b = *pRd->p++;
+		if (shift < 64) {
+			val |= (int64_t)(b & 0x7F) << shift;
+		}
+		shift += 7;
+		if (!(b & 0x80)) {
+			break;
+		}
+	}
+	if (shift < 64 && (b & 0x40)) {
+		val |= -((int64_t)1 << shift);
+	}
+	return val;
+}
+
+static const char* rd_str(DwReader* pRd) {
+	const char* pStr = (const char*)pRd->p;
+	const uint8_t* pNul = pRd->err ? NULL : (const uint8_t*)memchr(pRd->p, 0, (size_t)(pRd->pEnd - pRd->p));
+	if (!pNul) {
+		pRd->err = 1;
+		pRd->p = pRd->pEnd;
+		return "";
+	}
+	pRd->p = pNul + 1;
+	return pStr;
+}
+
+static void rd_skip(DwReader* pRd, uint64_t n) {
+	if (rd_avail(pRd, (size_t)n)) {
+		pRd->p += n;
+	}
+}
+
+static const char* str_at(const uint8_t* pStrs, size_t size, uint64_t offs) {
+	if (pStrs && offs < size && memchr(pStrs + offs, 0, size - (size_t)offs)) {
+		return (const char*)pStrs + offs;
+	}
+	return "";
+}
+
+typedef struct _LineRow {
+	uint32_t addr;
+	uint32_t line; /* 0: end of sequence */
+	uint32_t file;
+	uint32_t ord;
+} LineRow;
+
+typedef struct _FileEnt {
+	const char* pDir;
+	const char* pName;
+	uint32_t hash;
+} FileEnt;
+
+typedef struct _LineBuilder {
+	LineRow* pRows;
+	uint32_t numRows;
+	uint32_t maxRows;
+	FileEnt* pFiles;
+	uint32_t numFiles;
+	uint32_t maxFiles;
+	uint32_t* pHashTbl; /* file index + 1, 0 = empty */
+	uint32_t hashSize;
+	/* per unit */
+	const char** ppDirs;
+	uint32_t numDirs;
+	uint32_t maxDirs;
+	uint32_t* pUnitFiles;
+	uint32_t numUnitFiles;
+	uint32_t maxUnitFiles;
+	int err;
+} LineBuilder;
+
+static void* grow(void* pMem, uint32_t* pMax, uint32_t need, size_t elemSize, int* pErr) {
+	if (need > *pMax) {
+		uint32_t max = *pMax ? *pMax : 64;
+		void* pNew;
+		while (max < need) {
+			max *= 2;
+		}
+		pNew = realloc(pMem, max * elemSize);
+		if (!pNew) {
+			*pErr = 1;
+			return pMem;
+		}
+		*pMax = max;
+		return pNew;
+	}
+	return pMem;
+}
+
+static uint32_t str_hash(uint32_t h, const char* pStr) {
+	while (*pStr) {
+		h = (h ^ (uint8_t)*pStr++) * 0x01000193;
+	}
+	return h;
+}
+
+static int rehash_files(LineBuilder* pBld, uint32_t size) {
+	uint32_t* pTbl = (uint32_t*)calloc(size, sizeof(uint32_t));
+	uint32_t i;
+	if (!pTbl) {
+		return 0;
+	}
+	for (i = 0; i < pBld->numFiles; ++i) {
+		uint32_t slot = pBld->pFiles[i].hash & (size - 1);
+		while (pTbl[slot]) {
+			slot = (slot + 1) & (size - 1);
+		}
+		pTbl[slot] = i + 1;
+	}
+	free(pBld->pHashTbl);
+	pBld->pHashTbl = pTbl;
+	pBld->hashSize = size;
+	return 1;
+}
+
+/* global index of (dir, name), shared by every unit that names it */
+static uint32_t intern_file(LineBuilder* pBld, const char* pDir, const char* pName) {
+	uint32_t hash = str_hash(str_hash(0x811C9DC5, pDir) * 31, pName);
+	uint32_t slot;
+	if ((pBld->numFiles + 1) * 2 > pBld->hashSize) {
+		if (!rehash_files(pBld, pBld->hashSize ? pBld->hashSize * 2 : 256)) {
+			pBld->err = 1;
+			return NO_FILE;
+		}
+	}
+	slot = hash & (pBld->hashSize - 1);
+	while (pBld->pHashTbl[slot]) {
+		const FileEnt* pEnt = &pBld->pFiles[pBld->pHashTbl[slot] - 1];
+		if (pEnt->hash == hash && strcmp(pEnt->pName, pName) == 0 && strcmp(pEnt->pDir, pDir) == 0) {
+			return pBld->pHashTbl[slot] - 1;
+		}
+		slot = (slot + 1) & (pBld->hashSize - 1);
+	}
+	pBld->pFiles = (FileEnt*)grow(pBld->pFiles, &pBld->maxFiles, pBld->numFiles + 1, sizeof(FileEnt), &pBld->err);
+	if (pBld->err) {
+		return NO_FILE;
+	}
+	pBld->pFiles[pBld->numFiles].pDir = pDir;
+	pBld->pFiles[pBld->numFiles].pName = pName;
+	pBld->pFiles[pBld->numFiles].hash = hash;
+	pBld->pHashTbl[slot] = ++pBld->numFiles;
+	return pBld->numFiles - 1;
+}
+
+static void add_dir(LineBuilder* pBld, const char* pDir) {
+	pBld->ppDirs = (const char**)grow((void*)pBld->ppDirs, &pBld->maxDirs, pBld->numDirs + 1, sizeof(const char*), &pBld->err);
+	if (!pBld->err) {
+		pBld->ppDirs[pBld->numDirs++] = pDir;
+	}
+}
+
+static void add_unit_file(LineBuilder* pBld, uint64_t idir, const char* pName) {
+	uint32_t ifile = NO_FILE;
+	if (pName) {
+		ifile = intern_file(pBld, idir < pBld->numDirs ? pBld->ppDirs[idir] : "", pName);
+	}
+	pBld->pUnitFiles = (uint32_t*)grow(pBld->pUnitFiles, &pBld->maxUnitFiles, pBld->numUnitFiles + 1, sizeof(uint32_t), &pBld->err);
+	if (!pBld->err) {
+		pBld->pUnitFiles[pBld->numUnitFiles++] = ifile;
+	}
+}
+
+static void add_row(LineBuilder* pBld, uint32_t addr, uint32_t line, uint64_t file) {
+	pBld->pRows = (LineRow*)grow(pBld->pRows, &pBld->maxRows, pBld->numRows + 1, sizeof(LineRow), &pBld->err);
+	if (!pBld->err) {
+		LineRow* pRow = &pBld->pRows[pBld->numRows];
+		pRow->addr = addr;
+		pRow->line = line;
+		pRow->file = file < pBld->numUnitFiles ? pBld->pUnitFiles[file] : NO_FILE;
+		pRow->ord = pBld->numRows++;
+	}
+}
+
+typedef struct _DwStrs {
+	const uint8_t* pLineStr;
+	size_t lineStrSize;
+	const uint8_t* pStr;
+	size_t strSize;
+} DwStrs;
+
+/* DWARF 5 directory/file entry lists: (content type, form) pairs, then entries */
+static int read_v5_entries(DwReader* pRd, LineBuilder* pBld, const DwStrs* pStrs, int offsSize, int dirs) {
+	uint64_t fmt[32][2];
+	uint32_t nfmt = rd_u8(pRd);
+	uint64_t nent;
+	uint64_t i;
+	uint32_t j;
+	if (nfmt > 32) {
+		return 0;
+	}
+	for (j = 0; j < nfmt; ++j) {
+		fmt[j][0] = rd_uleb(pRd);
+		fmt[j][1] = rd_uleb(pRd);
+	}
+	nent = rd_uleb(pRd);
+	for (i = 0; i < nent && !pRd->err; ++i) {
+		const char* pPath = NULL;
+		uint64_t idir = 0;
+		for (j = 0; j < nfmt; ++j) {
+			const char* pStr = NULL;
+			uint64_t val = 0;
+			switch (fmt[j][1]) {
+				case DW_FORM_string: pStr = rd_str(pRd); break;
+				case DW_FORM_line_strp: pStr = str_at(pStrs->pLineStr, pStrs->lineStrSize, rd_uint(pRd, offsSize)); break;
+				case DW_FORM_strp: pStr = str_at(pStrs->pStr, pStrs->strSize, rd_uint(pRd, offsSize)); break;
+				/* string offsets tables live in .debug_info's domain, names stay empty */
+				case DW_FORM_strx: rd_uleb(pRd); pStr = ""; break;
+				case DW_FORM_strx1: rd_skip(pRd, 1); pStr = ""; break;
+				case DW_FORM_strx2: rd_skip(pRd, 2); pStr = ""; break;
+				case DW_FORM_strx3: rd_skip(pRd, 3); pStr = ""; break;
+				case DW_FORM_strx4: rd_skip(pRd, 4); pStr = ""; break;
+				case DW_FORM_data1: val = rd_uint(pRd, 1); break;
+				case DW_FORM_data2: val = rd_uint(pRd, 2); break;
+				case DW_FORM_data4: val = rd_uint(pRd, 4); break;
+				case DW_FORM_data8: val = rd_uint(pRd, 8); break;
+				case DW_FORM_udata: val = rd_uleb(pRd); break;
+				case DW_FORM_data16: rd_skip(pRd, 16); break;
+				case DW_FORM_block: rd_skip(pRd, rd_uleb(pRd)); break;
+				case DW_FORM_block1: rd_skip(pRd, rd_uint(pRd, 1)); break;
+				case DW_FORM_block2: rd_skip(pRd, rd_uint(pRd, 2)); break;
+				case DW_FORM_block4: rd_skip(pRd, rd_uint(pRd, 4)); break;
+				default: return 0;
+			}
+			if (fmt[j][0] == DW_LNCT_path) {
+				pPath = pStr ? pStr : "";
+			} else if (fmt[j][0] == DW_LNCT_directory_index) {
+				idir = val;
+			}
+		}
+		if (dirs) {
+			add_dir(pBld, pPath ? pPath : "");
+		} else {
+			add_unit_file(pBld, idir, pPath ? pPath : "");
+		}
+	}
+	return !pRd->err;
+}
+
+/* one unit: header, file table and the line-number state machine */
+static void decode_unit(DwReader* pRd, LineBuilder* pBld, const DwStrs* pStrs) {
+	const uint8_t* pUnitEnd;
+	const uint8_t* pProg;
+	uint8_t stdLens[256];
+	uint64_t unitLen;
+	uint64_t hdrLen;
+	int offsSize = 4;
+	uint32_t version;
+	uint32_t minInstLen;
+	int32_t lineBase;
+	uint32_t lineRange;
+	uint32_t opBase;
+	uint32_t i;
+	uint32_t addr = 0;
+	int64_t line = 1;
+	uint64_t file = 1;
+	unitLen = rd_uint(pRd, 4);
+	if (unitLen == 0xFFFFFFFF) {
+		unitLen = rd_uint(pRd, 8);
+		offsSize = 8;
+	}
+	if (pRd->err || unitLen > (uint64_t)(pRd->pEnd - pRd->p)) {
+		pRd->err = 1;
+		return;
+	}
+	pUnitEnd = pRd->p + unitLen;
+	version = (uint32_t)rd_uint(pRd, 2);
+	if (version < 2 || version > 5) {
+		pRd->p = pUnitEnd;
+		return;
+	}
+	if (version >= 5) {
+		rd_u8(pRd); /* address_size */
+		rd_u8(pRd); /* segment_selector_size */
+	}
+	hdrLen = rd_uint(pRd, offsSize);
+	if (pRd->err || hdrLen > (uint64_t)(pUnitEnd - pRd->p)) {
+		pRd->p = pUnitEnd;
+		return;
+	}
+	pProg = pRd->p + hdrLen;
+	minInstLen = rd_u8(pRd);
+	if (version >= 4) {
+		rd_u8(pRd); /* maximum_operations_per_instruction */
+	}
+	rd_u8(pRd); /* default_is_stmt */
+	lineBase = (int8_t)rd_u8(pRd);
+	lineRange = rd_u8(pRd);
+	opBase = rd_u8(pRd);
+	memset(stdLens, 0, sizeof(stdLens));
+	for (i = 1; i < opBase; ++i) {
+		stdLens[i] = rd_u8(pRd);
+	}
+	pBld->numDirs = 0;
+	pBld->numUnitFiles = 0;
+	if (version >= 5) {
+		if (!read_v5_entries(pRd, pBld, pStrs, offsSize, 1) || !read_v5_entries(pRd, pBld, pStrs, offsSize, 0)) {
+			pRd->err = 0;
+			pRd->p = pUnitEnd;
+			return;
+		}
+		file = 1;
+	} else {
+		/* directory 0 is the compilation directory, which only .debug_info knows */
+		add_dir(pBld, "");
+		while (rd_avail(pRd, 1) && *pRd->p) {
+			add_dir(pBld, rd_str(pRd));
+		}
+		rd_u8(pRd);
+		/* file numbers start at 1 */
+		add_unit_file(pBld, 0, NULL);
+		while (rd_avail(pRd, 1) && *pRd->p) {
+			const char* pName = rd_str(pRd);
+			uint64_t idir = rd_uleb(pRd);
+			rd_uleb(pRd); /* mtime */
+			rd_uleb(pRd); /* length */
+			add_unit_file(pBld, idir, pName);
+		}
+	}
+	if (pRd->err || lineRange == 0 || pBld->err) {
+		pRd->err = 0;
+		pRd->p = pUnitEnd;
+		return;
+	}
+	pRd->p = pProg;
+	pRd->pEnd = pUnitEnd;
+	while (pRd->p < pUnitEnd && !pRd->err && !pBld->err) {
+		uint32_t op = rd_u8(pRd);
+		if (op >= opBase) {
+			uint32_t adj = op - opBase;
+			addr += (adj / lineRange) * minInstLen;
+			line += lineBase + (int32_t)(adj % lineRange);
+			add_row(pBld, addr, (uint32_t)line, file);
+		} else if (op == 0) {
+			uint64_t len = rd_uleb(pRd);
+			const uint8_t* pNext = pRd->p + len;
+			uint32_t sub;
+			if (len == 0 || len > (uint64_t)(pUnitEnd - pRd->p)) {
+				break;
+			}
+			sub = rd_u8(pRd);
+			if (sub == DW_LNE_end_sequence) {
+				add_row(pBld, addr, 0, file);
+				addr = 0;
+				line = 1;
+				file = 1;
+			} else if (sub == DW_LNE_set_address) {
+				addr = (uint32_t)rd_uint(pRd, len - 1 > 8 ? 8 : (int)(len - 1));
+			} else if (sub == DW_LNE_define_file) {
+				const char* pName = rd_str(pRd);
+				add_unit_file(pBld, rd_uleb(pRd), pName);
+			}
+			pRd->p = pNext;
+		} else {
+			switch (op) {
+				case DW_LNS_copy:
+					add_row(pBld, addr, (uint32_t)line, file);
+					break;
+				case DW_LNS_advance_pc:
+					addr += (uint32_t)rd_uleb(pRd) * minInstLen;
+					break;
+				case DW_LNS_advance_line:
+					line += rd_sleb(pRd);
+					break;
+				case DW_LNS_set_file:
+					file = rd_uleb(pRd);
+					break;
+				case DW_LNS_const_add_pc:
+					addr += ((255 - opBase) / lineRange) * minInstLen;
+					break;
+				case DW_LNS_fixed_advance_pc:
+					addr += (uint32_t)rd_uint(pRd, 2);
+					break;
+				default:
+					/* column, stmt/block flags, isa and unknown opcodes */
+					for (i = 0; i < stdLens[op]; ++i) {
+						rd_uleb(pRd);
+					}
+					break;
+			}
+		}
+	}
+	pRd->err = 0;
+	pRd->p = pUnitEnd;
+}
+
+static int cmp_row(const void* pA, const void* pB) {
+	const LineRow* pRowA = (const LineRow*)pA;
+	const LineRow* pRowB = (const LineRow*)pB;
+	if (pRowA->addr != pRowB->addr) {
+		return pRowA->addr < pRowB->addr ? -1 : 1;
+	}
+	/* a sequence ending where another starts goes first */
+	if ((pRowA->line == 0) != (pRowB->line == 0)) {
+		return pRowA->line == 0 ? -1 : 1;
+	}
+	return pRowA->ord < pRowB->ord ? -1 : pRowA->ord > pRowB->ord ? 1 : 0;
+}
+
+/* sorted, with later rows at the same address and repeated lines folded */
+static uint32_t fold_rows(LineRow* pRows, uint32_t n) {
+	uint32_t nout = 0;
+	uint32_t i;
+	qsort(pRows, n, sizeof(LineRow), cmp_row);
+	for (i = 0; i < n; ++i) {
+		LineRow* pRow = &pRows[i];
+		if (nout > 0) {
+			LineRow* pLast = &pRows[nout - 1];
+			if (pLast->addr == pRow->addr) {
+				*pLast = *pRow;
+				continue;
+			}
+			if (pRow->line != 0 && pLast->line == pRow->line && pLast->file == pRow->file) {
+				continue;
+			}
+			if (pRow->line == 0 && pLast->line == 0) {
+				continue;
+			}
+		} else if (pRow->line == 0) {
+			continue;
+		}
+		pRows[nout++] = *pRow;
+	}
+	return nout;
+}
+
+static size_t put_uleb(uint8_t* pDst, uint32_t val) {
+	size_t n = 0;
+	do {
+		uint8_t b = val & 0x7F;
+		val >>= 7;
+		pDst[n++] = b | (val ? 0x80 : 0);
+	} while (val);
+	return n;
+}
+
+/*
+ * Per row after a block's anchor: uleb(addr delta), then
+ * uleb(zigzag(line delta) << 1 | file changed), then uleb(file) if changed.
+ */
+static int encode_rows(elfi32_lines* pLines, const LineRow* pRows, uint32_t n) {
+	uint32_t nblks = (n + ELFI32_LINE_BLK - 1) / ELFI32_LINE_BLK;
+	size_t offs = 0;
+	uint32_t i;
+	pLines->pBlks = (elfi32_lineblk*)malloc((nblks ? nblks : 1) * sizeof(elfi32_lineblk));
+	/* worst case is 5 + 6 + 5 bytes per row */
+	pLines->pDeltas = (uint8_t*)malloc(n * 16 + 1);
+	if (!pLines->pBlks || !pLines->pDeltas) {
+		return 0;
+	}
+	for (i = 0; i < n; ++i) {
+		const LineRow* pRow = &pRows[i];
+		if (i % ELFI32_LINE_BLK == 0) {
+			elfi32_lineblk* pBlk = &pLines->pBlks[i / ELFI32_LINE_BLK];
+			pBlk->addr = pRow->addr;
+			pBlk->line = pRow->line;
+			pBlk->file = pRow->file;
+			pBlk->offs = (uint32_t)offs;
+		} else {
+			const LineRow* pPrev = &pRows[i - 1];
+			int32_t lineDelta = (int32_t)(pRow->line - pPrev->line);
+			uint32_t zz = ((uint32_t)lineDelta << 1) ^ (uint32_t)(lineDelta >> 31);
+			int fileChanged = pRow->file != pPrev->file;
+			offs += put_uleb(pLines->pDeltas + offs, pRow->addr - pPrev->addr);
+			offs += put_uleb(pLines->pDeltas + offs, (zz << 1) | (uint32_t)fileChanged);
+			if (fileChanged) {
+				offs += put_uleb(pLines->pDeltas + offs, pRow->file);
+			}
+		}
+	}
+	pLines->numRows = (int)n;
+	pLines->numBlks = (int)nblks;
+	pLines->deltasSize = offs;
+	if (offs > 0) {
+		uint8_t* pDeltas = (uint8_t*)realloc(pLines->pDeltas, offs);
+		if (pDeltas) {
+			pLines->pDeltas = pDeltas;
+		}
+	}
+	return 1;
+}
+
+/* file names are copied, so the table outlives the image */
+static int copy_files(elfi32_lines* pLines, const LineBuilder* pBld) {
+	size_t poolSize = 0;
+	char* pPool;
+	uint32_t i;
+	for (i = 0; i < pBld->numFiles; ++i) {
+		poolSize += strlen(pBld->pFiles[i].pDir) + strlen(pBld->pFiles[i].pName) + 2;
+	}
+	pLines->pFiles = (elfi32_linefile*)malloc((pBld->numFiles ? pBld->numFiles : 1) * sizeof(elfi32_linefile));
+	pLines->pStrs = (char*)malloc(poolSize ? poolSize : 1);
+	if (!pLines->pFiles || !pLines->pStrs) {
+		return 0;
+	}
+	pPool = pLines->pStrs;
+	for (i = 0; i < pBld->numFiles; ++i) {
+		size_t dirLen = strlen(pBld->pFiles[i].pDir) + 1;
+		size_t nameLen = strlen(pBld->pFiles[i].pName) + 1;
+		memcpy(pPool, pBld->pFiles[i].pDir, dirLen);
+		pLines->pFiles[i].pDir = pPool;
+		pPool += dirLen;
+		memcpy(pPool, pBld->pFiles[i].pName, nameLen);
+		pLines->pFiles[i].pName = pPool;
+		pPool += nameLen;
+	}
+	pLines->numFiles = (int)pBld->numFiles;
+	return 1;
+}
+
+/* raw section contents, e.g. already decompressed ones; be selects byte order */
+int elfi32_lines_decode(const uint8_t* pLine, size_t lineSize, const uint8_t* pLineStr, size_t lineStrSize, const uint8_t* pStr, size_t strSize, int be, elfi32_lines* pLines) {
+	int res = 0;
+	if (pLines) {
+		memset(pLines, 0, sizeof(elfi32_lines));
+	}
+	if (pLines && pLine && lineSize > 0) {
+		LineBuilder bld;
+		DwStrs strs;
+		DwReader rd;
+		memset(&bld, 0, sizeof(bld));
+		strs.pLineStr = pLineStr;
+		strs.lineStrSize = lineStrSize;
+		strs.pStr = pStr;
+		strs.strSize = strSize;
+		rd.p = pLine;
+		rd.be = be;
+		rd.err = 0;
+		while (!bld.err) {
+			rd.pEnd = pLine + lineSize;
+			if (rd.p >= rd.pEnd || rd.err) {
+				break;
+			}
+			decode_unit(&rd, &bld, &strs);
+		}
+		if (!bld.err) {
+			uint32_t n = fold_rows(bld.pRows, bld.numRows);
+			res = encode_rows(pLines, bld.pRows, n) && copy_files(pLines, &bld);
+		}
+		free(bld.pRows);
+		free(bld.pFiles);
+		free(bld.pHashTbl);
+		free((void*)bld.ppDirs);
+		free(bld.pUnitFiles);
+		if (!res) {
+			elfi32_lines_free(pLines);
+		}
+	}
+	return res;
+}
+
+/* compressed debug sections are inflated for the duration of the decode */
+int elfi32_lines_build(void* pELF, elfi32_lines* pLines) {
+	int res = 0;
+	if (pLines) {
+		memset(pLines, 0, sizeof(elfi32_lines));
+	}
+	if (pLines && elfi32_valid(pELF)) {
+		elfi32_sectcache cache;
+		if (elfi32_sectcache_init(&cache, pELF)) {
+			size_t lineSize;
+			size_t lineStrSize;
+			size_t strSize;
+			const uint8_t* pLine = elfi32_sectcache_find(&cache, ".debug_line", &lineSize);
+			const uint8_t* pLineStr = elfi32_sectcache_find(&cache, ".debug_line_str", &lineStrSize);
+			const uint8_t* pStr = elfi32_sectcache_find(&cache, ".debug_str", &strSize);
+			int be = (((uint8_t*)pELF)[5] & 0x7F) == 2;
+			res = elfi32_lines_decode(pLine, lineSize, pLineStr, lineStrSize, pStr, strSize, be, pLines);
+			elfi32_sectcache_free(&cache);
+		}
+	}
+	return res;
+}
+
+void elfi32_lines_free(elfi32_lines* pLines) {
+	if (pLines) {
+		free(pLines->pBlks);
+		free(pLines->pDeltas);
+		free(pLines->pFiles);
+		free(pLines->pStrs);
+		memset(pLines, 0, sizeof(elfi32_lines));
+	}
+}
+
+static uint32_t get_uleb(const uint8_t** pp) {
+	const uint8_t* p = *pp;
+	uint32_t val = 0;
+	int shift = 0;
+	uint8_t b;
+	do {
+		b = *p++;
+		val |= (uint32_t)(b & 0x7F) << shift;
+		shift += 7;
+	} while ((b & 0x80) && shift < 35);
+	*pp = p;
+	return val;
+}
+
+/* binary search over block anchors, then at most ELFI32_LINE_BLK rows decoded */
+int elfi32_lines_lookup(const elfi32_lines* pLines, uint32_t addr, elfi32_lineinfo* pInfo) {
+	const elfi32_lineblk* pBlk;
+	const uint8_t* p;
+	uint32_t rowAddr;
+	uint32_t line;
+	uint32_t file;
+	int lo = 0;
+	int hi;
+	int nrows;
+	int i;
+	if (!pLines || pLines->numBlks <= 0 || addr < pLines->pBlks[0].addr) {
+		return 0;
+	}
+	hi = pLines->numBlks;
+	while (hi - lo > 1) {
+		int mid = (lo + hi) / 2;
+		if (pLines->pBlks[mid].addr <= addr) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+	pBlk = &pLines->pBlks[lo];
+	rowAddr = pBlk->addr;
+	line = pBlk->line;
+	file = pBlk->file;
+	p = pLines->pDeltas + pBlk->offs;
+	nrows = pLines->numRows - lo*ELFI32_LINE_BLK;
+	if (nrows > ELFI32_LINE_BLK) {
+		nrows = ELFI32_LINE_BLK;
+	}
+	for (i = 1; i < nrows; ++i) {
+		const uint8_t* pRow = p;
+		uint32_t nextAddr = rowAddr + get_uleb(&pRow);
+		uint32_t v;
+		if (nextAddr > addr) {
+			break;
+		}
+		v = get_uleb(&pRow);
+		line += (v >> 2) ^ (uint32_t)-(int32_t)((v >> 1) & 1);
+		if (v & 1) {
+			file = get_uleb(&pRow);
+		}
+		rowAddr = nextAddr;
+		p = pRow;
+	}
+	if (line == 0) {
+		return 0;
+	}
+	if (pInfo) {
+		pInfo->addr = rowAddr;
+		pInfo->line = line;
+		if (file < (uint32_t)pLines->numFiles) {
+			pInfo->pDir = pLines->pFiles[file].pDir;
+			pInfo->pFile = pLines->pFiles[file].pName;
+		} else {
+			pInfo->pDir = "";
+			pInfo->pFile = "";
+		}
+	}
+	return 1;
+}
@@ -0,0 +1,55 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ELFI32_LINE_BLK 32 /* rows per anchor block */
+
+typedef struct _elfi32_linefile {
+	const char* pDir;
+	const char* pName;
+} elfi32_linefile;
+
+/* absolute values for the first row of a block, the rest are delta-coded */
+typedef struct _elfi32_lineblk {
+	uint32_t addr;
+	uint32_t line;
+	uint32_t file;
+	uint32_t offs; /* into pDeltas */
+} elfi32_lineblk;
+
+/*
+ * Address-sorted row table built from .debug_line. A row with line 0
+ * ends a sequence: addresses from there to the next row have no source.
+ * Owns its strings, so it does not reference the ELF image.
+ */
+typedef struct _elfi32_lines {
+	int numRows;
+	int numBlks;
+	elfi32_lineblk* pBlks;
+	uint8_t* pDeltas;
+	size_t deltasSize;
+	int numFiles;
+	elfi32_linefile* pFiles;
+	char* pStrs;
+} elfi32_lines;
+
+typedef struct _elfi32_lineinfo {
+	uint32_t addr; /* first address of the matching row */
+	uint32_t line;
+	const char* pDir;
+	const char* pFile;
+} elfi32_lineinfo;
+
+int elfi32_lines_build(void* pELF, elfi32_lines* pLines);
+int elfi32_lines_decode(const uint8_t* pLine, size_t lineSize, const uint8_t* pLineStr, size_t lineStrSize, const uint8_t* pStr, size_t strSize, int be, elfi32_lines* pLines);
+void elfi32_lines_free(elfi32_lines* pLines);
+int elfi32_lines_lookup(const elfi32_lines* pLines, uint32_t addr, elfi32_lineinfo* pInfo);
+
+#ifdef __cplusplus
+}
+#endif
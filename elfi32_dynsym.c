@@ -0,0 +1,249 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "elfi32.h"
+#include "elfi32_dynsym.h"
+
+#define SHT_HASH 5
+#define SHT_DYNSYM 11
+#define SHT_GNU_HASH 0x6FFFFFF6
+
+typedef struct _DynTab {
+	uint32_t symOffs;
+	uint32_t numSyms;
+	uint32_t strOffs;
+	uint32_t strSize;
+} DynTab;
+
+static int find_sect_type(void* pELF, uint32_t type) {
+	uint32_t nsects = elfi32_num_sect_header_entries(pELF);
+	uint32_t i;
+	for (i = 0; i < nsects; ++i) {
+		if (elfi32_section_type(pELF, (int)i) == type) {
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+static uint32_t sect_link(void* pELF, int isect) {
+	uint32_t hoffs = elfi32_sect_header_offs(pELF);
+	uint32_t esize = elfi32_sect_header_entry_size(pELF);
+	return elfi32_read_u32(pELF, hoffs + isect*esize + 0x18);
+}
+
+static int dyntab_init(void* pELF, int isymtab, DynTab* pTab) {
+	uint32_t size = 0;
+	int istrtab;
+	memset(pTab, 0, sizeof(DynTab));
+	if (isymtab < 0) {
+		return 0;
+	}
+	istrtab = (int)sect_link(pELF, isymtab);
+	elfi32_section_addrinfo(pELF, isymtab, NULL, &pTab->symOffs, &size);
+	elfi32_section_addrinfo(pELF, istrtab, NULL, &pTab->strOffs, &pTab->strSize);
+	pTab->numSyms = size / 0x10;
+	return pTab->symOffs > 0 && pTab->numSyms > 0 && pTab->strOffs > 0 && pTab->strSize > 0;
+}
+
+static const char* dyntab_name(void* pELF, const DynTab* pTab, uint32_t isym) {
+	uint32_t nameOffs = elfi32_read_u32(pELF, pTab->symOffs + isym*0x10);
+	return nameOffs < pTab->strSize ? (const char*)pELF + pTab->strOffs + nameOffs : "";
+}
+
+static uint32_t gnu_hash(const char* pName) {
+	uint32_t h = 5381;
+	const uint8_t* p = (const uint8_t*)pName;
+	while (*p) {
+		h = h*33 + *p++;
+	}
+	return h;
+}
+
+static uint32_t sysv_hash(const char* pName) {
+	uint32_t h = 0;
+	const uint8_t* p = (const uint8_t*)pName;
+	while (*p) {
+		uint32_t g;
+		h = (h << 4) + *p++;
+		g = h & 0xF0000000;
+		h ^= g >> 24;
+		h &= ~g;
+	}
+	return h;
+}
+
+/*
+ * .gnu.hash: nbuckets, symoffset, bloom size, bloom shift, then 32-bit
+ * bloom words, buckets and the hash chain for symbols from symoffset on.
+ */
+static int gnu_lookup(void* pELF, int ihash, const DynTab* pTab, const char* pName) {
+	uint32_t offs = 0;
+	uint32_t size = 0;
+	uint32_t nbuckets;
+	uint32_t symBase;
+	uint32_t bloomSize;
+	uint32_t bloomShift;
+	uint32_t bucketsOffs;
+	uint32_t chainOffs;
+	uint32_t h;
+	uint32_t bloom;
+	uint32_t mask;
+	uint32_t isym;
+	elfi32_section_addrinfo(pELF, ihash, NULL, &offs, &size);
+	if (size < 0x10) {
+		return -1;
+	}
+	nbuckets = elfi32_read_u32(pELF, offs);
+	symBase = elfi32_read_u32(pELF, offs + 4);
+	bloomSize = elfi32_read_u32(pELF, offs + 8);
+	bloomShift = elfi32_read_u32(pELF, offs + 12);
+	if (nbuckets == 0 || bloomSize == 0 || 0x10 + (uint64_t)(bloomSize + nbuckets)*4 > size) {
+		return -1;
+	}
+	h = gnu_hash(pName);
+	bloom = elfi32_read_u32(pELF, offs + 0x10 + ((h / 32) % bloomSize)*4);
+	mask = (1U << (h % 32)) | (1U << ((h >> bloomShift) % 32));
+	if ((bloom & mask) != mask) {
+		return -1;
+	}
+	bucketsOffs = offs + 0x10 + bloomSize*4;
+	chainOffs = bucketsOffs + nbuckets*4;
+	isym = elfi32_read_u32(pELF, bucketsOffs + (h % nbuckets)*4);
+	if (isym < symBase) {
+		return -1;
+	}
+	for (; isym < pTab->numSyms && chainOffs + (isym - symBase)*4 + 4 <= offs + size; ++isym) {
+		uint32_t h2 = elfi32_read_u32(pELF, chainOffs + (isym - symBase)*4);
+		if ((h | 1) == (h2 | 1) && strcmp(pName, dyntab_name(pELF, pTab, isym)) == 0) {
+			return (int)isym;
+		}
+		if (h2 & 1) {
+			break;
+		}
+	}
+	return -1;
+}
+
+/* .hash: nbucket, nchain, buckets, chains */
+static int sysv_lookup(void* pELF, int ihash, const DynTab* pTab, const char* pName) {
+	uint32_t offs = 0;
+	uint32_t size = 0;
+	uint32_t nbuckets;
+	uint32_t nchains;
+	uint32_t isym;
+	uint32_t steps = 0;
+	elfi32_section_addrinfo(pELF, ihash, NULL, &offs, &size);
+	if (size < 8) {
+		return -1;
+	}
+	nbuckets = elfi32_read_u32(pELF, offs);
+	nchains = elfi32_read_u32(pELF, offs + 4);
+	if (nbuckets == 0 || 8 + (uint64_t)(nbuckets + nchains)*4 > size) {
+		return -1;
+	}
+	isym = elfi32_read_u32(pELF, offs + 8 + (sysv_hash(pName) % nbuckets)*4);
+	while (isym != 0 && isym < nchains && isym < pTab->numSyms && steps++ < nchains) {
+		if (strcmp(pName, dyntab_name(pELF, pTab, isym)) == 0) {
+			return (int)isym;
+		}
+		isym = elfi32_read_u32(pELF, offs + 8 + (nbuckets + isym)*4);
+	}
+	return -1;
+}
+
+/*
+ * .dynsym index of pName through .gnu.hash, or .hash, straight from the
+ * image; a linear .dynsym scan only when neither table is present.
+ */
+int elfi32_dynsym_lookup(void* pELF, const char* pName) {
+	int res = -1;
+	DynTab tab;
+	if (pName && elfi32_valid(pELF) && dyntab_init(pELF, find_sect_type(pELF, SHT_DYNSYM), &tab)) {
+		int ihash = find_sect_type(pELF, SHT_GNU_HASH);
+		if (ihash >= 0) {
+			res = gnu_lookup(pELF, ihash, &tab, pName);
+		} else if ((ihash = find_sect_type(pELF, SHT_HASH)) >= 0) {
+			res = sysv_lookup(pELF, ihash, &tab, pName);
+		} else {
+			uint32_t i;
+			for (i = 1; i < tab.numSyms; ++i) {
+				if (strcmp(pName, dyntab_name(pELF, &tab, i)) == 0) {
+					res = (int)i;
+					break;
+				}
+			}
+		}
+	}
+	return res;
+}
+
+static void dynsym_info(void* pELF, const DynTab* pTab, uint32_t isym, uint32_t* pAddr, uint32_t* pSize, uint32_t* pAttr) {
+	uint32_t symOffs = pTab->symOffs + isym*0x10;
+	*pAddr = elfi32_read_u32(pELF, symOffs + 4);
+	*pSize = elfi32_read_u32(pELF, symOffs + 8);
+	*pAttr = elfi32_read_u8(pELF, symOffs + 12);
+	*pAttr |= elfi32_read_u8(pELF, symOffs + 13) << 8;
+	*pAttr |= (uint32_t)elfi32_read_u16(pELF, symOffs + 14) << 16;
+}
+
+void elfi32_foreach_dynsym(void* pELF, elfi32_symfn fn, void* pCtx) {
+	DynTab tab;
+	if (fn && elfi32_valid(pELF) && dyntab_init(pELF, find_sect_type(pELF, SHT_DYNSYM), &tab)) {
+		uint32_t i;
+		for (i = 0; i < tab.numSyms; ++i) {
+			uint32_t addr;
+			uint32_t size;
+			uint32_t attr;
+			dynsym_info(pELF, &tab, i, &addr, &size, &attr);
+			if (!fn((int)i, dyntab_name(pELF, &tab, i), addr, size, attr, pCtx)) {
+				break;
+			}
+		}
+	}
+}
+
+typedef struct _SymFind {
+	const char* pName;
+	elfi32_syminfo* pInfo;
+} SymFind;
+
+static int symtab_find_fn(int isym, const char* pName, uint32_t addr, uint32_t size, uint32_t attr, void* pCtx) {
+	SymFind* pFind = (SymFind*)pCtx;
+	if (isym > 0 && strcmp(pName, pFind->pName) == 0) {
+		pFind->pInfo->isym = isym;
+		pFind->pInfo->pName = pName;
+		pFind->pInfo->addr = addr;
+		pFind->pInfo->size = size;
+		pFind->pInfo->attr = attr;
+		return 0;
+	}
+	return 1;
+}
+
+/* hashed .dynsym first, otherwise the .symtab scan */
+int elfi32_find_sym(void* pELF, const char* pName, elfi32_syminfo* pInfo) {
+	elfi32_syminfo info;
+	int isym = elfi32_dynsym_lookup(pELF, pName);
+	memset(&info, 0, sizeof(info));
+	info.isym = -1;
+	if (isym > 0) {
+		DynTab tab;
+		dyntab_init(pELF, find_sect_type(pELF, SHT_DYNSYM), &tab);
+		info.isym = isym;
+		info.dynamic = 1;
+		info.pName = dyntab_name(pELF, &tab, (uint32_t)isym);
+		dynsym_info(pELF, &tab, (uint32_t)isym, &info.addr, &info.size, &info.attr);
+	} else if (pName) {
+		SymFind find;
+		find.pName = pName;
+		find.pInfo = &info;
+		elfi32_foreach_sym(pELF, symtab_find_fn, &find);
+	}
+	if (pInfo) {
+		*pInfo = info;
+	}
+	return info.isym >= 0;
+}
@@ -0,0 +1,25 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _elfi32_syminfo {
+	int isym;
+	int dynamic; /* isym is a .dynsym index rather than a .symtab one */
+	const char* pName;
+	uint32_t addr;
+	uint32_t size;
+	uint32_t attr; /* same layout as elfi32_symfn attr */
+} elfi32_syminfo;
+
+int elfi32_dynsym_lookup(void* pELF, const char* pName);
+void elfi32_foreach_dynsym(void* pELF, elfi32_symfn fn, void* pCtx);
+int elfi32_find_sym(void* pELF, const char* pName, elfi32_syminfo* pInfo);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,382 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "elfi32_inflate.h"
+
+/*
+ * Minimal RFC 1950/1951 decoder, enough for compressed ELF sections
+ * without pulling in zlib. Huffman codes up to INF_FAST_BITS long are
+ * resolved with one table lookup, longer ones canonically bit by bit.
+ */
+
+#define INF_MAX_BITS 15
+#define INF_FAST_BITS 9
+
+typedef struct _InfHuff {
+	uint16_t counts[INF_MAX_BITS + 1];
+	uint16_t syms[288];
+	uint16_t fast[1 << INF_FAST_BITS]; /* sym << 4 | len, 0 for the slow path */
+} InfHuff;
+
+typedef struct _InfState {
+	const uint8_t* pSrc;
+	size_t srcSize;
+	size_t srcPos;
+	uint64_t bitBuf;
+	int bitCnt;
+	int padBytes; /* zero bytes fed past the end of pSrc */
+	uint8_t* pDst;
+	size_t dstSize;
+	size_t dstPos;
+	int err;
+} InfState;
+
+static void inf_refill(InfState* pState) {
+	while (pState->bitCnt <= 56) {
+		uint64_t b = 0;
+		if (pState->srcPos < pState->srcSize) {
+			b = pState->pSrc[pState->srcPos++];
+		} else {
+			++pState->padBytes;
+		}
+		pState->bitBuf |= b << pState->bitCnt;
+		pState->bitCnt += 8;
+	}
+}
+
+static void inf_consume(InfState* pState, int n) {
+	pState->bitBuf >>= n;
+	pState->bitCnt -= n;
+	if (pState->padBytes * 8 > pState->bitCnt) {
+		/* read past the end of the input */
+		pState->err = 1;
+	}
+}
+
+static uint32_t inf_bits(InfState* pState, int n) {
+	uint32_t val;
+	if (pState->bitCnt < n) {
+		inf_refill(pState);
+	}
+	val = (uint32_t)(pState->bitBuf & (((uint64_t)1 << n) - 1));
+	inf_consume(pState, n);
+	return val;
+}
+
+static int inf_build(InfHuff* pHuff, const uint8_t* pLens, int n) {
+	uint16_t offs[INF_MAX_BITS + 2];
+	int left = 1;
+	int code = 0;
+	int len;
+	int i;
+	memset(pHuff->counts, 0, sizeof(pHuff->counts));
+	memset(pHuff->fast, 0, sizeof(pHuff->fast));
+	for (i = 0; i < n; ++i) {
+		++pHuff->counts[pLens[i]];
+	}
+	for (len = 1; len <= INF_MAX_BITS; ++len) {
+		left <<= 1;
+		left -= pHuff->counts[len];
+		if (left < 0) {
+			/* over-subscribed */
+			return 0;
+		}
+	}
+	offs[1] = 0;
+	for (len = 1; len <= INF_MAX_BITS; ++len) {
+		offs[len + 1] = offs[len] + pHuff->counts[len];
+	}
+	for (i = 0; i < n; ++i) {
+		if (pLens[i]) {
+			pHuff->syms[offs[pLens[i]]++] = (uint16_t)i;
+		}
+	}
+	/* canonical codes are assigned in symbol order within each length */
+	i = 0;
+	for (len = 1; len <= INF_FAST_BITS; ++len) {
+		int k;
+		for (k = 0; k < pHuff->counts[len]; ++k, ++i, ++code) {
+			int rev = 0;
+			int b;
+			for (b = 0; b < len; ++b) {
+				rev |= ((code >> b) & 1) << (len - 1 - b);
+			}
+			for (b = rev; b < (1 << INF_FAST_BITS); b += 1 << len) {
+				pHuff->fast[b] = (uint16_t)((pHuff->syms[i] << 4) | len);
+			}
+		}
+		code <<= 1;
+	}
+	return 1;
+}
+
+static int inf_decode(InfState* pState, const InfHuff* pHuff) {
+	uint16_t ent;
+	int code = 0;
+	int first = 0;
+	int index = 0;
+	int len;
+	if (pState->bitCnt < INF_MAX_BITS) {
+		inf_refill(pState);
+	}
+	ent = pHuff->fast[pState->bitBuf & ((1 << INF_FAST_BITS) - 1)];
+	if (ent) {
+		inf_consume(pState, ent & 0xF);
+		return ent >> 4;
+	}
+	for (len = 1; len <= INF_MAX_BITS; ++len) {
+		int count;
+		code |= (int)(pState->bitBuf & 1);
+		inf_consume(pState, 1);
+		count = pHuff->counts[len];
+		if (code - first < count) {
+			return pHuff->syms[index + (code - first)];
+		}
+		index += count;
+		first += count;
+		first <<= 1;
+		code <<= 1;
+	}
+	pState->err = 1;
+	return -1;
+}
+
+static const uint16_t s_lenBase[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t s_lenExtra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t s_distBase[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t s_distExtra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static int inf_codes(InfState* pState, const InfHuff* pLit, const InfHuff* pDist) {
+	while (!pState->err) {
+		int sym = inf_decode(pState, pLit);
+		if (sym < 256) {
+			if (sym < 0 || pState->dstPos >= pState->dstSize) {
+				return 0;
+			}
+			pState->pDst[pState->dstPos++] = (uint8_t)sym;
+		} else if (sym == 256) {
+			return !pState->err;
+		} else {
+			size_t len;
+			size_t dist;
+			int dsym;
+			sym -= 257;
+			if (sym >= 29) {
+				return 0;
+			}
+			len = s_lenBase[sym] + inf_bits(pState, s_lenExtra[sym]);
+			dsym = inf_decode(pState, pDist);
+			if (dsym < 0 || dsym >= 30) {
+				return 0;
+			}
+			dist = s_distBase[dsym] + inf_bits(pState, s_distExtra[dsym]);
+			if (dist > pState->dstPos || len > pState->dstSize - pState->dstPos) {
+				return 0;
+			}
+			{
+				uint8_t* pOut = pState->pDst + pState->dstPos;
+				const uint8_t* pFrom = pOut - dist;
+				size_t i;
+				for (i = 0; i < len; ++i) {
+					pOut[i] = pFrom[i];
+				}
+				pState->dstPos += len;
+			}
+		}
+	}
+	return 0;
+}
+
+static int inf_stored(InfState* pState) {
+	uint32_t len;
+	uint32_t nlen;
+	/* back to a byte boundary, returning whole unread bytes to the input */
+	inf_consume(pState, pState->bitCnt & 7);
+	while (pState->bitCnt > 0 && pState->padBytes > 0) {
+		--pState->padBytes;
+		pState->bitCnt -= 8;
+	}
+	pState->srcPos -= (size_t)(pState->bitCnt / 8);
+	pState->bitBuf = 0;
+	pState->bitCnt = 0;
+	if (pState->err || pState->srcSize - pState->srcPos < 4) {
+		return 0;
+	}
+	len = pState->pSrc[pState->srcPos] | ((uint32_t)pState->pSrc[pState->srcPos + 1] << 8);
+	nlen = pState->pSrc[pState->srcPos + 2] | ((uint32_t)pState->pSrc[pState->srcPos + 3] << 8);
+	pState->srcPos += 4;
+	if (len != (~nlen & 0xFFFF) || len > pState->srcSize - pState->srcPos || len > pState->dstSize - pState->dstPos) {
+		return 0;
+	}
+	memcpy(pState->pDst + pState->dstPos, pState->pSrc + pState->srcPos, len);
+	pState->srcPos += len;
+	pState->dstPos += len;
+	return 1;
+}
+
+static int inf_fixed(InfState* pState) {
+	InfHuff lit;
+	InfHuff dist;
+	uint8_t lens[288];
+	int i;
+	for (i = 0; i < 144; ++i) lens[i] = 8;
+	for (; i < 256; ++i) lens[i] = 9;
+	for (; i < 280; ++i) lens[i] = 7;
+	for (; i < 288; ++i) lens[i] = 8;
+	inf_build(&lit, lens, 288);
+	for (i = 0; i < 30; ++i) lens[i] = 5;
+	inf_build(&dist, lens, 30);
+	return inf_codes(pState, &lit, &dist);
+}
+
+static int inf_dynamic(InfState* pState) {
+	static const uint8_t s_order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+	InfHuff lit;
+	InfHuff dist;
+	uint8_t lens[288 + 32];
+	int nlen = (int)inf_bits(pState, 5) + 257;
+	int ndist = (int)inf_bits(pState, 5) + 1;
+	int ncode = (int)inf_bits(pState, 4) + 4;
+	int i;
+	if (nlen > 286 || ndist > 30) {
+		return 0;
+	}
+	memset(lens, 0, sizeof(lens));
+	for (i = 0; i < ncode; ++i) {
+		lens[s_order[i]] = (uint8_t)inf_bits(pState, 3);
+	}
+	if (!inf_build(&lit, lens, 19)) {
+		return 0;
+	}
+	i = 0;
+	while (i < nlen + ndist && !pState->err) {
+		int sym = inf_decode(pState, &lit);
+		int rep = 0;
+		uint8_t val = 0;
+		if (sym < 0) {
+			return 0;
+		}
+		if (sym < 16) {
+			lens[i++] = (uint8_t)sym;
+			continue;
+		}
+		if (sym == 16) {
+			if (i == 0) {
+				return 0;
+			}
+			val = lens[i - 1];
+			rep = 3 + (int)inf_bits(pState, 2);
+		} else if (sym == 17) {
+			rep = 3 + (int)inf_bits(pState, 3);
+		} else {
+			rep = 11 + (int)inf_bits(pState, 7);
+		}
+		if (i + rep > nlen + ndist) {
+			return 0;
+		}
+		while (rep--) {
+			lens[i++] = val;
+		}
+	}
+	if (pState->err || lens[256] == 0) {
+		return 0;
+	}
+	if (!inf_build(&lit, lens, nlen) || !inf_build(&dist, lens + nlen, ndist)) {
+		return 0;
+	}
+	return inf_codes(pState, &lit, &dist);
+}
+
+static uint32_t adler32(const uint8_t* p, size_t n) {
+	uint32_t a = 1;
+	uint32_t b = 0;
+	while (n > 0) {
+		size_t blk = n < 5552 ? n : 5552;
+		n -= blk;
+		while (blk--) {
+			a += *p++;
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	return (b << 16) | a;
+}
+
+/* raw deflate stream, returns the number of bytes produced or -1 */
+long elfi32_inflate_raw(const uint8_t* pSrc, size_t srcSize, uint8_t* pDst, size_t dstSize, size_t* pSrcUsed) {
+	InfState state;
+	int last = 0;
+	memset(&state, 0, sizeof(state));
+	state.pSrc = pSrc;
+	state.srcSize = srcSize;
+	state.pDst = pDst;
+	state.dstSize = dstSize;
+	if (!pSrc || (!pDst && dstSize > 0)) {
+		return -1;
+	}
+	while (!last) {
+		int ok;
+		uint32_t type;
+		last = (int)inf_bits(&state, 1);
+		type = inf_bits(&state, 2);
+		if (type == 0) {
+			ok = inf_stored(&state);
+		} else if (type == 1) {
+			ok = inf_fixed(&state);
+		} else if (type == 2) {
+			ok = inf_dynamic(&state);
+		} else {
+			ok = 0;
+		}
+		if (!ok || state.err) {
+			return -1;
+		}
+	}
+	if (pSrcUsed) {
+		/* whole bytes still sitting in the bit buffer were not consumed */
+		size_t unread = (size_t)(state.bitCnt / 8);
+		size_t pad = (size_t)state.padBytes;
+		*pSrcUsed = state.srcPos - (unread > pad ? unread - pad : 0);
+	}
+	return (long)state.dstPos;
+}
+
+/* zlib (RFC 1950) stream: header, deflate data, Adler-32 trailer */
+long elfi32_inflate(const uint8_t* pSrc, size_t srcSize, uint8_t* pDst, size_t dstSize) {
+	long res = -1;
+	if (pSrc && srcSize >= 6) {
+		uint32_t cmf = pSrc[0];
+		uint32_t flg = pSrc[1];
+		if ((cmf & 0xF) == 8 && (cmf >> 4) <= 7 && ((cmf << 8) | flg) % 31 == 0 && !(flg & 0x20)) {
+			size_t used = 0;
+			res = elfi32_inflate_raw(pSrc + 2, srcSize - 2, pDst, dstSize, &used);
+			if (res >= 0) {
+				const uint8_t* pTail = pSrc + 2 + used;
+				if (srcSize - 2 - used < 4) {
+					res = -1;
+				} else {
+					uint32_t sum = ((uint32_t)pTail[0] << 24) | ((uint32_t)pTail[1] << 16) | ((uint32_t)pTail[2] << 8) | pTail[3];
+					if (sum != adler32(pDst, (size_t)res)) {
+						res = -1;
+					}
+				}
+			}
+		}
+	}
+	return res;
+}
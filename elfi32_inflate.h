@@ -0,0 +1,15 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+long elfi32_inflate_raw(const uint8_t* pSrc, size_t srcSize, uint8_t* pDst, size_t dstSize, size_t* pSrcUsed);
+long elfi32_inflate(const uint8_t* pSrc, size_t srcSize, uint8_t* pDst, size_t dstSize);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,476 @@
+/* SPDX-License-Identifier: MIT */
+
+#ifndef _GNU_SOURCE
+#	define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#if defined(__linux__) && !defined(ELFI32_NO_URING)
+#	define ELFI32_URING 1
+#	include <sys/mman.h>
+#	include <sys/syscall.h>
+#	include <linux/io_uring.h>
+#endif
+
+#include "elfi32.h"
+#include "elfi32_prefetch.h"
+
+#define PF_MAX_READS 4
+
+typedef struct _PFRead {
+	uint32_t offs;
+	uint32_t size;
+} PFRead;
+
+typedef struct _PFile {
+	int idx;
+	int fd;
+	size_t size;
+	uint8_t* pBuf;
+	int phase;
+	int failed;
+	int npending;
+	int nreads;
+	PFRead reads[PF_MAX_READS];
+} PFile;
+
+static int pf_open(PFile* pFile, int idx, const char* pPath) {
+	struct stat st;
+	memset(pFile, 0, sizeof(PFile));
+	pFile->idx = idx;
+	pFile->fd = open(pPath, O_RDONLY);
+	if (pFile->fd < 0) {
+		return 0;
+	}
+	if (fstat(pFile->fd, &st) != 0 || st.st_size <= 0x34 || (uint64_t)st.st_size > 0xFFFFFFFFu) {
+		close(pFile->fd);
+		pFile->fd = -1;
+		return 0;
+	}
+	pFile->size = (size_t)st.st_size;
+	/* calloc'ed: pages of sections that are never read are not touched */
+	pFile->pBuf = (uint8_t*)calloc(1, pFile->size);
+	if (!pFile->pBuf) {
+		close(pFile->fd);
+		pFile->fd = -1;
+		return 0;
+	}
+	return 1;
+}
+
+static void pf_close(PFile* pFile) {
+	if (pFile->fd >= 0) {
+		close(pFile->fd);
+		pFile->fd = -1;
+	}
+}
+
+static void pf_add_read(PFile* pFile, uint32_t offs, uint32_t size) {
+	if (size > 0 && offs < pFile->size && size <= pFile->size - offs && pFile->nreads < PF_MAX_READS) {
+		pFile->reads[pFile->nreads].offs = offs;
+		pFile->reads[pFile->nreads].size = size;
+		++pFile->nreads;
+	}
+}
+
+/*
+ * Plans the reads for the next phase once the previous one is complete:
+ * ELF header, then section table, then .shstrtab, then the sections that
+ * the symbol and function walks need. Returns 0 when the image is done.
+ */
+static int pf_plan(PFile* pFile) {
+	void* pELF = pFile->pBuf;
+	pFile->nreads = 0;
+	if (pFile->failed) {
+		return 0;
+	}
+	++pFile->phase;
+	if (pFile->phase == 1) {
+		pf_add_read(pFile, 0, 0x34);
+	} else if (pFile->phase == 2) {
+		uint32_t hoffs;
+		uint32_t tblSize;
+		if (!elfi32_valid(pELF)) {
+			pFile->failed = 1;
+			return 0;
+		}
+		elfi32_set_swap(pELF);
+		hoffs = elfi32_sect_header_offs(pELF);
+		tblSize = elfi32_sect_header_entry_size(pELF) * elfi32_num_sect_header_entries(pELF);
+		if (hoffs == 0 || tblSize == 0 || hoffs > pFile->size || tblSize > pFile->size - hoffs) {
+			pFile->failed = 1;
+			return 0;
+		}
+		pf_add_read(pFile, hoffs, tblSize);
+	} else if (pFile->phase == 3) {
+		uint32_t offs;
+		uint32_t size;
+		elfi32_section_addrinfo(pELF, (int)elfi32_sect_names_entry_id(pELF), NULL, &offs, &size);
+		pf_add_read(pFile, offs, size);
+		if (pFile->nreads == 0) {
+			pFile->failed = 1;
+			return 0;
+		}
+	} else if (pFile->phase == 4) {
+		static const char* s_names[] = { ".symtab", ".strtab", ".text" };
+		int i;
+		for (i = 0; i < (int)(sizeof(s_names) / sizeof(s_names[0])); ++i) {
+			int isect = elfi32_find_section(pELF, s_names[i]);
+			if (isect >= 0 && elfi32_section_type(pELF, isect) != 8) {
+				uint32_t offs;
+				uint32_t size;
+				elfi32_section_addrinfo(pELF, isect, NULL, &offs, &size);
+				pf_add_read(pFile, offs, size);
+			}
+		}
+	}
+	return pFile->nreads;
+}
+
+static void pf_finish(PFile* pFile, const char** ppPaths, elfi32_prefetchfn fn, void* pCtx) {
+	pf_close(pFile);
+	if (pFile->failed) {
+		free(pFile->pBuf);
+		pFile->pBuf = NULL;
+		pFile->size = 0;
+	}
+	if (fn) {
+		fn(pFile->idx, ppPaths[pFile->idx], pFile->pBuf, pFile->size, pCtx);
+	} else {
+		free(pFile->pBuf);
+	}
+	pFile->pBuf = NULL;
+}
+
+static int pf_pread_all(int fd, uint8_t* pDst, uint32_t offs, uint32_t size) {
+	while (size > 0) {
+		ssize_t n = pread(fd, pDst, size, (off_t)offs);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			return 0;
+		}
+		pDst += n;
+		offs += (uint32_t)n;
+		size -= (uint32_t)n;
+	}
+	return 1;
+}
+
+/* completes the current phase and all following ones synchronously */
+static void pf_pread_rest(PFile* pFile) {
+	if (pFile->phase == 0) {
+		pf_plan(pFile);
+	}
+	while (pFile->nreads > 0) {
+		int i;
+		for (i = 0; i < pFile->nreads; ++i) {
+			PFRead* pRead = &pFile->reads[i];
+			if (!pf_pread_all(pFile->fd, pFile->pBuf + pRead->offs, pRead->offs, pRead->size)) {
+				pFile->failed = 1;
+				break;
+			}
+		}
+		pf_plan(pFile);
+	}
+}
+
+typedef struct _PFJobCtx {
+	int first;
+	const char** ppPaths;
+	elfi32_prefetchfn fn;
+	void* pCtx;
+} PFJobCtx;
+
+static void pf_pread_job(int ijob, int iwk, void* pCtxMem) {
+	PFJobCtx* pCtx = (PFJobCtx*)pCtxMem;
+	PFile file;
+	int ipath = pCtx->first + ijob;
+	(void)iwk;
+	if (pf_open(&file, ipath, pCtx->ppPaths[ipath])) {
+		pf_pread_rest(&file);
+	} else {
+		file.failed = 1;
+	}
+	pf_finish(&file, pCtx->ppPaths, pCtx->fn, pCtx->pCtx);
+}
+
+#ifdef ELFI32_URING
+
+typedef struct _Uring {
+	int fd;
+	unsigned entries;
+	unsigned* pSqHead;
+	unsigned* pSqTail;
+	unsigned* pSqMask;
+	unsigned* pSqArray;
+	struct io_uring_sqe* pSqes;
+	unsigned* pCqHead;
+	unsigned* pCqTail;
+	unsigned* pCqMask;
+	struct io_uring_cqe* pCqes;
+	void* pSqRing;
+	size_t sqRingSize;
+	void* pCqRing;
+	size_t cqRingSize;
+	size_t sqesSize;
+} Uring;
+
+static void uring_exit(Uring* pRing) {
+	if (pRing->pSqes) {
+		munmap(pRing->pSqes, pRing->sqesSize);
+	}
+	if (pRing->pCqRing && pRing->pCqRing != pRing->pSqRing) {
+		munmap(pRing->pCqRing, pRing->cqRingSize);
+	}
+	if (pRing->pSqRing) {
+		munmap(pRing->pSqRing, pRing->sqRingSize);
+	}
+	if (pRing->fd >= 0) {
+		close(pRing->fd);
+	}
+	memset(pRing, 0, sizeof(Uring));
+	pRing->fd = -1;
+}
+
+static int uring_init(Uring* pRing, unsigned entries) {
+	struct io_uring_params params;
+	uint8_t* pSq;
+	uint8_t* pCq;
+	memset(pRing, 0, sizeof(Uring));
+	memset(&params, 0, sizeof(params));
+	pRing->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+	if (pRing->fd < 0) {
+		pRing->fd = -1;
+		return 0;
+	}
+	pRing->entries = params.sq_entries;
+	pRing->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	pRing->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		if (pRing->cqRingSize > pRing->sqRingSize) {
+			pRing->sqRingSize = pRing->cqRingSize;
+		}
+		pRing->cqRingSize = pRing->sqRingSize;
+	}
+	pRing->pSqRing = mmap(NULL, pRing->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, pRing->fd, IORING_OFF_SQ_RING);
+	if (pRing->pSqRing == MAP_FAILED) {
+		pRing->pSqRing = NULL;
+		uring_exit(pRing);
+		return 0;
+	}
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		pRing->pCqRing = pRing->pSqRing;
+	} else {
+		pRing->pCqRing = mmap(NULL, pRing->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, pRing->fd, IORING_OFF_CQ_RING);
+		if (pRing->pCqRing == MAP_FAILED) {
+			pRing->pCqRing = NULL;
+			uring_exit(pRing);
+			return 0;
+		}
+	}
+	pRing->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+	pRing->pSqes = (struct io_uring_sqe*)mmap(NULL, pRing->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, pRing->fd, IORING_OFF_SQES);
+	if (pRing->pSqes == MAP_FAILED) {
+		pRing->pSqes = NULL;
+		uring_exit(pRing);
+		return 0;
+	}
+	pSq = (uint8_t*)pRing->pSqRing;
+	pCq = (uint8_t*)pRing->pCqRing;
+	pRing->pSqHead = (unsigned*)(pSq + params.sq_off.head);
+	pRing->pSqTail = (unsigned*)(pSq + params.sq_off.tail);
+	pRing->pSqMask = (unsigned*)(pSq + params.sq_off.ring_mask);
+	pRing->pSqArray = (unsigned*)(pSq + params.sq_off.array);
+	pRing->pCqHead = (unsigned*)(pCq + params.cq_off.head);
+	pRing->pCqTail = (unsigned*)(pCq + params.cq_off.tail);
+	pRing->pCqMask = (unsigned*)(pCq + params.cq_off.ring_mask);
+	pRing->pCqes = (struct io_uring_cqe*)(pCq + params.cq_off.cqes);
+	return 1;
+}
+
+static void uring_push_read(Uring* pRing, int fd, void* pDst, uint32_t size, uint32_t offs, uint64_t tag) {
+	unsigned tail = *pRing->pSqTail;
+	unsigned idx = tail & *pRing->pSqMask;
+	struct io_uring_sqe* pSqe = &pRing->pSqes[idx];
+	memset(pSqe, 0, sizeof(struct io_uring_sqe));
+	pSqe->opcode = IORING_OP_READ;
+	pSqe->fd = fd;
+	pSqe->addr = (uint64_t)(uintptr_t)pDst;
+	pSqe->len = size;
+	pSqe->off = offs;
+	pSqe->user_data = tag;
+	pRing->pSqArray[idx] = idx;
+	__atomic_store_n(pRing->pSqTail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static int uring_enter(Uring* pRing, unsigned nsubmit, unsigned nwait) {
+	int res;
+	do {
+		res = (int)syscall(__NR_io_uring_enter, pRing->fd, nsubmit, nwait, nwait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+	} while (res < 0 && errno == EINTR);
+	return res;
+}
+
+/* user_data: slot index in the upper half, read index in the lower */
+#define PF_TAG(islot, iread) (((uint64_t)(islot) << 32) | (uint32_t)(iread))
+
+static void uring_submit_file(Uring* pRing, PFile* pFile, int islot, unsigned* pNumQueued) {
+	int i;
+	for (i = 0; i < pFile->nreads; ++i) {
+		PFRead* pRead = &pFile->reads[i];
+		uring_push_read(pRing, pFile->fd, pFile->pBuf + pRead->offs, pRead->size, pRead->offs, PF_TAG(islot, i));
+	}
+	pFile->npending = pFile->nreads;
+	*pNumQueued += pFile->nreads;
+}
+
+/*
+ * Returns the number of leading paths that were handled, the rest is left
+ * to the pread path (all of them when io_uring is not available).
+ */
+static int pf_uring_run(const char** ppPaths, int npaths, int depth, elfi32_prefetchfn fn, void* pCtx) {
+	Uring ring;
+	PFile* pSlots;
+	int* pFree;
+	int nfree;
+	int nextPath = 0;
+	int ndone = 0;
+	unsigned nqueued = 0;
+	int i;
+	if (!uring_init(&ring, (unsigned)depth * PF_MAX_READS)) {
+		return 0;
+	}
+	pSlots = (PFile*)malloc(sizeof(PFile) * depth);
+	pFree = (int*)malloc(sizeof(int) * depth);
+	if (!pSlots || !pFree) {
+		free(pSlots);
+		free(pFree);
+		uring_exit(&ring);
+		return 0;
+	}
+	for (i = 0; i < depth; ++i) {
+		pSlots[i].fd = -1;
+		pFree[i] = depth - 1 - i;
+	}
+	nfree = depth;
+	while (ndone < npaths) {
+		unsigned head;
+		unsigned tail;
+		int nsubmitted;
+		/* keep depth files in flight */
+		while (nfree > 0 && nextPath < npaths) {
+			int islot = pFree[nfree - 1];
+			PFile* pFile = &pSlots[islot];
+			int ipath = nextPath++;
+			if (pf_open(pFile, ipath, ppPaths[ipath]) && pf_plan(pFile) > 0) {
+				--nfree;
+				uring_submit_file(&ring, pFile, islot, &nqueued);
+			} else {
+				pFile->idx = ipath;
+				pFile->failed = 1;
+				pf_finish(pFile, ppPaths, fn, pCtx);
+				++ndone;
+			}
+		}
+		if (ndone >= npaths) {
+			break;
+		}
+		nsubmitted = uring_enter(&ring, nqueued, 1);
+		if (nsubmitted < 0) {
+			/* ring is unusable: finish what is in flight synchronously */
+			for (i = 0; i < depth; ++i) {
+				PFile* pFile = &pSlots[i];
+				if (pFile->fd >= 0) {
+					pf_pread_rest(pFile);
+					pf_finish(pFile, ppPaths, fn, pCtx);
+					++ndone;
+				}
+			}
+			break;
+		}
+		/* a short submit leaves the rest in the SQ ring for the next enter */
+		nqueued -= (unsigned)nsubmitted;
+		head = *ring.pCqHead;
+		tail = __atomic_load_n(ring.pCqTail, __ATOMIC_ACQUIRE);
+		while (head != tail) {
+			struct io_uring_cqe* pCqe = &ring.pCqes[head & *ring.pCqMask];
+			int islot = (int)(pCqe->user_data >> 32);
+			int iread = (int)(pCqe->user_data & 0xFFFFFFFF);
+			PFile* pFile = &pSlots[islot];
+			PFRead* pRead = &pFile->reads[iread];
+			int res = pCqe->res;
+			++head;
+			if (res == -EINVAL || res == -EOPNOTSUPP) {
+				/* kernel without IORING_OP_READ */
+				if (!pf_pread_all(pFile->fd, pFile->pBuf + pRead->offs, pRead->offs, pRead->size)) {
+					pFile->failed = 1;
+				}
+			} else if (res <= 0) {
+				pFile->failed = 1;
+			} else if ((uint32_t)res < pRead->size) {
+				/* short read: queue the rest */
+				pRead->offs += (uint32_t)res;
+				pRead->size -= (uint32_t)res;
+				uring_push_read(&ring, pFile->fd, pFile->pBuf + pRead->offs, pRead->size, pRead->offs, pCqe->user_data);
+				++nqueued;
+				continue;
+			}
+			if (--pFile->npending == 0) {
+				if (pf_plan(pFile) > 0) {
+					uring_submit_file(&ring, pFile, islot, &nqueued);
+				} else {
+					pf_finish(pFile, ppPaths, fn, pCtx);
+					pFree[nfree++] = islot;
+					++ndone;
+				}
+			}
+		}
+		__atomic_store_n(ring.pCqHead, head, __ATOMIC_RELEASE);
+	}
+	free(pSlots);
+	free(pFree);
+	uring_exit(&ring);
+	return nextPath;
+}
+
+#endif
+
+/*
+ * Loads the parts of many ELF files needed for symbol and function
+ * analysis. With io_uring the calling thread keeps up to depth files in
+ * flight and fn is called on it as each image completes. Otherwise the
+ * files are read with pread on the pool's workers, and fn is called from
+ * those workers concurrently.
+ */
+int elfi32_prefetch(const char** ppPaths, int npaths, int depth, WkPool* pPool, elfi32_prefetchfn fn, void* pCtx) {
+	int res = 0;
+	if (ppPaths && npaths > 0) {
+		if (depth <= 0) {
+			depth = 16;
+		}
+		if (depth > npaths) {
+			depth = npaths;
+		}
+#ifdef ELFI32_URING
+		res = pf_uring_run(ppPaths, npaths, depth, fn, pCtx);
+#endif
+		if (res < npaths) {
+			PFJobCtx ctx;
+			ctx.first = res;
+			ctx.ppPaths = ppPaths;
+			ctx.fn = fn;
+			ctx.pCtx = pCtx;
+			wkpool_for(pPool, npaths - res, pf_pread_job, &ctx);
+		}
+		res = 1;
+	}
+	return res;
+}
@@ -0,0 +1,23 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wkpool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * pELF is a malloc'ed image of the full file size that only has the
+ * headers, section table, .shstrtab, .symtab, .strtab and .text filled in,
+ * ownership passes to the callback (NULL if the file could not be read).
+ */
+typedef void (*elfi32_prefetchfn)(int idx, const char* pPath, void* pELF, size_t size, void* pCtx);
+
+int elfi32_prefetch(const char** ppPaths, int npaths, int depth, WkPool* pPool, elfi32_prefetchfn fn, void* pCtx);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,302 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "elfi32.h"
+#include "elfi32_reloc.h"
+
+#define SHT_RELA 4
+#define SHT_REL 9
+#define ET_REL 1
+
+static const char* s_relocNames[R_MICROBLAZE_NUM] = {
+	"R_MICROBLAZE_NONE",
+	"R_MICROBLAZE_32",
+	"R_MICROBLAZE_32_PCREL",
+	"R_MICROBLAZE_64_PCREL",
+	"R_MICROBLAZE_32_PCREL_LO",
+	"R_MICROBLAZE_64",
+	"R_MICROBLAZE_32_LO",
+	"R_MICROBLAZE_SRO32",
+	"R_MICROBLAZE_SRW32",
+	"R_MICROBLAZE_64_NONE",
+	"R_MICROBLAZE_32_SYM_OP_SYM",
+	"R_MICROBLAZE_GNU_VTINHERIT",
+	"R_MICROBLAZE_GNU_VTENTRY",
+	"R_MICROBLAZE_GOTPC_64",
+	"R_MICROBLAZE_GOT_64",
+	"R_MICROBLAZE_PLT_64",
+	"R_MICROBLAZE_REL",
+	"R_MICROBLAZE_JUMP_SLOT",
+	"R_MICROBLAZE_GLOB_DAT",
+	"R_MICROBLAZE_GOTOFF_64",
+	"R_MICROBLAZE_GOTOFF_32",
+	"R_MICROBLAZE_COPY",
+	"R_MICROBLAZE_TLS",
+	"R_MICROBLAZE_TLSGD",
+	"R_MICROBLAZE_TLSLD",
+	"R_MICROBLAZE_TLSDTPMOD32",
+	"R_MICROBLAZE_TLSDTPREL32",
+	"R_MICROBLAZE_TLSDTPREL64",
+	"R_MICROBLAZE_TLSGOTTPREL32",
+	"R_MICROBLAZE_TLSTPREL32",
+	"R_MICROBLAZE_TEXTPCREL_64",
+	"R_MICROBLAZE_TEXTREL_64",
+	"R_MICROBLAZE_TEXTREL_32_LO"
+};
+
+const char* elfi32_reloc_name(uint32_t type) {
+	return type < R_MICROBLAZE_NUM ? s_relocNames[type] : "R_MICROBLAZE_???";
+}
+
+/*
+ * Number of instruction words a relocation patches: the _64 forms cover
+ * an imm prefix carrying the high half plus the instruction after it.
+ */
+int elfi32_reloc_words(uint32_t type) {
+	int n = 1;
+	switch (type) {
+		case R_MICROBLAZE_NONE:
+		case R_MICROBLAZE_64_NONE:
+		case R_MICROBLAZE_GNU_VTINHERIT:
+		case R_MICROBLAZE_GNU_VTENTRY:
+		case R_MICROBLAZE_COPY:
+			n = 0;
+			break;
+		case R_MICROBLAZE_64_PCREL:
+		case R_MICROBLAZE_64:
+		case R_MICROBLAZE_GOTPC_64:
+		case R_MICROBLAZE_GOT_64:
+		case R_MICROBLAZE_PLT_64:
+		case R_MICROBLAZE_GOTOFF_64:
+		case R_MICROBLAZE_TLSGD:
+		case R_MICROBLAZE_TLSLD:
+		case R_MICROBLAZE_TLSDTPREL64:
+		case R_MICROBLAZE_TEXTPCREL_64:
+		case R_MICROBLAZE_TEXTREL_64:
+			n = 2;
+			break;
+		default:
+			break;
+	}
+	return n;
+}
+
+static uint32_t sect_hdr_u32(void* pELF, int isect, uint32_t field) {
+	uint32_t hoffs = elfi32_sect_header_offs(pELF);
+	uint32_t esize = elfi32_sect_header_entry_size(pELF);
+	return elfi32_read_u32(pELF, hoffs + isect*esize + field);
+}
+
+/* every entry of every SHT_REL/SHT_RELA section, in file order */
+static int reloc_foreach_sub(void* pELF, int itarget, elfi32_relocfn fn, void* pCtx) {
+	uint32_t nsects = elfi32_num_sect_header_entries(pELF);
+	int relocatable = elfi32_valid(pELF) && elfi32_read_u16(pELF, 0x10) == ET_REL;
+	int cnt = 0;
+	uint32_t isect;
+	for (isect = 0; isect < nsects; ++isect) {
+		uint32_t type = elfi32_section_type(pELF, (int)isect);
+		if (type == SHT_REL || type == SHT_RELA) {
+			uint32_t offs = 0;
+			uint32_t size = 0;
+			uint32_t esize = type == SHT_RELA ? 12 : 8;
+			uint32_t isymtab = sect_hdr_u32(pELF, (int)isect, 0x18);
+			uint32_t target = sect_hdr_u32(pELF, (int)isect, 0x1C);
+			uint32_t symtabOffs = 0;
+			uint32_t symtabSize = 0;
+			uint32_t targetAddr = 0;
+			uint32_t i;
+			uint32_t n;
+			if (itarget >= 0 && (uint32_t)itarget != target) {
+				continue;
+			}
+			elfi32_section_addrinfo(pELF, (int)isect, NULL, &offs, &size);
+			elfi32_section_addrinfo(pELF, (int)isymtab, NULL, &symtabOffs, &symtabSize);
+			elfi32_section_addrinfo(pELF, (int)target, &targetAddr, NULL, NULL);
+			if (relocatable) {
+				/* r_offset is already section-relative */
+				targetAddr = 0;
+			}
+			n = size / esize;
+			for (i = 0; i < n; ++i) {
+				elfi32_reloc rel;
+				uint32_t entOffs = offs + i*esize;
+				uint32_t info = elfi32_read_u32(pELF, entOffs + 4);
+				rel.offs = elfi32_read_u32(pELF, entOffs) - targetAddr;
+				rel.type = info & 0xFF;
+				rel.isym = info >> 8;
+				rel.symValue = rel.isym && rel.isym < symtabSize / 0x10 ? elfi32_read_u32(pELF, symtabOffs + rel.isym*0x10 + 4) : 0;
+				rel.hasAddend = type == SHT_RELA;
+				rel.addend = rel.hasAddend ? (int32_t)elfi32_read_u32(pELF, entOffs + 8) : 0;
+				rel.isect = (int)isect;
+				rel.itarget = (int)target;
+				rel.irel = (int)i;
+				++cnt;
+				if (fn && !fn(&rel, pCtx)) {
+					return cnt;
+				}
+			}
+		}
+	}
+	return cnt;
+}
+
+void elfi32_foreach_reloc(void* pELF, elfi32_relocfn fn, void* pCtx) {
+	reloc_foreach_sub(pELF, -1, fn, pCtx);
+}
+
+typedef struct _RelocList {
+	elfi32_reloc* pRelocs;
+	int num;
+} RelocList;
+
+static int collect_fn(const elfi32_reloc* pRel, void* pCtx) {
+	RelocList* pList = (RelocList*)pCtx;
+	pList->pRelocs[pList->num++] = *pRel;
+	return 1;
+}
+
+/* relocations patching itarget (-1 for all), caller frees *ppRelocs */
+int elfi32_collect_relocs(void* pELF, int itarget, elfi32_reloc** ppRelocs) {
+	RelocList list;
+	int n;
+	if (!ppRelocs) {
+		return 0;
+	}
+	*ppRelocs = NULL;
+	n = reloc_foreach_sub(pELF, itarget, NULL, NULL);
+	if (n <= 0) {
+		return 0;
+	}
+	list.pRelocs = (elfi32_reloc*)malloc(n * sizeof(elfi32_reloc));
+	list.num = 0;
+	if (!list.pRelocs) {
+		return -1;
+	}
+	reloc_foreach_sub(pELF, itarget, collect_fn, &list);
+	*ppRelocs = list.pRelocs;
+	return list.num;
+}
+
+static int cmp_reloc(const void* pA, const void* pB) {
+	const elfi32_reloc* pRelA = (const elfi32_reloc*)pA;
+	const elfi32_reloc* pRelB = (const elfi32_reloc*)pB;
+	if (pRelA->itarget != pRelB->itarget) {
+		return pRelA->itarget - pRelB->itarget;
+	}
+	if (pRelA->offs != pRelB->offs) {
+		return pRelA->offs < pRelB->offs ? -1 : 1;
+	}
+	if (pRelA->isect != pRelB->isect) {
+		return pRelA->isect - pRelB->isect;
+	}
+	return pRelA->irel - pRelB->irel;
+}
+
+/* by target section and offset; entries at the same place keep file order */
+void elfi32_sort_relocs(elfi32_reloc* pRelocs, int n) {
+	if (pRelocs && n > 1) {
+		qsort(pRelocs, n, sizeof(elfi32_reloc), cmp_reloc);
+	}
+}
+
+static uint32_t buf_u32(const uint8_t* p, int be) {
+	return be
+		? ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3]
+		: ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+}
+
+static void buf_put_u32(uint8_t* p, uint32_t val, int be) {
+	int i;
+	for (i = 0; i < 4; ++i) {
+		p[be ? 3 - i : i] = (uint8_t)(val >> (i*8));
+	}
+}
+
+static void buf_put_lo16(uint8_t* p, uint32_t val, int be) {
+	buf_put_u32(p, (buf_u32(p, be) & 0xFFFF0000) | (val & 0xFFFF), be);
+}
+
+/* .rel addend already stored at the place, in the relocation's own format */
+static int32_t implicit_addend(const uint8_t* p, int words, uint32_t type, int be) {
+	if (words == 2) {
+		return (int32_t)((buf_u32(p, be) << 16) | (buf_u32(p + 4, be) & 0xFFFF));
+	}
+	if (type == R_MICROBLAZE_32_LO || type == R_MICROBLAZE_32_PCREL_LO || type == R_MICROBLAZE_SRO32 || type == R_MICROBLAZE_SRW32) {
+		return (int32_t)(int16_t)(buf_u32(p, be) & 0xFFFF);
+	}
+	return (int32_t)buf_u32(p, be);
+}
+
+/*
+ * Patches pBuf, the contents of the relocations' target section, in one
+ * forward pass; pRelocs is sorted in place first so writes walk the
+ * buffer in address order. Returns the number of relocations that could
+ * not be applied (types needing a GOT/PLT/TLS layout, or out of range).
+ */
+int elfi32_apply_relocs(void* pELF, elfi32_reloc* pRelocs, int n, uint8_t* pBuf, uint32_t bufSize, const elfi32_relocenv* pEnv) {
+	int be = elfi32_valid(pELF) && (((uint8_t*)pELF)[5] & 0x7F) == 2;
+	int nfail = 0;
+	int i;
+	if (!pRelocs || !pBuf || !pEnv) {
+		return n;
+	}
+	elfi32_sort_relocs(pRelocs, n);
+	for (i = 0; i < n; ++i) {
+		const elfi32_reloc* pRel = &pRelocs[i];
+		int words = elfi32_reloc_words(pRel->type);
+		uint8_t* p = pBuf + pRel->offs;
+		uint32_t place = pEnv->base + pRel->offs;
+		uint32_t sym;
+		uint32_t val;
+		if (words == 0) {
+			continue;
+		}
+		if (pRel->offs > bufSize || bufSize - pRel->offs < (uint32_t)words*4) {
+			++nfail;
+			continue;
+		}
+		sym = pEnv->fnSym ? pEnv->fnSym(pRel->isym, pEnv->pSymCtx) : pRel->symValue + pEnv->bias;
+		val = sym + (uint32_t)(pRel->hasAddend ? pRel->addend : implicit_addend(p, words, pRel->type, be));
+		switch (pRel->type) {
+			case R_MICROBLAZE_32:
+			case R_MICROBLAZE_GLOB_DAT:
+			case R_MICROBLAZE_JUMP_SLOT:
+				buf_put_u32(p, val, be);
+				break;
+			case R_MICROBLAZE_REL:
+				buf_put_u32(p, pEnv->bias + (val - sym), be);
+				break;
+			case R_MICROBLAZE_32_PCREL:
+				buf_put_u32(p, val - place, be);
+				break;
+			case R_MICROBLAZE_32_LO:
+				buf_put_lo16(p, val, be);
+				break;
+			case R_MICROBLAZE_32_PCREL_LO:
+				buf_put_lo16(p, val - place, be);
+				break;
+			case R_MICROBLAZE_SRO32:
+				buf_put_lo16(p, val - pEnv->sda2Base, be);
+				break;
+			case R_MICROBLAZE_SRW32:
+				buf_put_lo16(p, val - pEnv->sdaBase, be);
+				break;
+			case R_MICROBLAZE_64:
+				buf_put_lo16(p, val >> 16, be);
+				buf_put_lo16(p + 4, val, be);
+				break;
+			case R_MICROBLAZE_64_PCREL:
+				/* relative to the instruction after the imm prefix */
+				val -= place + 4;
+				buf_put_lo16(p, val >> 16, be);
+				buf_put_lo16(p + 4, val, be);
+				break;
+			default:
+				++nfail;
+				break;
+		}
+	}
+	return nfail;
+}
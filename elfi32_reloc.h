@@ -0,0 +1,78 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define R_MICROBLAZE_NONE 0
+#define R_MICROBLAZE_32 1
+#define R_MICROBLAZE_32_PCREL 2
+#define R_MICROBLAZE_64_PCREL 3
+#define R_MICROBLAZE_32_PCREL_LO 4
+#define R_MICROBLAZE_64 5
+#define R_MICROBLAZE_32_LO 6
+#define R_MICROBLAZE_SRO32 7
+#define R_MICROBLAZE_SRW32 8
+#define R_MICROBLAZE_64_NONE 9
+#define R_MICROBLAZE_32_SYM_OP_SYM 10
+#define R_MICROBLAZE_GNU_VTINHERIT 11
+#define R_MICROBLAZE_GNU_VTENTRY 12
+#define R_MICROBLAZE_GOTPC_64 13
+#define R_MICROBLAZE_GOT_64 14
+#define R_MICROBLAZE_PLT_64 15
+#define R_MICROBLAZE_REL 16
+#define R_MICROBLAZE_JUMP_SLOT 17
+#define R_MICROBLAZE_GLOB_DAT 18
+#define R_MICROBLAZE_GOTOFF_64 19
+#define R_MICROBLAZE_GOTOFF_32 20
+#define R_MICROBLAZE_COPY 21
+#define R_MICROBLAZE_TLS 22
+#define R_MICROBLAZE_TLSGD 23
+#define R_MICROBLAZE_TLSLD 24
+#define R_MICROBLAZE_TLSDTPMOD32 25
+#define R_MICROBLAZE_TLSDTPREL32 26
+#define R_MICROBLAZE_TLSDTPREL64 27
+#define R_MICROBLAZE_TLSGOTTPREL32 28
+#define R_MICROBLAZE_TLSTPREL32 29
+#define R_MICROBLAZE_TEXTPCREL_64 30
+#define R_MICROBLAZE_TEXTREL_64 31
+#define R_MICROBLAZE_TEXTREL_32_LO 32
+#define R_MICROBLAZE_NUM 33
+
+typedef struct _elfi32_reloc {
+	uint32_t offs; /* relative to the target section */
+	uint32_t type;
+	uint32_t isym;
+	uint32_t symValue; /* st_value from the linked symbol table */
+	int32_t addend;
+	int hasAddend; /* .rela entry; .rel addends live in the patched location */
+	int isect; /* the .rel/.rela section */
+	int itarget; /* the section it patches */
+	int irel; /* entry index within isect */
+} elfi32_reloc;
+
+typedef int (*elfi32_relocfn)(const elfi32_reloc* pRel, void* pCtx);
+typedef uint32_t (*elfi32_symvalfn)(uint32_t isym, void* pCtx);
+
+typedef struct _elfi32_relocenv {
+	uint32_t base; /* run-time address of the patched section */
+	uint32_t bias; /* load bias added to symbol values and R_MICROBLAZE_REL */
+	uint32_t sdaBase; /* _SDA_BASE_, for R_MICROBLAZE_SRW32 */
+	uint32_t sda2Base; /* _SDA2_BASE_, for R_MICROBLAZE_SRO32 */
+	elfi32_symvalfn fnSym; /* overrides symValue + bias when set */
+	void* pSymCtx;
+} elfi32_relocenv;
+
+const char* elfi32_reloc_name(uint32_t type);
+int elfi32_reloc_words(uint32_t type);
+void elfi32_foreach_reloc(void* pELF, elfi32_relocfn fn, void* pCtx);
+int elfi32_collect_relocs(void* pELF, int itarget, elfi32_reloc** ppRelocs);
+void elfi32_sort_relocs(elfi32_reloc* pRelocs, int n);
+int elfi32_apply_relocs(void* pELF, elfi32_reloc* pRelocs, int n, uint8_t* pBuf, uint32_t bufSize, const elfi32_relocenv* pEnv);
+
+#ifdef __cplusplus
+}
+#endif
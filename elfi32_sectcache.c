@@ -0,0 +1,217 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "elfi32.h"
+#include "elfi32_inflate.h"
+#include "elfi32_sectcache.h"
+
+#define SHT_NOBITS 8
+#define CHDR_SIZE 12 /* Elf32_Chdr, also the "ZLIB" + be64 size legacy header */
+
+static int comp_info(void* pELF, int isect, uint32_t* pRawSize) {
+	int type = ELFI32_COMPRESS_NONE;
+	uint32_t raw = 0;
+	uint32_t offs = 0;
+	uint32_t size = 0;
+	elfi32_section_addrinfo(pELF, isect, NULL, &offs, &size);
+	if (offs > 0 && size >= CHDR_SIZE && elfi32_section_type(pELF, isect) != SHT_NOBITS) {
+		const uint8_t* p = (const uint8_t*)pELF + offs;
+		if (elfi32_section_flags(pELF, isect) & ELFI32_SHF_COMPRESSED) {
+			type = (int)elfi32_read_u32(pELF, offs);
+			raw = elfi32_read_u32(pELF, offs + 4);
+			if (type == ELFI32_COMPRESS_NONE) {
+				/* flagged but with no known format */
+				type = -1;
+			}
+		} else if (memcmp(p, "ZLIB", 4) == 0) {
+			const char* pName = elfi32_section_name(pELF, isect);
+			if (pName && strncmp(pName, ".zdebug", 7) == 0) {
+				type = ELFI32_COMPRESS_ZLIB;
+				raw = ((uint32_t)p[8] << 24) | ((uint32_t)p[9] << 16) | ((uint32_t)p[10] << 8) | p[11];
+				if (p[4] | p[5] | p[6] | p[7]) {
+					type = -1;
+				}
+			}
+		}
+	}
+	if (pRawSize) {
+		*pRawSize = raw;
+	}
+	return type;
+}
+
+/*
+ * Compression type of the section (ELFI32_COMPRESS_*, -1 for an unusable
+ * header) and its uncompressed size, 0 for sections stored as is.
+ */
+int elfi32_section_compressed(void* pELF, int isect, uint32_t* pRawSize) {
+	int res = ELFI32_COMPRESS_NONE;
+	if (pRawSize) {
+		*pRawSize = 0;
+	}
+	if (elfi32_valid(pELF) && (uint32_t)isect < elfi32_num_sect_header_entries(pELF)) {
+		res = comp_info(pELF, isect, pRawSize);
+	}
+	return res;
+}
+
+int elfi32_sectcache_init(elfi32_sectcache* pCache, void* pELF) {
+	int res = 0;
+	if (pCache) {
+		memset(pCache, 0, sizeof(elfi32_sectcache));
+		if (elfi32_valid(pELF)) {
+			int nsects = (int)elfi32_num_sect_header_entries(pELF);
+			pCache->pELF = pELF;
+			if (nsects > 0) {
+				pCache->pSects = (elfi32_sectdata*)calloc(nsects, sizeof(elfi32_sectdata));
+				if (pCache->pSects) {
+					pCache->numSects = nsects;
+					res = 1;
+				}
+			} else {
+				res = 1;
+			}
+		}
+	}
+	return res;
+}
+
+void elfi32_sectcache_free(elfi32_sectcache* pCache) {
+	if (pCache) {
+		int i;
+		for (i = 0; i < pCache->numSects; ++i) {
+			free(pCache->pSects[i].pOwned);
+		}
+		free(pCache->pSects);
+		memset(pCache, 0, sizeof(elfi32_sectcache));
+	}
+}
+
+static void sect_load(elfi32_sectcache* pCache, int isect) {
+	elfi32_sectdata* pEntry = &pCache->pSects[isect];
+	void* pELF = pCache->pELF;
+	uint32_t offs = 0;
+	uint32_t size = 0;
+	uint32_t raw = 0;
+	int type = comp_info(pELF, isect, &raw);
+	elfi32_section_addrinfo(pELF, isect, NULL, &offs, &size);
+	pEntry->state = -1;
+	if (type == ELFI32_COMPRESS_NONE) {
+		if (elfi32_section_type(pELF, isect) != SHT_NOBITS && offs > 0) {
+			pEntry->pData = (const uint8_t*)pELF + offs;
+			pEntry->size = size;
+		}
+		pEntry->state = 1;
+	} else if (type == ELFI32_COMPRESS_ZLIB) {
+		/* +1 so that an empty section still gets a distinct buffer */
+		uint8_t* pBuf = (uint8_t*)malloc((size_t)raw + 1);
+		if (pBuf) {
+			long n = elfi32_inflate((const uint8_t*)pELF + offs + CHDR_SIZE, size - CHDR_SIZE, pBuf, raw);
+			if (n == (long)raw) {
+				pEntry->pOwned = pBuf;
+				pEntry->pData = pBuf;
+				pEntry->size = raw;
+				pEntry->state = 1;
+			} else {
+				free(pBuf);
+			}
+		}
+	}
+}
+
+/*
+ * Contents of the section, inflated on the first call if compressed;
+ * NULL for SHT_NOBITS, out of range indices and unsupported or corrupt
+ * compressed data.
+ */
+const uint8_t* elfi32_sectcache_get(elfi32_sectcache* pCache, int isect, size_t* pSize) {
+	const uint8_t* pData = NULL;
+	size_t size = 0;
+	if (pCache && (uint32_t)isect < (uint32_t)pCache->numSects) {
+		elfi32_sectdata* pEntry = &pCache->pSects[isect];
+		if (pEntry->state == 0) {
+			sect_load(pCache, isect);
+		}
+		if (pEntry->state > 0) {
+			pData = pEntry->pData;
+			size = pData ? pEntry->size : 0;
+		}
+	}
+	if (pSize) {
+		*pSize = size;
+	}
+	return pData;
+}
+
+/* falls back to the legacy .zdebug_* name for .debug_* sections */
+const uint8_t* elfi32_sectcache_find(elfi32_sectcache* pCache, const char* pSectName, size_t* pSize) {
+	int isect = -1;
+	if (pCache && pCache->pELF && pSectName) {
+		isect = elfi32_find_section(pCache->pELF, pSectName);
+		if (isect < 0 && strncmp(pSectName, ".debug", 6) == 0 && strlen(pSectName) < 128) {
+			char zname[136];
+			zname[0] = '.';
+			zname[1] = 'z';
+			strcpy(zname + 2, pSectName + 1);
+			isect = elfi32_find_section(pCache->pELF, zname);
+		}
+	}
+	return elfi32_sectcache_get(pCache, isect, pSize);
+}
+
+typedef struct _PrefetchCtx {
+	elfi32_sectcache* pCache;
+	const int* pSects;
+} PrefetchCtx;
+
+static void prefetch_job(int ijob, int iwk, void* pMem) {
+	PrefetchCtx* pCtx = (PrefetchCtx*)pMem;
+	(void)iwk;
+	sect_load(pCtx->pCache, pCtx->pSects[ijob]);
+}
+
+/*
+ * Loads the listed sections (all compressed ones for a NULL list), one
+ * job per section, and returns how many of them are usable afterwards.
+ */
+int elfi32_sectcache_prefetch(elfi32_sectcache* pCache, const int* pSects, int nsects, WkPool* pPool) {
+	int res = 0;
+	if (pCache && pCache->numSects > 0) {
+		int* pTodo = (int*)malloc(pCache->numSects * sizeof(int));
+		if (pTodo) {
+			int ntodo = 0;
+			int n = pSects ? nsects : pCache->numSects;
+			int i;
+			for (i = 0; i < n; ++i) {
+				int isect = pSects ? pSects[i] : i;
+				if ((uint32_t)isect >= (uint32_t)pCache->numSects) {
+					continue;
+				}
+				if (!pSects && comp_info(pCache->pELF, isect, NULL) == ELFI32_COMPRESS_NONE) {
+					continue;
+				}
+				if (pCache->pSects[isect].state == 0) {
+					/* claim it here so a duplicate in the list gets no second job */
+					pCache->pSects[isect].state = 2;
+					pTodo[ntodo++] = isect;
+				}
+			}
+			if (ntodo > 0) {
+				PrefetchCtx ctx;
+				ctx.pCache = pCache;
+				ctx.pSects = pTodo;
+				wkpool_for(pPool, ntodo, prefetch_job, &ctx);
+			}
+			for (i = 0; i < n; ++i) {
+				int isect = pSects ? pSects[i] : i;
+				if ((uint32_t)isect < (uint32_t)pCache->numSects && pCache->pSects[isect].state > 0) {
+					res += pSects || comp_info(pCache->pELF, isect, NULL) != ELFI32_COMPRESS_NONE;
+				}
+			}
+			free(pTodo);
+		}
+	}
+	return res;
+}
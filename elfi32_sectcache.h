@@ -0,0 +1,46 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wkpool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ELFI32_SHF_COMPRESSED 0x800
+
+#define ELFI32_COMPRESS_NONE 0
+#define ELFI32_COMPRESS_ZLIB 1
+#define ELFI32_COMPRESS_ZSTD 2
+
+typedef struct _elfi32_sectdata {
+	const uint8_t* pData; /* into the image, or pOwned once inflated */
+	size_t size;
+	uint8_t* pOwned;
+	int state; /* 0 not loaded yet, 1 ready, -1 failed */
+} elfi32_sectdata;
+
+/*
+ * Section contents with SHF_COMPRESSED (and legacy .zdebug_*) sections
+ * inflated on first access and kept until elfi32_sectcache_free.
+ * Lookups are not synchronized, use elfi32_sectcache_prefetch to inflate
+ * up front before sharing a cache between threads.
+ */
+typedef struct _elfi32_sectcache {
+	void* pELF;
+	int numSects;
+	elfi32_sectdata* pSects;
+} elfi32_sectcache;
+
+int elfi32_section_compressed(void* pELF, int isect, uint32_t* pRawSize);
+int elfi32_sectcache_init(elfi32_sectcache* pCache, void* pELF);
+void elfi32_sectcache_free(elfi32_sectcache* pCache);
+const uint8_t* elfi32_sectcache_get(elfi32_sectcache* pCache, int isect, size_t* pSize);
+const uint8_t* elfi32_sectcache_find(elfi32_sectcache* pCache, const char* pSectName, size_t* pSize);
+int elfi32_sectcache_prefetch(elfi32_sectcache* pCache, const int* pSects, int nsects, WkPool* pPool);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,544 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "elfi32.h"
+#include "elfi32_size.h"
+
+#define SHF_ALLOC 2
+#define SHN_LORESERVE 0xFF00
+#define STB_LOCAL 0
+#define STT_SECTION 3
+#define STT_FILE 4
+
+/* trailing bytes up to the next symbol below this count as padding */
+#define SIZE_PAD_MAX 16
+
+typedef struct _SizeSym {
+	uint32_t addr;
+	uint32_t size;
+	int isym;
+	int isectPos; /* position in the address-sorted section list */
+	const char* pName;
+	const char* pObject;
+} SizeSym;
+
+static int cmp_sect_addr(const void* pA, const void* pB) {
+	uint32_t a = ((const elfi32_sizesect*)pA)->addr;
+	uint32_t b = ((const elfi32_sizesect*)pB)->addr;
+	return a < b ? -1 : a > b ? 1 : ((const elfi32_sizesect*)pA)->isect - ((const elfi32_sizesect*)pB)->isect;
+}
+
+/* section, address, larger symbols first so aliases and nested labels fold in */
+static int cmp_sym(const void* pA, const void* pB) {
+	const SizeSym* pSymA = (const SizeSym*)pA;
+	const SizeSym* pSymB = (const SizeSym*)pB;
+	if (pSymA->isectPos != pSymB->isectPos) {
+		return pSymA->isectPos - pSymB->isectPos;
+	}
+	if (pSymA->addr != pSymB->addr) {
+		return pSymA->addr < pSymB->addr ? -1 : 1;
+	}
+	if (pSymA->size != pSymB->size) {
+		return pSymA->size > pSymB->size ? -1 : 1;
+	}
+	return pSymA->isym - pSymB->isym;
+}
+
+static int collect_sects(void* pELF, elfi32_sizereport* pRep, int** ppSectPos) {
+	uint32_t nsects = elfi32_num_sect_header_entries(pELF);
+	int* pSectPos;
+	uint32_t i;
+	int n = 0;
+	pRep->pSects = (elfi32_sizesect*)calloc(nsects ? nsects : 1, sizeof(elfi32_sizesect));
+	pSectPos = (int*)malloc((nsects ? nsects : 1) * sizeof(int));
+	if (!pRep->pSects || !pSectPos) {
+		free(pSectPos);
+		return 0;
+	}
+	for (i = 0; i < nsects; ++i) {
+		uint32_t addr = 0;
+		uint32_t size = 0;
+		elfi32_section_addrinfo(pELF, (int)i, &addr, NULL, &size);
+		if ((elfi32_section_flags(pELF, (int)i) & SHF_ALLOC) && size > 0) {
+			elfi32_sizesect* pSect = &pRep->pSects[n++];
+			pSect->isect = (int)i;
+			pSect->pName = elfi32_section_name(pELF, (int)i);
+			pSect->addr = addr;
+			pSect->size = size;
+		}
+	}
+	qsort(pRep->pSects, n, sizeof(elfi32_sizesect), cmp_sect_addr);
+	for (i = 0; i < nsects; ++i) {
+		pSectPos[i] = -1;
+	}
+	for (i = 0; i < (uint32_t)n; ++i) {
+		pSectPos[pRep->pSects[i].isect] = (int)i;
+	}
+	pRep->numSects = n;
+	*ppSectPos = pSectPos;
+	return 1;
+}
+
+/*
+ * One pass over .symtab. Local symbols follow the STT_FILE symbol of the
+ * object they came from; globals come after all locals and stay unowned.
+ */
+static SizeSym* collect_syms(void* pELF, const int* pSectPos, int* pNumSyms) {
+	SizeSym* pSyms = NULL;
+	int isymtab = elfi32_find_section(pELF, ".symtab");
+	int istrtab = elfi32_find_section(pELF, ".strtab");
+	int n = 0;
+	if (isymtab >= 0 && istrtab >= 0) {
+		uint32_t symtabOffs = 0;
+		uint32_t symtabSize = 0;
+		uint32_t strtabOffs = 0;
+		uint32_t nsects = elfi32_num_sect_header_entries(pELF);
+		elfi32_section_addrinfo(pELF, isymtab, NULL, &symtabOffs, &symtabSize);
+		elfi32_section_addrinfo(pELF, istrtab, NULL, &strtabOffs, NULL);
+		if (symtabSize > 0xF) {
+			uint32_t nsym = symtabSize / 0x10;
+			uint32_t i;
+			const char* pObject = NULL;
+			pSyms = (SizeSym*)malloc(nsym * sizeof(SizeSym));
+			if (!pSyms) {
+				return NULL;
+			}
+			for (i = 1; i < nsym; ++i) {
+				uint32_t symOffs = symtabOffs + i*0x10;
+				uint32_t nameOffs = elfi32_read_u32(pELF, symOffs);
+				uint8_t info = elfi32_read_u8(pELF, symOffs + 12);
+				uint16_t shndx = elfi32_read_u16(pELF, symOffs + 14);
+				const char* pName = (const char*)pELF + strtabOffs + nameOffs;
+				uint32_t type = info & 0xF;
+				if (type == STT_FILE) {
+					pObject = pName;
+					continue;
+				}
+				if ((info >> 4) != STB_LOCAL) {
+					pObject = NULL;
+				}
+				if (type == STT_SECTION || nameOffs == 0 || shndx == 0 || shndx >= SHN_LORESERVE || shndx >= nsects) {
+					continue;
+				}
+				if (pSectPos[shndx] < 0) {
+					continue;
+				}
+				pSyms[n].addr = elfi32_read_u32(pELF, symOffs + 4);
+				pSyms[n].size = elfi32_read_u32(pELF, symOffs + 8);
+				pSyms[n].isym = (int)i;
+				pSyms[n].isectPos = pSectPos[shndx];
+				pSyms[n].pName = pName;
+				pSyms[n].pObject = (info >> 4) == STB_LOCAL ? pObject : NULL;
+				++n;
+			}
+			qsort(pSyms, n, sizeof(SizeSym), cmp_sym);
+		}
+	}
+	*pNumSyms = n;
+	return pSyms;
+}
+
+static elfi32_sizeitem* add_item(elfi32_sizereport* pRep, int* pCap) {
+	if (pRep->numItems >= *pCap) {
+		int cap = *pCap ? *pCap * 2 : 256;
+		elfi32_sizeitem* pItems = (elfi32_sizeitem*)realloc(pRep->pItems, cap * sizeof(elfi32_sizeitem));
+		if (!pItems) {
+			return NULL;
+		}
+		pRep->pItems = pItems;
+		*pCap = cap;
+	}
+	memset(&pRep->pItems[pRep->numItems], 0, sizeof(elfi32_sizeitem));
+	return &pRep->pItems[pRep->numItems++];
+}
+
+static int add_gap(elfi32_sizereport* pRep, int* pCap, elfi32_sizesect* pSect, uint32_t addr, uint32_t end) {
+	elfi32_sizeitem* pItem = add_item(pRep, pCap);
+	if (!pItem) {
+		return 0;
+	}
+	pItem->isym = -1;
+	pItem->isect = pSect->isect;
+	pItem->addr = addr;
+	pItem->size = end - addr;
+	pSect->gapBytes += end - addr;
+	return 1;
+}
+
+/*
+ * Sweeps each allocated section once against the sorted symbols, so every
+ * byte ends up in exactly one item: a symbol, its trailing padding, or a gap.
+ */
+static int sweep(elfi32_sizereport* pRep, const SizeSym* pSyms, int nsyms) {
+	int cap = 0;
+	int isym = 0;
+	int i;
+	for (i = 0; i < pRep->numSects; ++i) {
+		elfi32_sizesect* pSect = &pRep->pSects[i];
+		uint32_t cur = pSect->addr;
+		uint32_t end = pSect->addr + pSect->size;
+		elfi32_sizeitem* pLast = NULL;
+		while (isym < nsyms && pSyms[isym].isectPos < i) {
+			++isym;
+		}
+		for (; isym < nsyms && pSyms[isym].isectPos == i; ++isym) {
+			const SizeSym* pSym = &pSyms[isym];
+			uint32_t start = pSym->addr;
+			uint32_t next = end;
+			uint32_t symEnd;
+			int j;
+			if (start >= end) {
+				continue;
+			}
+			for (j = isym + 1; j < nsyms && pSyms[j].isectPos == i; ++j) {
+				if (pSyms[j].addr > start) {
+					next = pSyms[j].addr < end ? pSyms[j].addr : end;
+					break;
+				}
+			}
+			/* zero-sized labels extend to the next symbol */
+			symEnd = pSym->size ? start + pSym->size : next;
+			if (symEnd > end || symEnd < start) {
+				symEnd = end;
+			}
+			if (start < cur) {
+				if (symEnd <= cur) {
+					/* alias or nested in the previous symbol */
+					continue;
+				}
+				start = cur;
+			} else if (start > cur) {
+				if (!add_gap(pRep, &cap, pSect, cur, start)) {
+					return 0;
+				}
+			}
+			pLast = add_item(pRep, &cap);
+			if (!pLast) {
+				return 0;
+			}
+			pLast->isym = pSym->isym;
+			pLast->isect = pSect->isect;
+			pLast->addr = start;
+			pLast->size = symEnd - start;
+			pLast->pName = pSym->pName;
+			pLast->pObject = pSym->pObject;
+			pSect->symBytes += symEnd - start;
+			cur = symEnd;
+			if (next > cur && next - cur < SIZE_PAD_MAX) {
+				pLast->pad = next - cur;
+				pSect->padBytes += next - cur;
+				cur = next;
+			}
+		}
+		if (cur < end) {
+			if (pLast && end - cur < SIZE_PAD_MAX) {
+				pLast->pad += end - cur;
+				pSect->padBytes += end - cur;
+			} else if (!add_gap(pRep, &cap, pSect, cur, end)) {
+				return 0;
+			}
+		}
+		pRep->total += pSect->size;
+	}
+	return 1;
+}
+
+int elfi32_size_analyze(void* pELF, elfi32_sizereport* pRep) {
+	int res = 0;
+	if (pRep) {
+		memset(pRep, 0, sizeof(elfi32_sizereport));
+		if (elfi32_valid(pELF)) {
+			int* pSectPos = NULL;
+			if (collect_sects(pELF, pRep, &pSectPos)) {
+				int nsyms = 0;
+				SizeSym* pSyms = collect_syms(pELF, pSectPos, &nsyms);
+				res = sweep(pRep, pSyms, nsyms);
+				free(pSyms);
+			}
+			free(pSectPos);
+		}
+		if (!res) {
+			elfi32_size_free(pRep);
+		}
+	}
+	return res;
+}
+
+void elfi32_size_free(elfi32_sizereport* pRep) {
+	if (pRep) {
+		free(pRep->pSects);
+		free(pRep->pItems);
+		memset(pRep, 0, sizeof(elfi32_sizereport));
+	}
+}
+
+static const char* sect_name(const elfi32_sizereport* pRep, int isect) {
+	int i;
+	for (i = 0; i < pRep->numSects; ++i) {
+		if (pRep->pSects[i].isect == isect) {
+			return pRep->pSects[i].pName ? pRep->pSects[i].pName : "";
+		}
+	}
+	return "";
+}
+
+static void item_key(const elfi32_sizeitem* pItem, const char* pSectName, elfi32_sizemode mode, elfi32_sizegroup* pGroup) {
+	const char* pKey = "<gap>";
+	const char* pSub = NULL;
+	size_t len;
+	switch (mode) {
+		case ELFI32_SIZE_BY_SECTION:
+			pKey = pSectName;
+			break;
+		case ELFI32_SIZE_BY_OBJECT:
+			if (pItem->isym >= 0) {
+				pKey = pItem->pObject ? pItem->pObject : "<global>";
+			}
+			break;
+		case ELFI32_SIZE_BY_PREFIX:
+			if (pItem->isym >= 0) {
+				const char* p = pItem->pName;
+				pKey = p;
+				while (*p == '_' || *p == '.') {
+					++p;
+				}
+				while (*p && *p != '_' && *p != '.') {
+					++p;
+				}
+				pGroup->pKey = pKey;
+				pGroup->keyLen = (size_t)(p - pKey);
+				pGroup->pSub = NULL;
+				return;
+			}
+			break;
+		default:
+			pKey = pSectName;
+			pSub = pItem->isym >= 0 ? pItem->pName : "<gap>";
+			break;
+	}
+	len = strlen(pKey);
+	pGroup->pKey = pKey;
+	pGroup->keyLen = len;
+	pGroup->pSub = pSub;
+}
+
+static int cmp_group_key(const void* pA, const void* pB) {
+	const elfi32_sizegroup* pGrpA = (const elfi32_sizegroup*)pA;
+	const elfi32_sizegroup* pGrpB = (const elfi32_sizegroup*)pB;
+	size_t len = pGrpA->keyLen < pGrpB->keyLen ? pGrpA->keyLen : pGrpB->keyLen;
+	int res = memcmp(pGrpA->pKey, pGrpB->pKey, len);
+	if (res == 0) {
+		res = pGrpA->keyLen < pGrpB->keyLen ? -1 : pGrpA->keyLen > pGrpB->keyLen ? 1 : 0;
+	}
+	if (res == 0 && pGrpA->pSub != pGrpB->pSub) {
+		res = !pGrpA->pSub ? -1 : !pGrpB->pSub ? 1 : strcmp(pGrpA->pSub, pGrpB->pSub);
+	}
+	return res;
+}
+
+static int cmp_group_size(const void* pA, const void* pB) {
+	uint32_t a = ((const elfi32_sizegroup*)pA)->size;
+	uint32_t b = ((const elfi32_sizegroup*)pB)->size;
+	return a > b ? -1 : a < b ? 1 : cmp_group_key(pA, pB);
+}
+
+/* groups sorted by key; equal keys are folded together */
+static int group_by_key(const elfi32_sizereport* pRep, elfi32_sizemode mode, elfi32_sizegroup** ppGroups) {
+	elfi32_sizegroup* pGroups;
+	const char* pSectName = "";
+	int lastSect = -1;
+	int n = 0;
+	int i;
+	*ppGroups = NULL;
+	if (!pRep || pRep->numItems <= 0) {
+		return 0;
+	}
+	pGroups = (elfi32_sizegroup*)malloc(pRep->numItems * sizeof(elfi32_sizegroup));
+	if (!pGroups) {
+		return -1;
+	}
+	for (i = 0; i < pRep->numItems; ++i) {
+		const elfi32_sizeitem* pItem = &pRep->pItems[i];
+		if (pItem->isect != lastSect) {
+			lastSect = pItem->isect;
+			pSectName = sect_name(pRep, lastSect);
+		}
+		item_key(pItem, pSectName, mode, &pGroups[i]);
+		pGroups[i].size = pItem->size + pItem->pad;
+		pGroups[i].count = 1;
+	}
+	qsort(pGroups, pRep->numItems, sizeof(elfi32_sizegroup), cmp_group_key);
+	for (i = 0; i < pRep->numItems; ++i) {
+		if (n > 0 && cmp_group_key(&pGroups[n - 1], &pGroups[i]) == 0) {
+			pGroups[n - 1].size += pGroups[i].size;
+			pGroups[n - 1].count += pGroups[i].count;
+		} else {
+			pGroups[n++] = pGroups[i];
+		}
+	}
+	*ppGroups = pGroups;
+	return n;
+}
+
+/* caller frees *ppGroups; sorted by size, largest first */
+int elfi32_size_group(const elfi32_sizereport* pRep, elfi32_sizemode mode, elfi32_sizegroup** ppGroups) {
+	int n = 0;
+	if (ppGroups) {
+		n = group_by_key(pRep, mode, ppGroups);
+		if (n > 0) {
+			qsort(*ppGroups, n, sizeof(elfi32_sizegroup), cmp_group_size);
+		}
+	}
+	return n;
+}
+
+static uint32_t delta_abs(const elfi32_sizedelta* pDelta) {
+	return pDelta->newSize > pDelta->oldSize ? pDelta->newSize - pDelta->oldSize : pDelta->oldSize - pDelta->newSize;
+}
+
+static int cmp_delta(const void* pA, const void* pB) {
+	uint32_t a = delta_abs((const elfi32_sizedelta*)pA);
+	uint32_t b = delta_abs((const elfi32_sizedelta*)pB);
+	return a > b ? -1 : a < b ? 1 : 0;
+}
+
+/*
+ * Merge-walks the key-sorted groups of both reports. Only keys whose size
+ * changed are returned, largest change first; caller frees *ppDeltas.
+ */
+int elfi32_size_diff(const elfi32_sizereport* pOld, const elfi32_sizereport* pNew, elfi32_sizemode mode, elfi32_sizedelta** ppDeltas) {
+	elfi32_sizegroup* pOldGrps = NULL;
+	elfi32_sizegroup* pNewGrps = NULL;
+	elfi32_sizedelta* pDeltas;
+	int nold;
+	int nnew;
+	int n = 0;
+	int i = 0;
+	int j = 0;
+	if (!ppDeltas) {
+		return -1;
+	}
+	*ppDeltas = NULL;
+	nold = group_by_key(pOld, mode, &pOldGrps);
+	nnew = group_by_key(pNew, mode, &pNewGrps);
+	if (nold < 0 || nnew < 0) {
+		free(pOldGrps);
+		free(pNewGrps);
+		return -1;
+	}
+	pDeltas = (elfi32_sizedelta*)malloc((nold + nnew + 1) * sizeof(elfi32_sizedelta));
+	if (!pDeltas) {
+		free(pOldGrps);
+		free(pNewGrps);
+		return -1;
+	}
+	while (i < nold || j < nnew) {
+		int cmp = i >= nold ? 1 : j >= nnew ? -1 : cmp_group_key(&pOldGrps[i], &pNewGrps[j]);
+		const elfi32_sizegroup* pGrp = cmp <= 0 ? &pOldGrps[i] : &pNewGrps[j];
+		uint32_t oldSize = cmp <= 0 ? pOldGrps[i].size : 0;
+		uint32_t newSize = cmp >= 0 ? pNewGrps[j].size : 0;
+		if (oldSize != newSize) {
+			pDeltas[n].pKey = pGrp->pKey;
+			pDeltas[n].keyLen = pGrp->keyLen;
+			pDeltas[n].pSub = pGrp->pSub;
+			pDeltas[n].oldSize = oldSize;
+			pDeltas[n].newSize = newSize;
+			++n;
+		}
+		if (cmp <= 0) {
+			++i;
+		}
+		if (cmp >= 0) {
+			++j;
+		}
+	}
+	free(pOldGrps);
+	free(pNewGrps);
+	qsort(pDeltas, n, sizeof(elfi32_sizedelta), cmp_delta);
+	*ppDeltas = pDeltas;
+	return n;
+}
+
+static void size_line(elfi32_textfn fn, void* pCtx, const char* pFmt, ...) {
+	char line[512];
+	int len;
+	va_list args;
+	va_start(args, pFmt);
+	len = vsnprintf(line, sizeof(line), pFmt, args);
+	va_end(args);
+	if (len >= (int)sizeof(line)) {
+		len = (int)sizeof(line) - 1;
+	}
+	if (len > 0) {
+		if (fn) {
+			fn(pCtx, line, (size_t)len);
+		} else {
+			fwrite(line, 1, (size_t)len, stdout);
+		}
+	}
+}
+
+static void print_sects(const elfi32_sizereport* pRep, elfi32_textfn fn, void* pCtx) {
+	int i;
+	for (i = 0; i < pRep->numSects; ++i) {
+		const elfi32_sizesect* pSect = &pRep->pSects[i];
+		size_line(fn, pCtx, "%-16s 0x%08X %8u  sym %8u  pad %6u  gap %6u\n",
+			pSect->pName ? pSect->pName : "", pSect->addr, pSect->size,
+			pSect->symBytes, pSect->padBytes, pSect->gapBytes);
+	}
+	size_line(fn, pCtx, "total %u\n", pRep->total);
+}
+
+/* maxLines <= 0 prints every group */
+void elfi32_size_print(const elfi32_sizereport* pRep, elfi32_sizemode mode, int maxLines, elfi32_textfn fn, void* pCtx) {
+	elfi32_sizegroup* pGroups = NULL;
+	int n;
+	int i;
+	if (!pRep) {
+		return;
+	}
+	print_sects(pRep, fn, pCtx);
+	n = elfi32_size_group(pRep, mode, &pGroups);
+	if (maxLines > 0 && n > maxLines) {
+		n = maxLines;
+	}
+	for (i = 0; i < n; ++i) {
+		const elfi32_sizegroup* pGrp = &pGroups[i];
+		if (pGrp->pSub) {
+			size_line(fn, pCtx, "%8u %6.2f%%  %.*s:%s\n", pGrp->size,
+				pRep->total ? 100.0 * pGrp->size / pRep->total : 0.0,
+				(int)pGrp->keyLen, pGrp->pKey, pGrp->pSub);
+		} else {
+			size_line(fn, pCtx, "%8u %6.2f%%  %.*s (%d)\n", pGrp->size,
+				pRep->total ? 100.0 * pGrp->size / pRep->total : 0.0,
+				(int)pGrp->keyLen, pGrp->pKey, pGrp->count);
+		}
+	}
+	free(pGroups);
+}
+
+void elfi32_size_print_diff(const elfi32_sizereport* pOld, const elfi32_sizereport* pNew, elfi32_sizemode mode, int maxLines, elfi32_textfn fn, void* pCtx) {
+	elfi32_sizedelta* pDeltas = NULL;
+	int n;
+	int i;
+	if (!pOld || !pNew) {
+		return;
+	}
+	size_line(fn, pCtx, "total %u -> %u (%+lld)\n", pOld->total, pNew->total, (long long)pNew->total - (long long)pOld->total);
+	n = elfi32_size_diff(pOld, pNew, mode, &pDeltas);
+	if (maxLines > 0 && n > maxLines) {
+		n = maxLines;
+	}
+	for (i = 0; i < n; ++i) {
+		const elfi32_sizedelta* pDelta = &pDeltas[i];
+		size_line(fn, pCtx, "%+9lld %8u -> %-8u %.*s%s%s\n",
+			(long long)pDelta->newSize - (long long)pDelta->oldSize,
+			pDelta->oldSize, pDelta->newSize, (int)pDelta->keyLen, pDelta->pKey,
+			pDelta->pSub ? ":" : "", pDelta->pSub ? pDelta->pSub : "");
+	}
+	free(pDeltas);
+}
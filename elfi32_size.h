@@ -0,0 +1,73 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*elfi32_textfn)(void* pCtx, const char* pText, size_t len);
+
+typedef enum _elfi32_sizemode {
+	ELFI32_SIZE_BY_SYMBOL,
+	ELFI32_SIZE_BY_SECTION,
+	ELFI32_SIZE_BY_OBJECT,
+	ELFI32_SIZE_BY_PREFIX
+} elfi32_sizemode;
+
+/* names point into the ELF image, which must outlive the report */
+typedef struct _elfi32_sizeitem {
+	int isym; /* -1 for a gap no symbol covers */
+	int isect;
+	uint32_t addr;
+	uint32_t size; /* bytes covered by the symbol */
+	uint32_t pad; /* alignment padding up to the next symbol */
+	const char* pName;
+	const char* pObject; /* STT_FILE owning a local symbol, NULL otherwise */
+} elfi32_sizeitem;
+
+typedef struct _elfi32_sizesect {
+	int isect;
+	const char* pName;
+	uint32_t addr;
+	uint32_t size;
+	uint32_t symBytes;
+	uint32_t padBytes;
+	uint32_t gapBytes;
+} elfi32_sizesect;
+
+typedef struct _elfi32_sizereport {
+	int numSects;
+	elfi32_sizesect* pSects; /* SHF_ALLOC sections by address */
+	int numItems;
+	elfi32_sizeitem* pItems; /* by section, then address */
+	uint32_t total;
+} elfi32_sizereport;
+
+typedef struct _elfi32_sizegroup {
+	const char* pKey;
+	size_t keyLen;
+	const char* pSub; /* symbol name in ELFI32_SIZE_BY_SYMBOL mode */
+	uint32_t size;
+	int count;
+} elfi32_sizegroup;
+
+typedef struct _elfi32_sizedelta {
+	const char* pKey;
+	size_t keyLen;
+	const char* pSub;
+	uint32_t oldSize;
+	uint32_t newSize;
+} elfi32_sizedelta;
+
+int elfi32_size_analyze(void* pELF, elfi32_sizereport* pRep);
+void elfi32_size_free(elfi32_sizereport* pRep);
+int elfi32_size_group(const elfi32_sizereport* pRep, elfi32_sizemode mode, elfi32_sizegroup** ppGroups);
+int elfi32_size_diff(const elfi32_sizereport* pOld, const elfi32_sizereport* pNew, elfi32_sizemode mode, elfi32_sizedelta** ppDeltas);
+void elfi32_size_print(const elfi32_sizereport* pRep, elfi32_sizemode mode, int maxLines, elfi32_textfn fn, void* pCtx);
+void elfi32_size_print_diff(const elfi32_sizereport* pOld, const elfi32_sizereport* pNew, elfi32_sizemode mode, int maxLines, elfi32_textfn fn, void* pCtx);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,277 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#	include <emmintrin.h>
+#	define SYMSEARCH_SSE2 1
+#endif
+
+#include "elfi32.h"
+#include "elfi32_symsearch.h"
+
+#define NO_HIT 0xFFFFFFFF
+
+static int cmp_name_offs(const void* pA, const void* pB) {
+	const elfi32_symname* pNameA = (const elfi32_symname*)pA;
+	const elfi32_symname* pNameB = (const elfi32_symname*)pB;
+	if (pNameA->offs != pNameB->offs) {
+		return pNameA->offs < pNameB->offs ? -1 : 1;
+	}
+	return pNameA->isym - pNameB->isym;
+}
+
+int elfi32_symnames_init(void* pELF, elfi32_symnames* pNames) {
+	int res = 0;
+	if (pNames) {
+		int isymtab = elfi32_find_section(pELF, ".symtab");
+		int istrtab = elfi32_find_section(pELF, ".strtab");
+		memset(pNames, 0, sizeof(elfi32_symnames));
+		if (isymtab >= 0 && istrtab >= 0) {
+			uint32_t symtabOffs = 0;
+			uint32_t symtabSize = 0;
+			uint32_t strtabOffs = 0;
+			uint32_t strtabSize = 0;
+			elfi32_section_addrinfo(pELF, isymtab, NULL, &symtabOffs, &symtabSize);
+			elfi32_section_addrinfo(pELF, istrtab, NULL, &strtabOffs, &strtabSize);
+			if (symtabSize > 0xF && strtabSize > 0) {
+				uint32_t nsym = symtabSize / 0x10;
+				pNames->pNames = (elfi32_symname*)malloc(nsym * sizeof(elfi32_symname));
+				if (pNames->pNames) {
+					uint32_t i;
+					int n = 0;
+					for (i = 1; i < nsym; ++i) {
+						uint32_t nameOffs = elfi32_read_u32(pELF, symtabOffs + i*0x10);
+						if (nameOffs > 0 && nameOffs < strtabSize) {
+							pNames->pNames[n].offs = nameOffs;
+							pNames->pNames[n].isym = (int)i;
+							++n;
+						}
+					}
+					qsort(pNames->pNames, n, sizeof(elfi32_symname), cmp_name_offs);
+					pNames->pStrs = (const char*)pELF + strtabOffs;
+					pNames->strsSize = strtabSize;
+					pNames->numSyms = (int)nsym;
+					pNames->numNames = n;
+					res = 1;
+				}
+			}
+		}
+	}
+	return res;
+}
+
+void elfi32_symnames_free(elfi32_symnames* pNames) {
+	if (pNames) {
+		free(pNames->pNames);
+		memset(pNames, 0, sizeof(elfi32_symnames));
+	}
+}
+
+/*
+ * First occurrence of pLit at or after from that ends before end.
+ * The SSE2 path compares the first and last literal bytes 16 positions
+ * at a time and only runs memcmp on the positions where both agree.
+ */
+static uint32_t find_lit(const char* pStrs, uint32_t from, uint32_t end, const char* pLit, uint32_t len) {
+	uint32_t i = from;
+	if (len == 0 || end < len) {
+		return NO_HIT;
+	}
+#ifdef SYMSEARCH_SSE2
+	if (len > 1) {
+		__m128i first = _mm_set1_epi8(pLit[0]);
+		__m128i last = _mm_set1_epi8(pLit[len - 1]);
+		while (i + len - 1 + 16 <= end) {
+			__m128i blkFirst = _mm_loadu_si128((const __m128i*)(pStrs + i));
+			__m128i blkLast = _mm_loadu_si128((const __m128i*)(pStrs + i + len - 1));
+			unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(blkFirst, first), _mm_cmpeq_epi8(blkLast, last)));
+			while (mask) {
+				uint32_t pos = i + (uint32_t)__builtin_ctz(mask);
+				if (memcmp(pStrs + pos + 1, pLit + 1, len - 2) == 0) {
+					return pos;
+				}
+				mask &= mask - 1;
+			}
+			i += 16;
+		}
+	}
+#endif
+	while (i + len <= end) {
+		const char* pHit = (const char*)memchr(pStrs + i, pLit[0], end - len + 1 - i);
+		if (!pHit) {
+			break;
+		}
+		i = (uint32_t)(pHit - pStrs);
+		if (memcmp(pHit + 1, pLit + 1, len - 1) == 0) {
+			return i;
+		}
+		++i;
+	}
+	return NO_HIT;
+}
+
+static int class_match(const char* pPat, char c, const char** ppNext) {
+	const char* p = pPat + 1;
+	int neg = 0;
+	int hit = 0;
+	if (*p == '!' || *p == '^') {
+		neg = 1;
+		++p;
+	}
+	if (*p == ']') {
+		hit |= c == ']';
+		++p;
+	}
+	while (*p && *p != ']') {
+		if (p[1] == '-' && p[2] && p[2] != ']') {
+			hit |= (unsigned char)c >= (unsigned char)p[0] && (unsigned char)c <= (unsigned char)p[2];
+			p += 3;
+		} else {
+			hit |= c == *p;
+			++p;
+		}
+	}
+	if (!*p) {
+		/* unterminated: a literal '[' */
+		*ppNext = pPat + 1;
+		return c == '[';
+	}
+	*ppNext = p + 1;
+	return hit ^ neg;
+}
+
+static int glob_match(const char* pStr, const char* pPat) {
+	const char* pStarPat = NULL;
+	const char* pStarStr = NULL;
+	while (*pStr) {
+		const char* pNext = NULL;
+		if (*pPat == '*') {
+			pStarPat = ++pPat;
+			pStarStr = pStr;
+			continue;
+		}
+		if (*pPat == '?' || (*pPat == '[' ? class_match(pPat, *pStr, &pNext) : *pPat && *pPat == *pStr)) {
+			pPat = pNext ? pNext : pPat + 1;
+			++pStr;
+			continue;
+		}
+		if (pStarPat) {
+			pPat = pStarPat;
+			pStr = ++pStarStr;
+			continue;
+		}
+		return 0;
+	}
+	while (*pPat == '*') {
+		++pPat;
+	}
+	return *pPat == 0;
+}
+
+/* longest run of plain characters, every match must contain it */
+static const char* glob_literal(const char* pPat, uint32_t* pLen) {
+	const char* pBest = pPat;
+	uint32_t bestLen = 0;
+	const char* p = pPat;
+	while (*p) {
+		const char* pRun = p;
+		while (*p && *p != '*' && *p != '?' && *p != '[') {
+			++p;
+		}
+		if ((uint32_t)(p - pRun) > bestLen) {
+			pBest = pRun;
+			bestLen = (uint32_t)(p - pRun);
+		}
+		if (*p == '[') {
+			/* skip the whole bracket expression, an unterminated one only its '[' */
+			class_match(p, 0, &p);
+		} else if (*p) {
+			++p;
+		}
+	}
+	*pLen = bestLen;
+	return pBest;
+}
+
+static int lower_name(const elfi32_symnames* pNames, uint32_t offs) {
+	int lo = 0;
+	int hi = pNames->numNames;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (pNames->pNames[mid].offs < offs) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+/*
+ * Matching .symtab indices in ascending order go to pSyms (up to maxSyms,
+ * pSyms may be NULL to only count); returns the total number of matches.
+ *
+ * The literal part of the pattern is searched for in the packed string
+ * table once; each hit is mapped back to the names that start between the
+ * previous hit (or the string start) and the hit, which also covers names
+ * sharing a tail with a longer string.
+ */
+int elfi32_sym_search(const elfi32_symnames* pNames, const char* pPattern, elfi32_searchmode mode, int* pSyms, int maxSyms) {
+	uint64_t* pHits;
+	const char* pLit;
+	uint32_t litLen;
+	int glob = mode == ELFI32_SEARCH_GLOB;
+	int cnt = 0;
+	int i;
+	if (!pNames || !pNames->pNames || !pPattern) {
+		return 0;
+	}
+	pHits = (uint64_t*)calloc((pNames->numSyms + 63) / 64, sizeof(uint64_t));
+	if (!pHits) {
+		return -1;
+	}
+	if (glob) {
+		pLit = glob_literal(pPattern, &litLen);
+	} else {
+		pLit = pPattern;
+		litLen = (uint32_t)strlen(pPattern);
+	}
+	if (litLen == 0) {
+		for (i = 0; i < pNames->numNames; ++i) {
+			const elfi32_symname* pName = &pNames->pNames[i];
+			if (!glob || glob_match(pNames->pStrs + pName->offs, pPattern)) {
+				pHits[pName->isym >> 6] |= (uint64_t)1 << (pName->isym & 63);
+			}
+		}
+	} else {
+		uint32_t pos = 0;
+		uint32_t hit;
+		while ((hit = find_lit(pNames->pStrs, pos, pNames->strsSize, pLit, litLen)) != NO_HIT) {
+			uint32_t start = hit;
+			while (start > pos && pNames->pStrs[start - 1]) {
+				--start;
+			}
+			for (i = lower_name(pNames, start); i < pNames->numNames && pNames->pNames[i].offs <= hit; ++i) {
+				const elfi32_symname* pName = &pNames->pNames[i];
+				if (!glob || glob_match(pNames->pStrs + pName->offs, pPattern)) {
+					pHits[pName->isym >> 6] |= (uint64_t)1 << (pName->isym & 63);
+				}
+			}
+			pos = hit + 1;
+		}
+	}
+	for (i = 0; i < pNames->numSyms; ++i) {
+		if (!pHits[i >> 6]) {
+			i |= 63;
+		} else if (pHits[i >> 6] & ((uint64_t)1 << (i & 63))) {
+			if (pSyms && cnt < maxSyms) {
+				pSyms[cnt] = i;
+			}
+			++cnt;
+		}
+	}
+	free(pHits);
+	return cnt;
+}
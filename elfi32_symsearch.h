@@ -0,0 +1,35 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum _elfi32_searchmode {
+	ELFI32_SEARCH_SUBSTR,
+	ELFI32_SEARCH_GLOB /* '*', '?', '[a-z]', '[!...]' over the whole name */
+} elfi32_searchmode;
+
+typedef struct _elfi32_symname {
+	uint32_t offs; /* into .strtab */
+	int isym;
+} elfi32_symname;
+
+/* .symtab names sorted by string table offset; points into the ELF image */
+typedef struct _elfi32_symnames {
+	const char* pStrs;
+	uint32_t strsSize;
+	int numSyms; /* .symtab entries */
+	int numNames;
+	elfi32_symname* pNames;
+} elfi32_symnames;
+
+int elfi32_symnames_init(void* pELF, elfi32_symnames* pNames);
+void elfi32_symnames_free(elfi32_symnames* pNames);
+int elfi32_sym_search(const elfi32_symnames* pNames, const char* pPattern, elfi32_searchmode mode, int* pSyms, int maxSyms);
+
+#ifdef __cplusplus
+}
+#endif
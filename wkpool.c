@@ -0,0 +1,145 @@
+/* SPDX-License-Identifier: MIT */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "wkpool.h"
+
+typedef struct _WkThread {
+	WkPool* pPool;
+	int iwk;
+	pthread_t thread;
+} WkThread;
+
+struct _WkPool {
+	pthread_mutex_t mtx;
+	pthread_cond_t cvWork;
+	pthread_cond_t cvDone;
+	pthread_cond_t cvIdle;
+	WkThread* pThreads;
+	int nworkers;
+	int quit;
+	int busy;
+	wkpool_fn fn;
+	void* pCtx;
+	int njobs;
+	int nextJob;
+	int ndone;
+};
+
+static void* wk_main(void* pMem) {
+	WkThread* pThread = (WkThread*)pMem;
+	WkPool* pPool = pThread->pPool;
+	pthread_mutex_lock(&pPool->mtx);
+	for (;;) {
+		int ijob;
+		while (!pPool->quit && pPool->nextJob >= pPool->njobs) {
+			pthread_cond_wait(&pPool->cvWork, &pPool->mtx);
+		}
+		if (pPool->quit) {
+			break;
+		}
+		ijob = pPool->nextJob++;
+		pthread_mutex_unlock(&pPool->mtx);
+		pPool->fn(ijob, pThread->iwk, pPool->pCtx);
+		pthread_mutex_lock(&pPool->mtx);
+		if (++pPool->ndone == pPool->njobs) {
+			pthread_cond_broadcast(&pPool->cvDone);
+		}
+	}
+	pthread_mutex_unlock(&pPool->mtx);
+	return NULL;
+}
+
+WkPool* wkpool_create(int nworkers) {
+	WkPool* pPool = NULL;
+	if (nworkers > 0) {
+		pPool = (WkPool*)malloc(sizeof(WkPool));
+		if (pPool) {
+			int i;
+			memset(pPool, 0, sizeof(WkPool));
+			pthread_mutex_init(&pPool->mtx, NULL);
+			pthread_cond_init(&pPool->cvWork, NULL);
+			pthread_cond_init(&pPool->cvDone, NULL);
+			pthread_cond_init(&pPool->cvIdle, NULL);
+			pPool->pThreads = (WkThread*)malloc(sizeof(WkThread) * nworkers);
+			if (pPool->pThreads) {
+				for (i = 0; i < nworkers; ++i) {
+					WkThread* pThread = &pPool->pThreads[i];
+					pThread->pPool = pPool;
+					pThread->iwk = i;
+					if (pthread_create(&pThread->thread, NULL, wk_main, pThread) != 0) {
+						break;
+					}
+					++pPool->nworkers;
+				}
+			}
+			if (pPool->nworkers == 0) {
+				wkpool_destroy(pPool);
+				pPool = NULL;
+			}
+		}
+	}
+	return pPool;
+}
+
+void wkpool_destroy(WkPool* pPool) {
+	if (pPool) {
+		int i;
+		pthread_mutex_lock(&pPool->mtx);
+		pPool->quit = 1;
+		pthread_cond_broadcast(&pPool->cvWork);
+		pthread_mutex_unlock(&pPool->mtx);
+		for (i = 0; i < pPool->nworkers; ++i) {
+			pthread_join(pPool->pThreads[i].thread, NULL);
+		}
+		free(pPool->pThreads);
+		pthread_cond_destroy(&pPool->cvIdle);
+		pthread_cond_destroy(&pPool->cvDone);
+		pthread_cond_destroy(&pPool->cvWork);
+		pthread_mutex_destroy(&pPool->mtx);
+		free(pPool);
+	}
+}
+
+int wkpool_num_workers(WkPool* pPool) {
+	return pPool ? pPool->nworkers : 1;
+}
+
+/*
+ * Runs fn for every job index in [0, njobs) and waits for completion.
+ * Without a pool the jobs run serially on the calling thread as worker 0.
+ * Must not be called from inside a job of the same pool.
+ */
+void wkpool_for(WkPool* pPool, int njobs, wkpool_fn fn, void* pCtx) {
+	if (njobs <= 0 || !fn) {
+		return;
+	}
+	if (!pPool) {
+		int i;
+		for (i = 0; i < njobs; ++i) {
+			fn(i, 0, pCtx);
+		}
+		return;
+	}
+	pthread_mutex_lock(&pPool->mtx);
+	while (pPool->busy) {
+		pthread_cond_wait(&pPool->cvIdle, &pPool->mtx);
+	}
+	pPool->busy = 1;
+	pPool->fn = fn;
+	pPool->pCtx = pCtx;
+	pPool->ndone = 0;
+	pPool->nextJob = 0;
+	pPool->njobs = njobs;
+	pthread_cond_broadcast(&pPool->cvWork);
+	while (pPool->ndone < njobs) {
+		pthread_cond_wait(&pPool->cvDone, &pPool->mtx);
+	}
+	pPool->njobs = 0;
+	pPool->nextJob = 0;
+	pPool->busy = 0;
+	pthread_cond_signal(&pPool->cvIdle);
+	pthread_mutex_unlock(&pPool->mtx);
+}
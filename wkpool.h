@@ -0,0 +1,23 @@
+/* SPDX-License-Identifier: MIT */
+
+#ifndef WKPOOL_H
+#define WKPOOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _WkPool WkPool;
+
+typedef void (*wkpool_fn)(int ijob, int iwk, void* pCtx);
+
+WkPool* wkpool_create(int nworkers);
+void wkpool_destroy(WkPool* pPool);
+int wkpool_num_workers(WkPool* pPool);
+void wkpool_for(WkPool* pPool, int njobs, wkpool_fn fn, void* pCtx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif